@@ -0,0 +1,85 @@
+#ifndef _SATURN_BID_SCORER_H_
+#define _SATURN_BID_SCORER_H_
+
+#include "common.h"
+#include "feature_engine.h"
+#include "svr_model.h"
+#include "ctr_model.h"
+#include "wr_model.h"
+
+#include <utility>
+
+
+namespace saturn
+{
+class BidScorer
+{
+    // `BidScorer` scores a batch of candidates (adgroups) of one request and
+    // keeps the `k` with the highest expected value
+    //
+    //     min(bid * bid_multiplier, max_bid) * ctr * win_prob
+    //
+    // where `bid_multiplier` comes from `SvrModel::run`, `ctr` from `ctrModel::get_prob`
+    // and `win_prob` from `WrModel::final_prob`.
+    //
+    // All three models run in one pass per candidate, cheapest first,
+    // and a candidate is dropped as soon as an upper bound of its expected value
+    // cannot beat the current k-th best:
+    // before any model runs the bound uses `SvrModel::max_multiplier`, which allows for
+    // the uncapped `fallback_multiplier` of deadline fallbacks and the cheap path,
+    // and CTR and win rate are bounded by 1.
+    //
+    // Request-level fields must be ingested into the `FeatureEngine` beforehand.
+    // Any of the models may be `nullptr`, in which case its factor is 1.
+    // The models are not owned and must share one `FeatureEngine`.
+
+  public:
+    struct Candidate {
+        // Candidate-level fields, such as `ctr_adgroup_id`,
+        // ingested before the models run for this candidate.
+        std::vector<std::pair<FeatureEngine::StringField, std::string>> string_fields;
+        std::vector<std::pair<FeatureEngine::IntField, int>> int_fields;
+
+        std::string brand_id;
+        std::string adgroup_id;
+        double user_adgroup_svr = 0.;
+        double pacing = -1.;
+
+        double bid = 0.;
+        double max_bid = -1.;  // cap on `bid * bid_multiplier`; negative means no cap
+    };
+
+    struct Score {
+        size_t index = 0;  // into the candidate list
+        double expected_value = 0.;
+        double capped_bid = 0.;  // min(bid * bid_multiplier, max_bid)
+        double bid_multiplier = 1.;
+        double ctr = 1.;
+        double win_prob = 1.;
+        bool degraded = false;  // some model returned a fallback
+    };
+
+    BidScorer(SvrModel * svr_model, ctrModel * ctr_model, WrModel * wr_model);
+
+    // `top` receives at most `k` candidates with positive expected value,
+    // in decreasing order of expected value.
+    // `deadline` is passed to every model; see `SvrModel::run`. A CTR or win-rate model
+    // that runs out of time contributes its prior (`ctrModel::get_prob`, `WrModel::get_prob`);
+    // the priors default to 0, which drops the candidate from `top`.
+    void score(std::vector<Candidate> const & candidates, size_t k, std::vector<Score> & top,
+               Deadline const & deadline = Deadline());
+
+    // Number of candidates dropped early by the last call to `score`.
+    size_t n_pruned() const;
+
+  private:
+    SvrModel * _svr_model;
+    ctrModel * _ctr_model;
+    WrModel * _wr_model;
+    FeatureEngine * _feature_engine = nullptr;
+
+    size_t _n_pruned = 0;
+};
+
+}  // namespace
+#endif  // include guard
@@ -0,0 +1,110 @@
+#ifndef _SATURN_BOUNDED_QUEUE_H_
+#define _SATURN_BOUNDED_QUEUE_H_
+
+#include "common.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+
+namespace saturn
+{
+template <typename T>
+class BoundedQueue
+{
+    // A FIFO queue with a fixed capacity, for any number of producer and consumer threads.
+    //
+    // Producers choose between `try_push`, which fails right away when the queue is full
+    // (the caller sees the backpressure and decides what to do),
+    // and `push`, which waits for room.
+    // After `close`, pushes fail, and pops drain what is left and then fail.
+
+  public:
+    BoundedQueue(size_t capacity)
+        : _capacity(capacity)
+    {
+        if (capacity == 0) {
+            throw SaturnError("`BoundedQueue` capacity must be positive");
+        }
+    }
+
+    bool try_push(T && item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_closed || _items.size() >= _capacity) {
+                return false;
+            }
+            _items.push_back(std::move(item));
+        }
+        _not_empty.notify_one();
+        return true;
+    }
+
+    bool push(T && item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_full.wait(lock, [this] {
+                return _closed || _items.size() < _capacity;
+            });
+            if (_closed) {
+                return false;
+            }
+            _items.push_back(std::move(item));
+        }
+        _not_empty.notify_one();
+        return true;
+    }
+
+    // Wait for an item; return `false` if the queue is closed and empty.
+    bool pop(T & item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_empty.wait(lock, [this] {
+                return _closed || !_items.empty();
+            });
+            if (_items.empty()) {
+                return false;
+            }
+            item = std::move(_items.front());
+            _items.pop_front();
+        }
+        _not_full.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _not_empty.notify_all();
+        _not_full.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _items.size();
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+  private:
+    const size_t _capacity;
+    bool _closed = false;
+    std::deque<T> _items;
+    mutable std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+};
+
+}  // namespace
+#endif  // include guard
@@ -0,0 +1,137 @@
+#ifndef _SATURN_BRANCH_COUNTERS_H_
+#define _SATURN_BRANCH_COUNTERS_H_
+
+#include "common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <vector>
+
+
+namespace saturn
+{
+
+struct BranchCounts {
+    // Number of `SvrModel` calls by the branch they took; see `SvrModel::Branch`.
+    enum Slot {
+        no_model = 0,        // `has_model` false
+        no_adgroup,          // `has_adgroup` false
+        default_multiplier,  // -1 traffic: `default_cached`, `default_computed`, `negative_svr`
+        cutoff,
+        curve,
+        pacing_curve,
+        fallback,
+        error,               // return code 2
+        n_slots
+    };
+
+    uint64_t counts[n_slots] = {0};
+
+    uint64_t total() const;
+
+    void merge(BranchCounts const & other);
+
+    static char const * slot_name(Slot slot);
+};
+
+
+// Whether the library was built with `SATURN_BRANCH_COUNTERS` (e.g. `make BRANCH_COUNTERS=1`).
+// Otherwise `SvrModel` counts nothing and its `branch_counters()` stay empty.
+bool branch_counters_enabled();
+
+
+class BranchCounters
+{
+    // Per-adgroup `BranchCounts` of one `SvrModel` and all the instances bound to it.
+    //
+    // Every instance counts into its own `Shard`, which has one cache line of counters
+    // per adgroup of the catalog (and one for everything else), so that scoring threads
+    // never write to the same line and never make a read-modify-write. The lines are
+    // allocated in blocks of `Shard::lines_per_block` adgroups when one of them is first
+    // counted, so an instance holds memory only for the adgroups its traffic reaches.
+    // `snapshot` sums the shards with relaxed loads; it takes a mutex shared only
+    // with adding and removing shards, never with counting.
+
+  public:
+    explicit BranchCounters(std::set<std::string> const & adgroups);
+
+    BranchCounters(BranchCounters const &) = delete;
+    BranchCounters & operator=(BranchCounters const &) = delete;
+
+    class Shard
+    {
+      public:
+        static size_t const lines_per_block = 16;
+
+        explicit Shard(size_t n_lines);
+        ~Shard();
+
+        Shard(Shard const &) = delete;
+        Shard & operator=(Shard const &) = delete;
+
+        // Only one thread may count into a shard.
+        void count(size_t index, BranchCounts::Slot slot)
+        {
+            // Only this thread stores the block pointers.
+            auto block = _blocks[index / lines_per_block].load(std::memory_order_relaxed);
+            if (block == nullptr) {
+                block = this->_add_block(index / lines_per_block);
+            }
+            auto & c = block->lines[index % lines_per_block].counts[slot];
+            c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        // Adds the counts of the adgroups counted so far to `out`, by index.
+        void add_to(std::map<size_t, BranchCounts> & out) const;
+
+        size_t memory_bytes() const;
+
+      private:
+        struct Line {
+            std::atomic<uint64_t> counts[BranchCounts::n_slots];  // 64 bytes
+        };
+        struct alignas(64) Block {
+            Line lines[lines_per_block];
+        };
+        std::unique_ptr<std::atomic<Block *>[]> _blocks;  // null until counted into
+        size_t _n_lines;
+
+        Block * _add_block(size_t i);
+    };
+
+    // Index of the counters of `adgroup_id` (with or without a leading '/'),
+    // for `Shard::count`. Adgroups outside the catalog share index `n_adgroups()`.
+    size_t index(std::string const & adgroup_id) const;
+
+    size_t n_adgroups() const;
+
+    // A new shard for one model instance; counts stay in the totals after `remove_shard`.
+    std::shared_ptr<Shard> add_shard();
+    void remove_shard(std::shared_ptr<Shard> const & shard);
+
+    // Counts per adgroup so far; adgroups outside the catalog are under "".
+    // Adgroups that have not been called are left out.
+    std::map<std::string, BranchCounts> snapshot() const;
+
+    // Writes `snapshot()` as tab-separated lines with a header:
+    //   adgroup_id no_model no_adgroup default_multiplier cutoff curve pacing_curve fallback error
+    void write_tsv(std::ostream & out) const;
+
+    // Estimated bytes of the index and the shards.
+    size_t memory_bytes() const;
+
+  private:
+    std::vector<std::string> _adgroups;  // sorted
+
+    mutable std::mutex _mutex;
+    std::vector<std::shared_ptr<Shard>> _shards;
+    std::map<size_t, BranchCounts> _retired;  // counts of removed shards, by index
+};
+
+}  // namespace
+#endif  // include guard
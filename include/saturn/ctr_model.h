@@ -3,8 +3,11 @@
 
 #include "common.h"
 #include "feature_engine.h"
+#include "stats.h"
+#include "utils.h"
 
 #include <map>
+#include <memory>
 #include <tuple>
 
 
@@ -15,15 +18,30 @@ class ctrModel
   public:
     ctrModel(FeatureEngine & feature_engine, std::string path);
 
+    // Bind the model loaded by `prototype` to `context`, which must have the same schema
+    // as the engine of `prototype` (see `FeatureEngine::clone_context`).
+    // The decoded mars model is shared, not decoded again (see the binding constructor
+    // of `SvrModel` for what that relies on); results and timings are per instance.
+    ctrModel(ctrModel const & prototype, FeatureEngine & context);
+
     ~ctrModel();
 
     std::string const & model_id() const;
 
-    double get_prob(std::vector<std::string> input);
+    // Sets the 17 CTR fields from `input`, in the order of `run_ctr`, and runs the model.
+    // Unlike the other overloads, returns 0, with the probability in `prob()`;
+    // throws if `input` is malformed.
+    double get_prob(std::vector<std::string> const & input);
 
     // Get output probability after setting features directly
     double get_prob();
 
+    // If the model would not finish by `deadline`, return the prior CTR instead,
+    // which is "prior_ctr" in `model_config.json` (default 0), and flag the result
+    // as degraded. Set the prior for a model used with deadlines: with the default,
+    // a degraded result scores 0 in `BidScorer`.
+    double get_prob(Deadline const & deadline);
+
     FeatureEngine& get_features() {
       return _feature_engine;
     }
@@ -49,11 +67,30 @@ class ctrModel
     // The following methods provide results after a call to `run`.
     std::string const & message() const;
     double prob() const;
+    bool degraded() const;
+
+    // Number of degraded results since construction.
+    size_t n_degraded() const;
+
+    // Latency of the stages of the calls on this instance; see `StageStats`.
+    // Empty unless the library was built with `SATURN_STATS`.
+    // May be called from any thread, also while the model runs.
+    StageStats stats() const;
+
+    // Estimated memory of the mars model (shared by bound instances);
+    // see `MemoryUsage`. The features are in `FeatureEngine::memory_usage`.
+    MemoryUsage memory_usage() const;
 
   private:
     FeatureEngine & _feature_engine;
-    void * _mars_model = nullptr;
+    std::shared_ptr<void> _mars_model;
+    size_t _mars_model_bytes = 0;  // heap growth while decoding
     double _prob = 0.;
+    double _prior_ctr = 0.;
+    bool _degraded = false;
+    size_t _n_degraded = 0;
+    StageCost _eval_cost;
+    std::unique_ptr<StageRecorder> _stats;
 
     std::string _path;
     std::string _model_id;
@@ -61,6 +98,9 @@ class ctrModel
 
     std::string _message = "This is a sample message.";
 
+    // Decode the mars model of `_path`.
+    void _load_mars_model();
+
 };
 
 }  // namespace
@@ -0,0 +1,126 @@
+#ifndef _SATURN_EXECUTOR_H_
+#define _SATURN_EXECUTOR_H_
+
+#include "common.h"
+#include "bounded_queue.h"
+#include "model_context.h"
+#include "model_set.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <map>
+#include <future>
+#include <memory>
+#include <thread>
+
+
+namespace saturn
+{
+class Executor
+{
+    // `Executor` scores `ModelSet::Request`s asynchronously on a fixed pool of worker threads.
+    //
+    // Every worker owns a `FeatureEngine` context and its own instances of the models,
+    // so workers never share mutable state. The models are loaded by the first worker
+    // and bound to each other worker's context (see `FeatureEngine::clone_context`),
+    // which shares the decoded mars models and the parsed configuration.
+    // Requests go through one bounded queue; any thread may submit.
+    // When the queue is full, `try_submit` fails immediately, which is the
+    // backpressure signal; `submit` instead waits for room.
+    //
+    // Completion is reported either through a `std::future` or a callback.
+    // Callbacks run on the worker thread and should be short. An exception thrown by
+    // a callback is caught and counted (`n_callback_errors`); the worker carries on.
+
+  public:
+    struct ModelPaths {
+        // Model directories; leave empty to not load a model.
+        std::string svr;
+        std::string ctr;
+        std::string wr;
+    };
+
+    // `error` is null on success; otherwise `result` holds the defaults (see `ModelSet::Result`).
+    // Either way, nothing in `result` comes from another request.
+    typedef std::function<void(ModelSet::Result const & result, std::exception_ptr error)> Callback;
+
+    // Loads the models concurrently (see `ModelLoader`) and binds them to every worker;
+    // throws if any model fails to load.
+    Executor(ModelPaths const & paths, size_t n_workers, size_t queue_capacity);
+
+    // Finishes the queued requests, then stops the workers.
+    ~Executor();
+
+    // Return `false` without queueing if the queue is full or the executor is shut down.
+    bool try_submit(ModelSet::Request request, Callback callback);
+    bool try_submit(ModelSet::Request request, std::future<ModelSet::Result> & future);
+
+    // Wait for room in the queue.
+    // Throws `SaturnError` if the executor is shut down.
+    void submit(ModelSet::Request request, Callback callback);
+    std::future<ModelSet::Result> submit(ModelSet::Request request);
+
+    // Attach a load shedder to all workers; the queue depth is reported to it
+    // as workers pick up requests. Not owned; pass `nullptr` to detach.
+    void set_load_shedder(LoadShedder * shedder);
+
+    // Stop accepting requests, finish the queued ones, and join the workers.
+    void shutdown();
+
+    size_t n_workers() const;
+    size_t queue_depth() const;
+    size_t queue_capacity() const;
+
+    // Number of `try_submit` calls turned down, because the queue was full
+    // or the executor was shut down.
+    size_t n_rejected() const;
+
+    // Number of requests completed, successfully or not.
+    size_t n_completed() const;
+
+    // Number of callbacks that threw.
+    size_t n_callback_errors() const;
+
+    struct Stats {
+        StageStats svr;
+        StageStats ctr;
+        StageStats wr;
+    };
+
+    // Per-stage latencies of each model, merged over the workers.
+    // Empty unless the library was built with `SATURN_STATS`.
+    Stats stats() const;
+
+    // Warm up before serving, i.e. before submitting any request: `SvrModel::warmup`
+    // of every worker (the counts in the report are summed over the workers),
+    // then `warm_memory`.
+    WarmupReport warmup(WarmupOptions const & options);
+
+    // `SvrModel::apply_config_delta` on the workers' SVR model, whose configuration they share;
+    // may be called while serving. Returns 0 without an SVR model.
+    size_t apply_svr_config_delta(std::string const & file);
+
+    // Per-adgroup branch counts of the workers' `SvrModel`s; see `SvrModel::branch_counters`.
+    // Empty without an SVR model, or unless built with `SATURN_BRANCH_COUNTERS`.
+    std::map<std::string, BranchCounts> svr_branch_counts() const;
+
+  private:
+    struct Job {
+        ModelSet::Request request;
+        Callback callback;
+    };
+
+    BoundedQueue<Job> _queue;
+    std::vector<std::unique_ptr<ModelContext>> _workers;
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _n_rejected;
+    std::atomic<size_t> _n_completed;
+    std::atomic<size_t> _n_callback_errors;
+    std::atomic<LoadShedder *> _load_shedder;
+
+    void _work(ModelContext & worker);
+};
+
+}  // namespace
+#endif  // include guard
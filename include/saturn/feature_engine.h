@@ -2,6 +2,10 @@
 #define _SATURN_FEATURE_ENGINE_H_
 
 #include "common.h"
+#include "memory.h"
+
+#include <map>
+#include <memory>
 
 namespace saturn
 {
@@ -17,9 +21,9 @@ class FeatureEngine
     // If such sharing is not a concern, it's perfectly fine to create multiple `FeatureEngine` instances
     // in a program and use them independently.
 
-    friend class SvrModel;  // Needs to access `_mars_feature_engine`.
-    friend class WrModel;  // Needs to access `_mars_feature_engine`.
-    friend class ctrModel;  // Needs to access `_mars_feature_engine`.
+    friend class SvrModel;  // Needs to access `_add_composer` and `_render`.
+    friend class WrModel;  // Needs to access `_add_composer` and `_render`.
+    friend class ctrModel;  // Needs to access `_add_composer` and `_render`.
 
   public:
 
@@ -109,6 +113,33 @@ class FeatureEngine
     FeatureEngine();
     ~FeatureEngine();
 
+    FeatureEngine(FeatureEngine && other);
+    FeatureEngine(FeatureEngine const &) = delete;
+    FeatureEngine & operator=(FeatureEngine const &) = delete;
+
+    // A `FeatureEngine` is a schema, i.e. the registered composers and the dictionaries,
+    // plus a context, i.e. the current field values and renderings.
+    // The schema is immutable once shared, so contexts on different threads can use it
+    // without locking.
+    //
+    // `clone_context` returns a new engine with the schema of this one, shared, not copied,
+    // and no field set. It is not a cheap clone: mars keeps the ingested field values
+    // inside the engine that holds the composers, and has no way to copy an engine or
+    // to render a composer of one engine from values held elsewhere. So each context
+    // has a mars engine of its own, on which the composers are registered again from
+    // the model config files (which must therefore still be readable); its size is the
+    // "mars_engine" item of `memory_usage`. What is shared is saturn's side of the schema
+    // and, once models are bound to the new context with their binding constructors,
+    // e.g. `SvrModel(prototype, context)`, the decoded mars models.
+    //
+    // Registering a composer on an engine whose schema is shared gives the engine
+    // a private copy of the schema first; the contexts cloned earlier keep the old one.
+    FeatureEngine clone_context() const;
+
+    // Whether the two engines have the same schema, e.g. one is a clone of the other.
+    // Models created with one engine can then be bound to the other.
+    bool same_schema(FeatureEngine const & other) const;
+
     // Use these functions to update one field at a time,
     // in no particular order.
     // If some fields are not actually used by the models that you will subsequently run,
@@ -125,9 +156,72 @@ class FeatureEngine
     // `update_field`, then you don't need to call `reset_fields` beforehand.
     void reset_fields();
 
+    // String fields used by `OneHot` features get a dictionary of their vocabulary
+    // (the union of the `values` lists of all registered composers).
+    // The current value is encoded once, when the field is updated:
+    // `field_code` is in [0, `vocabulary_size`) for a value in the vocabulary,
+    // and equal to `vocabulary_size` for any other value.
+    // For a field without a dictionary, `field_code` is -1 and `vocabulary_size` is 0.
+    // The code is not passed to mars, which still renders `OneHot` features from the string.
+    // What it saves: when a field read by nothing but `OneHot` features changes from one value
+    // outside the vocabulary to another, the new value is not ingested, and the renderings
+    // of the composers reading it stay current.
+    int field_code(StringField idx) const;
+    size_t vocabulary_size(StringField idx) const;
+
+    // Estimated memory of the registered composers, this context's mars engine
+    // (heap growth), the dictionaries of the `OneHot` vocabularies, and this context;
+    // see `MemoryUsage`. The schema is shared by all clones of the engine.
+    MemoryUsage memory_usage() const;
+
   private:
+    struct Schema;
+
+    explicit FeatureEngine(std::shared_ptr<Schema> schema);
+
+    std::shared_ptr<Schema> _schema;
     void * _mars_feature_engine = nullptr;
 
+    // Each field keeps a copy of its current value and the 'generation' at which
+    // the value last changed. Generations come from a clock that ticks on every change;
+    // 0 means the field has never been set.
+    // Updating a field with its current value is a no-op: nothing is ingested,
+    // and the generation does not change.
+    unsigned long _clock = 0;
+    std::vector<unsigned long> _generation;
+    std::vector<std::string> _string_values;
+    std::vector<int> _int_values;
+    std::vector<double> _float_values;
+
+    struct Rendering {
+        // Most recent rendering of a composer and the clock value when it was made;
+        // it is reused as long as none of the composer's columns has changed since.
+        std::vector<double> x;
+        unsigned long rendered_at = 0;
+    };
+    // Indexed by the composer's slot in the schema.
+    std::vector<Rendering> _renderings;
+
+    // Indexed by string field; the code of the current value in the field's dictionary.
+    std::vector<int> _string_codes;
+
+    // Register the composer defined by the "features" list in the JSON file
+    // `config_file`; return the composer ID.
+    // Registrations are serialized by a mutex, so that several models may be constructed
+    // on one engine concurrently (see `ModelLoader`); nothing else may use the engine meanwhile.
+    std::string _add_composer(std::string const & config_file);
+
+    // Rendered feature vector of a composer registered by `_add_composer`.
+    // The reference is valid until the next call on this object.
+    std::vector<double> const & _render(std::string const & composer_id);
+
+    void _init_context();
+    void _ingest(size_t column);
+    void _string_changed(size_t idx);
+    void _build_dictionary(size_t idx, std::vector<std::string> const & values);
+    int _encode(size_t idx) const;
+    size_t _column_index(std::string const & name) const;
+
     const size_t _string_field_idx_base = 0;
     const size_t _int_field_idx_base = STRING_FIELDS.size();
     const size_t _float_field_idx_base = STRING_FIELDS.size() + INT_FIELDS.size();
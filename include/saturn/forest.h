@@ -0,0 +1,110 @@
+#ifndef _SATURN_FOREST_H_
+#define _SATURN_FOREST_H_
+
+#include "common.h"
+
+#include <cstdint>
+
+
+namespace saturn
+{
+
+class CompiledForest
+{
+    // `CompiledForest` is a flattened, read-only copy of a binary random forest
+    // (`mars::BinaryRandomForestClassifier`), laid out for fast prediction.
+    //
+    // Nodes of all trees live in parallel arrays (structure of arrays).
+    // Within each tree, nodes are stored in breadth-first order, so that the two
+    // children of a split node are adjacent and the top levels of every tree,
+    // which are visited by every prediction, are packed together.
+    //
+    // When every tree has at most 64 leaves, the forest is additionally compiled
+    // for QuickScorer-style evaluation: each split node becomes a bit mask over the
+    // leaves of its tree, split nodes are grouped by feature and sorted by threshold,
+    // and a prediction is a sequence of linear scans and bitwise ANDs instead of
+    // pointer chasing.
+    //
+    // Split semantics follow scikit-learn: go left if `x[feature] <= threshold`,
+    // otherwise (including NaN) go right.
+    // Leaf values are averaged over trees in tree order, so results match
+    // `mars::BinaryRandomForestClassifier::predict_one` up to floating point
+    // summation order, which is the same.
+    //
+    // Experimental: no model uses it yet, and the Avro layout `from_avro` expects has not
+    // been checked against a `cc_dump` of the mars forest; only `latency ... compare`
+    // exercises it on a real model. Trees built with `add_tree` are covered by `test_units`.
+
+  public:
+    CompiledForest(size_t n_predictors);
+
+    // Build from a model file created by `mars.BaseModel.cc_dump` for a
+    // `BinaryRandomForestClassifier` (layout unverified, see above).
+    // Besides `class_name` and `predictor_count`, the reader expects an array `trees`
+    // whose elements carry the scikit-learn `tree_` arrays
+    // `children_left`, `children_right`, `feature`, `threshold`, and `value`,
+    // where `value` is the positive-class probability of each node.
+    static CompiledForest from_avro(std::string const & path);
+
+    // Add one tree in scikit-learn layout; node 0 is the root and
+    // a leaf has `children_left[i] == -1`.
+    // Only `value` of leaves is used.
+    void add_tree(
+        std::vector<int> const & children_left,
+        std::vector<int> const & children_right,
+        std::vector<int> const & feature,
+        std::vector<double> const & threshold,
+        std::vector<double> const & value);
+
+    // Build the bit-vector tables after all trees have been added.
+    // Returns `false` if some tree has more than 64 leaves, in which case
+    // `predict_one_bitvector` is unavailable.
+    // Throws `SaturnError` if no tree has been added: a forest must have at least one
+    // (`from_avro` rejects a file without trees), as predictions average over the trees.
+    bool compile_bitvector();
+
+    size_t n_predictors() const;
+    size_t n_trees() const;
+    size_t n_nodes() const;
+    bool has_bitvector() const;
+
+    // `x` points to `n_predictors()` values. The forest must have trees; the overload
+    // taking a vector checks this and the size of `x`, the others do not.
+    double predict_one(double const * x) const;
+    double predict_one(std::vector<double> const & x) const;
+
+    // Same result as `predict_one`, using the bit-vector tables.
+    double predict_one_bitvector(double const * x) const;
+
+    // `x` is row-major, `n_rows` by `n_predictors()`; `out` receives `n_rows` values.
+    // Rows are processed in blocks so that each tree stays in cache
+    // while it is applied to the whole block.
+    void predict_many(double const * x, size_t n_rows, double * out) const;
+
+  private:
+    size_t _n_predictors;
+
+    // Per node, over all trees.
+    // For a leaf, `_feature` is -1 and `_threshold` holds the leaf value.
+    // The right child of a split node is at `_left[i] + 1`.
+    std::vector<int32_t> _feature;
+    std::vector<double> _threshold;
+    std::vector<int32_t> _left;
+
+    // Index of the root node of each tree.
+    std::vector<uint32_t> _roots;
+
+    // Bit-vector tables; split nodes grouped by feature, sorted by threshold.
+    // Nodes of feature `f` occupy [`_qs_offsets[f]`, `_qs_offsets[f + 1]`).
+    bool _has_bitvector = false;
+    std::vector<uint32_t> _qs_offsets;
+    std::vector<double> _qs_threshold;
+    std::vector<uint32_t> _qs_tree;
+    std::vector<uint64_t> _qs_mask;
+    // Leaf values of tree `t`, left to right, start at `_qs_leaf_base[t]`.
+    std::vector<uint32_t> _qs_leaf_base;
+    std::vector<double> _qs_leaf_value;
+};
+
+}  // namespace
+#endif  // include guard
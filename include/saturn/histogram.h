@@ -0,0 +1,98 @@
+#ifndef _SATURN_HISTOGRAM_H_
+#define _SATURN_HISTOGRAM_H_
+
+#include "common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+
+namespace saturn
+{
+class Histogram
+{
+    // `Histogram` counts non-negative integer values, e.g. latencies in nanoseconds,
+    // in log-linear buckets, in the manner of HdrHistogram: values below 2^`precision_bits`
+    // have a bucket each; above that, every power-of-2 range is cut into 2^(`precision_bits` - 1)
+    // equal buckets. Hence any recorded value is known to within a relative error
+    // of 2^(1 - `precision_bits`) (under 1.6% with the default of 7 bits),
+    // over the whole 64-bit range, in a few thousand buckets.
+    //
+    // Recording is a few integer operations and never allocates.
+    // Not thread-safe; give each thread its own histogram and `merge` them.
+
+  public:
+    explicit Histogram(int precision_bits = 7);
+
+    void record(uint64_t value);
+
+    // Record `value` `n` times.
+    void record(uint64_t value, uint64_t n);
+
+    // Add the counts of `other`, which must have the same `precision_bits`.
+    void merge(Histogram const & other);
+
+    void reset();
+
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+
+    // The value at percentile `p` (0 to 100), e.g. 99.9:
+    // the upper end of the bucket holding that rank, at most `max()`.
+    // 0 if nothing has been recorded.
+    uint64_t percentile(double p) const;
+
+    int precision_bits() const;
+
+  private:
+    int _bits;
+    std::vector<uint64_t> _counts;
+    uint64_t _count = 0;
+    uint64_t _min = 0;
+    uint64_t _max = 0;
+    double _sum = 0.;
+
+    friend class AtomicHistogram;
+
+    static size_t _n_buckets(int bits);
+    static size_t _index(uint64_t value, int bits);
+    static uint64_t _upper(size_t index, int bits);
+};
+
+
+class AtomicHistogram
+{
+    // Buckets of `Histogram` as relaxed atomics, for one writer thread and
+    // any number of reader threads: `record` makes no read-modify-write,
+    // and `snapshot` can run at any time from any thread without locking.
+    // A snapshot taken during recording may be off by the values in flight.
+
+  public:
+    explicit AtomicHistogram(int precision_bits = 5);
+
+    AtomicHistogram(AtomicHistogram const &) = delete;
+    AtomicHistogram & operator=(AtomicHistogram const &) = delete;
+
+    // Only one thread may record.
+    void record(uint64_t value)
+    {
+        auto & c = _counts[Histogram::_index(value, _bits)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Add the counts to `out`, each value multiplied by `scale`
+    // (e.g. to convert clock ticks to nanoseconds).
+    void snapshot(Histogram & out, double scale = 1.) const;
+
+    int precision_bits() const;
+
+  private:
+    int _bits;
+    std::unique_ptr<std::atomic<uint64_t>[]> _counts;
+};
+
+}  // namespace
+#endif  // include guard
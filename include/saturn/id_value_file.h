@@ -0,0 +1,68 @@
+#ifndef _SATURN_ID_VALUE_FILE_H_
+#define _SATURN_ID_VALUE_FILE_H_
+
+#include "common.h"
+
+#include <string>
+#include <vector>
+
+
+namespace saturn
+{
+class IdValueFile
+{
+    // `IdValueFile` reads a plain text file of `id value [value ...]` lines with a fixed
+    // number of values, such as the sidecar files of `SvrModel`
+    // (`brand_default_svr.txt`, `adgroup_quantile_cutoff.txt`).
+    //
+    // The file is mapped into memory and cut into chunks on line boundaries, which are
+    // parsed concurrently (numbers by `std::from_chars`). Columns are separated by spaces
+    // or tabs; blank lines are skipped. A line with a missing or extra column, or with
+    // a value that is not a finite number, is malformed: it is skipped and reported with
+    // its line number, and the lines after it are still read.
+
+  public:
+    struct Error {
+        size_t line;  // from 1
+        std::string message;
+    };
+
+    // Reads `path`, whose lines have `n_values` values after the id, on at most
+    // `n_threads` threads (0: up to the hardware threads; small files take one).
+    // A missing file reads as empty, with `exists()` false; a file that exists but
+    // cannot be read throws `SaturnError`.
+    IdValueFile(std::string const & path, size_t n_values, size_t n_threads = 0);
+
+    bool exists() const;
+
+    // Rows read, in file order.
+    size_t size() const;
+    std::string const & id(size_t row) const;
+    double value(size_t row, size_t column) const;
+
+    // The rows in order of their ids; of rows with the same id, only the first,
+    // as `std::map::emplace` in file order would keep. For building an ordered map
+    // in bulk, with `emplace_hint` at its end.
+    std::vector<size_t> sorted_unique_rows() const;
+
+    // Malformed lines: their number, and the first `max_errors` of them in file order.
+    size_t n_malformed() const;
+    std::vector<Error> const & errors() const;
+    static size_t const max_errors = 100;
+
+    // One line for logs, e.g. "f.txt: 3 malformed line(s) skipped; line 7: bad number `x`; ...".
+    // Empty if there are none.
+    std::string error_summary() const;
+
+  private:
+    std::string _path;
+    size_t _n_values;
+    bool _exists = false;
+    std::vector<std::string> _ids;
+    std::vector<double> _values;  // `_n_values` per row
+    size_t _n_malformed = 0;
+    std::vector<Error> _errors;
+};
+
+}  // namespace
+#endif  // include guard
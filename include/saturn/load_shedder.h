@@ -0,0 +1,71 @@
+#ifndef _SATURN_LOAD_SHEDDER_H_
+#define _SATURN_LOAD_SHEDDER_H_
+
+#include "common.h"
+
+#include <atomic>
+#include <mutex>
+
+
+namespace saturn
+{
+class LoadShedder
+{
+    // `LoadShedder` decides which scoring calls take a cheap path under overload.
+    //
+    // It watches a moving average of per-call latency and, optionally, the depth
+    // of a request queue. Every `window` calls it adjusts the shed rate:
+    // while either signal is above its 'high' threshold the rate goes up by `step`
+    // (up to `max_shed_rate`); it only comes down, again by `step`, once the latency is
+    // below its 'low' threshold and the queue depth at or below its own (so that the
+    // default `queue_low` of 0 means an empty queue). Between the thresholds the rate holds.
+    // This hysteresis keeps the controller from flapping around a single threshold.
+    //
+    // `should_shed` picks exactly a `shed_rate()` fraction of calls, evenly spread.
+    //
+    // One object may be shared by many threads.
+
+  public:
+    struct Config {
+        double latency_high_us = 5000.;
+        double latency_low_us = 2000.;
+        size_t queue_high = 0;  // 0 disables the queue signal
+        size_t queue_low = 0;
+        double step = 0.1;
+        double max_shed_rate = 0.9;
+        size_t window = 100;
+    };
+
+    enum class State {normal, shedding};
+
+    LoadShedder();
+    LoadShedder(Config const & config);
+
+    void record_latency(long us);
+    void record_queue_depth(size_t depth);
+
+    // Whether the current call should take the cheap path.
+    bool should_shed();
+
+    State state() const;
+    double shed_rate() const;
+    double latency_us() const;  // moving average
+    size_t n_shed() const;
+    size_t n_calls() const;
+
+  private:
+    Config _config;
+    std::atomic<double> _latency_us;
+    std::atomic<size_t> _queue_depth;
+    std::atomic<double> _shed_rate;
+    std::atomic<bool> _shedding;
+    std::atomic<size_t> _n_observations;
+    std::atomic<size_t> _n_calls;
+    std::atomic<size_t> _n_shed;
+    std::mutex _adjust_mutex;
+
+    void _adjust();
+};
+
+}  // namespace
+#endif  // include guard
@@ -0,0 +1,146 @@
+#ifndef _SATURN_MEMORY_H_
+#define _SATURN_MEMORY_H_
+
+#include "common.h"
+
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace saturn
+{
+
+struct MemoryUsage {
+    // Estimated bytes held by the parts of a model or a `FeatureEngine`, see `memory_usage()`.
+    //
+    // Containers are estimated from their sizes (`heap_bytes` below).
+    // The mars objects are opaque; they are measured as the growth of the heap
+    // while they were decoded (`heap_in_use`). That includes whatever other threads
+    // allocated meanwhile, e.g. scoring threads or models loaded alongside, so these
+    // items (`heap_growth`) are rough: report them, but do not budget on them.
+
+    struct Item {
+        std::string name;
+        size_t count;  // number of entries, e.g. submodels or map entries
+        size_t bytes;
+        bool heap_growth;  // measured with `heap_in_use`
+    };
+    std::vector<Item> items;
+
+    void add(std::string const & name, size_t count, size_t bytes);
+    void add_heap_growth(std::string const & name, size_t count, size_t bytes);
+
+    // Add the items of `other`, their names prefixed by `prefix`.
+    void add(std::string const & prefix, MemoryUsage const & other);
+
+    size_t total() const;
+
+    // The total of the items estimated from sizes, leaving out the heap growth.
+    size_t counted() const;
+
+    // One line per item, `name count bytes`, with `~` after the bytes
+    // of the heap-growth items; then the total.
+    void write(std::ostream & out) const;
+};
+
+
+// Bytes currently allocated by `malloc` (and hence `new`) in the process;
+// 0 where the C library cannot tell.
+size_t heap_in_use();
+
+// Resident set size of the process in bytes; 0 where unknown.
+size_t resident_bytes();
+
+// Summed size of the regular files in directory `dir` whose names end in `suffix`;
+// 0 if `dir` cannot be read.
+size_t file_bytes(std::string const & dir, std::string const & suffix);
+
+
+// Estimated heap bytes owned by a value, not counting `sizeof` the value itself.
+// Node overheads are those of libstdc++ on 64-bit platforms.
+template <typename T>
+size_t heap_bytes(T const &)
+{
+    return 0;
+}
+
+size_t heap_bytes(std::string const & s);
+
+template <typename A, typename B>
+size_t heap_bytes(std::pair<A, B> const & p);
+
+template <typename T>
+size_t heap_bytes(std::vector<T> const & v);
+
+template <typename K, typename V>
+size_t heap_bytes(std::map<K, V> const & m);
+
+template <typename K>
+size_t heap_bytes(std::set<K> const & s);
+
+template <typename K, typename V>
+size_t heap_bytes(std::unordered_map<K, V> const & m);
+
+
+inline size_t heap_bytes(std::string const & s)
+{
+    // Short strings live in the object itself.
+    return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+template <typename A, typename B>
+size_t heap_bytes(std::pair<A, B> const & p)
+{
+    return heap_bytes(p.first) + heap_bytes(p.second);
+}
+
+template <typename T>
+size_t heap_bytes(std::vector<T> const & v)
+{
+    size_t n = v.capacity() * sizeof(T);
+    for (auto const & x : v) {
+        n += heap_bytes(x);
+    }
+    return n;
+}
+
+template <typename K, typename V>
+size_t heap_bytes(std::map<K, V> const & m)
+{
+    // Red-black tree node: color, parent, left, right, then the value.
+    size_t n = m.size() * (32 + sizeof(std::pair<K const, V>));
+    for (auto const & x : m) {
+        n += heap_bytes(x.first) + heap_bytes(x.second);
+    }
+    return n;
+}
+
+template <typename K>
+size_t heap_bytes(std::set<K> const & s)
+{
+    size_t n = s.size() * (32 + sizeof(K));
+    for (auto const & x : s) {
+        n += heap_bytes(x);
+    }
+    return n;
+}
+
+template <typename K, typename V>
+size_t heap_bytes(std::unordered_map<K, V> const & m)
+{
+    // Singly linked node with the cached hash, plus the bucket array.
+    size_t n = m.size() * (16 + sizeof(std::pair<K const, V>)) + m.bucket_count() * sizeof(void *);
+    for (auto const & x : m) {
+        n += heap_bytes(x.first) + heap_bytes(x.second);
+    }
+    return n;
+}
+
+}  // namespace
+#endif  // include guard
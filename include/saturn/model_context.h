@@ -0,0 +1,58 @@
+#ifndef _SATURN_MODEL_CONTEXT_H_
+#define _SATURN_MODEL_CONTEXT_H_
+
+#include "common.h"
+#include "feature_engine.h"
+#include "svr_model.h"
+#include "ctr_model.h"
+#include "wr_model.h"
+#include "model_set.h"
+#include "model_loader.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace saturn
+{
+struct ModelContext {
+    // Everything one thread needs to score requests on its own: a `FeatureEngine`,
+    // at most one model of each kind on it, and a `ModelSet` over them, with a request
+    // and a result to reuse. Tools that score on several threads, and `Executor`,
+    // load one context and make the others from it with the copy constructor.
+
+    FeatureEngine feature_engine;
+    std::unique_ptr<SvrModel> svr_model;
+    std::unique_ptr<ctrModel> ctr_model;
+    std::unique_ptr<WrModel> wr_model;
+    ModelSet model_set;
+
+    // `reset_fields` is set, and `run_ctr` and `run_wr` for the models present.
+    ModelSet::Request request;
+    ModelSet::Result result;
+
+    // Of the constructor that loaded the models; empty in a copy.
+    ModelLoader::Report load_report;
+
+    // Loads the models of `entries` concurrently (see `ModelLoader`).
+    // Throws `SaturnError` if there is more than one of a kind,
+    // and the exception of the first model that fails to load.
+    explicit ModelContext(std::vector<ModelLoader::Entry> const & entries);
+
+    // Model directories; leave empty to not load a model.
+    ModelContext(std::string const & svr, std::string const & ctr, std::string const & wr);
+
+    // Binds the models of `prototype` to a new context on its schema; the decoded
+    // mars models are shared (see e.g. the binding constructor of `SvrModel`).
+    ModelContext(ModelContext const & prototype);
+
+    ModelContext & operator=(ModelContext const &) = delete;
+};
+
+
+// `path` without trailing slashes, except for "/" itself.
+std::string strip_slash(std::string path);
+
+}  // namespace
+#endif  // include guard
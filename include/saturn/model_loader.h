@@ -0,0 +1,87 @@
+#ifndef _SATURN_MODEL_LOADER_H_
+#define _SATURN_MODEL_LOADER_H_
+
+#include "common.h"
+#include "feature_engine.h"
+#include "svr_model.h"
+#include "ctr_model.h"
+#include "wr_model.h"
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace saturn
+{
+class ModelLoader
+{
+    // `ModelLoader` constructs a set of models on one `FeatureEngine` concurrently,
+    // one model per thread, instead of one after another.
+    //
+    // Each model's JSON and Avro work is independent of the others'; only composer
+    // registration on the shared engine is serialized (see `FeatureEngine::_add_composer`).
+    // Within a model, `WrModel` decodes its two Avro objects concurrently and `SvrModel`
+    // reads its sidecar files while the catalog decodes.
+    //
+    // The engine must not be used otherwise, e.g. cloned, until the loader returns.
+    // The heap-growth items of `memory_usage()` (see `MemoryUsage`) include allocations
+    // of the models loaded alongside.
+
+  public:
+    enum class Kind {svr, ctr, wr};
+
+    struct Entry {
+        Kind kind;
+        std::string path;
+    };
+
+    // Reads a manifest: one model per line, `kind path` with `kind` one of
+    // `svr`, `ctr`, `wr`; blank lines and lines starting with '#' are skipped.
+    // Throws `SaturnError` if the file cannot be read or a line is malformed.
+    static std::vector<Entry> read_manifest(std::string const & file);
+
+    struct Report {
+        struct Model {
+            Kind kind;
+            std::string path;
+            double wall_seconds = 0.;  // construction of the model
+        };
+        std::vector<Model> models;  // in the order of the entries
+        double wall_seconds = 0.;   // of the whole load
+        double cpu_seconds = 0.;    // CPU time of the process during the load, summed over threads
+
+        // One line per model, then wall time against CPU time and their ratio,
+        // the effective parallelism.
+        void write(std::ostream & out) const;
+    };
+
+    // Loads the models of `entries` onto `feature_engine`, at most `n_threads`
+    // at a time (0: one thread per model, up to the hardware threads).
+    // If a model fails to load, the loads under way finish, the others are not started,
+    // and the first exception is rethrown.
+    ModelLoader(FeatureEngine & feature_engine, std::vector<Entry> const & entries, size_t n_threads = 0);
+
+    ModelLoader(ModelLoader const &) = delete;
+    ModelLoader & operator=(ModelLoader const &) = delete;
+
+    // The loaded models of each kind, in the order of the entries.
+    // The loader owns them; move them out to keep them beyond the loader.
+    std::vector<std::unique_ptr<SvrModel>> & svr_models();
+    std::vector<std::unique_ptr<ctrModel>> & ctr_models();
+    std::vector<std::unique_ptr<WrModel>> & wr_models();
+
+    Report const & report() const;
+
+    static char const * kind_name(Kind kind);
+
+  private:
+    std::vector<std::unique_ptr<SvrModel>> _svr_models;
+    std::vector<std::unique_ptr<ctrModel>> _ctr_models;
+    std::vector<std::unique_ptr<WrModel>> _wr_models;
+    Report _report;
+};
+
+}  // namespace
+#endif  // include guard
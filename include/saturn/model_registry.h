@@ -0,0 +1,187 @@
+#ifndef _SATURN_MODEL_REGISTRY_H_
+#define _SATURN_MODEL_REGISTRY_H_
+
+#include "common.h"
+#include "feature_engine.h"
+#include "histogram.h"
+#include "model_loader.h"
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace saturn
+{
+class ModelRegistry
+{
+    // `ModelRegistry` maps model IDs, e.g. one per tenant, to model directories and
+    // loads the models on `feature_engine` when they are first asked for. Loaded models
+    // stay resident while their sizes fit in `memory_budget`; beyond it, the least
+    // recently used ones are evicted, except pinned ones, which are loaded up front
+    // and never evicted.
+    //
+    // The size of a model is `memory_usage().counted()`, which leaves out the heap growth
+    // of the mars objects (other threads allocate meanwhile, see `MemoryUsage`), plus the
+    // size of the model's Avro files (`*.data`) in their place: the same for every load,
+    // whatever else the process is doing.
+    //
+    // A model is identified by its kind and ID, so that a tenant can have an SVR and a CTR
+    // model under the same ID. `svr`, `ctr` and `wr` return shared pointers: a model evicted
+    // while a caller holds it stays alive until released, but no longer counts against
+    // the budget.
+    //
+    // Evicting a model does not remove its composer from `feature_engine`; reloading it
+    // (or loading a model with the same features) reuses the composer and registers nothing
+    // new. The engine thus grows with the distinct models loaded, not with the loads, and
+    // its growth since the registry was created (`memory_usage().counted()`) counts against
+    // the budget too, though eviction cannot reclaim it: a budget that the engine alone
+    // exceeds keeps no model resident but the pinned ones and the one last asked for.
+    //
+    // A load registers composers on `feature_engine`, which nothing else may use meanwhile,
+    // so the registry belongs to the thread that owns the engine and that uses the models:
+    // the methods other than `has`, `memory_budget` and `stats`, which any thread may call,
+    // throw `SaturnError` when called on another thread.
+
+  public:
+    using Kind = ModelLoader::Kind;
+
+    // A loaded model, in the pointer of its kind, and its size as budgeted.
+    struct Loaded {
+        std::shared_ptr<SvrModel> svr_model;
+        std::shared_ptr<ctrModel> ctr_model;
+        std::shared_ptr<WrModel> wr_model;
+        size_t bytes = 0;
+    };
+
+    // Loads the model of `kind` at `path` onto the registry's engine; throws if it cannot.
+    using LoadFunction = std::function<Loaded(Kind kind, std::string const & path)>;
+
+    // The registry is owned by the calling thread (see above).
+    // `memory_budget`: bytes; 0 for no limit.
+    // `load`: empty to load with `ModelLoader`, sized as above.
+    ModelRegistry(FeatureEngine & feature_engine, size_t memory_budget = 0, LoadFunction load = LoadFunction());
+
+    ModelRegistry(ModelRegistry const &) = delete;
+    ModelRegistry & operator=(ModelRegistry const &) = delete;
+
+    // Registers model `id` of `kind` at `path`, without loading it unless `pinned`.
+    // Throws `SaturnError` if it is already registered. If a pinned model fails to load,
+    // its exception propagates; the model stays registered and pinned, and loads when asked for.
+    void add(Kind kind, std::string const & id, std::string const & path, bool pinned = false);
+
+    // Registers the models listed in `file`, one per line: `kind id path [pinned]`,
+    // with `kind` one of `svr`, `ctr`, `wr`; blank lines and lines starting with '#'
+    // are skipped. Throws `SaturnError` if the file cannot be read or a line is malformed.
+    void add_manifest(std::string const & file);
+
+    bool has(Kind kind, std::string const & id) const;
+
+    // The model, loaded first if it is not resident, which may evict others.
+    // Throws `SaturnError` if no such model is registered; if the load fails,
+    // its exception propagates and the next call tries again.
+    std::shared_ptr<SvrModel> svr(std::string const & id);
+    std::shared_ptr<ctrModel> ctr(std::string const & id);
+    std::shared_ptr<WrModel> wr(std::string const & id);
+
+    // Pinning loads the model if needed and exempts it from eviction;
+    // unpinning makes it evictable again, and evicts at once if over budget.
+    void pin(Kind kind, std::string const & id);
+    void unpin(Kind kind, std::string const & id);
+
+    // Drops the model if it is resident and not pinned; returns whether it did.
+    bool evict(Kind kind, std::string const & id);
+
+    size_t memory_budget() const;
+    void set_memory_budget(size_t bytes);  // evicts as needed
+
+    struct Stats {
+        struct Model {
+            Kind kind;
+            std::string id;
+            std::string path;
+            bool resident = false;
+            bool pinned = false;
+            size_t bytes = 0;          // size as budgeted, as of the last load
+            size_t hits = 0;           // requests served while resident
+            size_t loads = 0;
+            size_t evictions = 0;
+            double load_seconds = 0.;  // summed over the loads
+        };
+        std::vector<Model> models;     // ordered by kind, then ID
+
+        size_t memory_budget = 0;
+        size_t resident_bytes = 0;     // with `engine_bytes`, may exceed the budget if pinned models do
+        size_t engine_bytes = 0;       // growth of the feature engine since the registry was created
+        size_t n_resident = 0;
+        size_t hits = 0;
+        size_t misses = 0;             // requests that had to load
+        size_t loads = 0;
+        size_t failed_loads = 0;
+        size_t evictions = 0;
+        Histogram load_microseconds;   // latency of the successful loads
+
+        // Totals, load latency percentiles, then one line per model.
+        void write(std::ostream & out) const;
+    };
+
+    Stats stats() const;
+
+  private:
+    struct Entry {
+        Kind kind;
+        std::string id;
+        std::string path;
+        bool pinned = false;
+        std::shared_ptr<SvrModel> svr_model;
+        std::shared_ptr<ctrModel> ctr_model;
+        std::shared_ptr<WrModel> wr_model;
+        bool resident = false;
+        std::list<Entry *>::iterator lru;  // into `_lru`, while resident
+        size_t bytes = 0;
+        size_t hits = 0;
+        size_t loads = 0;
+        size_t evictions = 0;
+        double load_seconds = 0.;
+    };
+
+    FeatureEngine & _feature_engine;
+    size_t _memory_budget;
+    LoadFunction _load_function;
+    std::thread::id _owner;
+    size_t _engine_base;       // `_feature_engine.memory_usage().counted()` at construction
+    size_t _engine_bytes = 0;  // its growth since, as of the last load
+    mutable std::mutex _mutex;
+    std::map<std::pair<Kind, std::string>, Entry> _entries;
+    std::list<Entry *> _lru;  // resident models, most recently used first
+    size_t _resident_bytes = 0;
+    size_t _hits = 0;
+    size_t _misses = 0;
+    size_t _loads = 0;
+    size_t _failed_loads = 0;
+    size_t _evictions = 0;
+    Histogram _load_microseconds;
+
+    // Throws unless called on `_owner`.
+    void _check_owner(char const * method) const;
+
+    // The caller holds `_mutex` in all of these.
+    Entry & _entry(Kind kind, std::string const & id);
+    // Mark `entry` used, loading it if not resident, then evict for the budget.
+    void _use(Entry & entry);
+    void _load(Entry & entry);
+    void _drop(Entry & entry);
+    // Evict least recently used, unpinned models other than `keep` until the resident models
+    // and the engine growth fit in the budget.
+    void _fit(Entry const * keep);
+};
+
+}  // namespace
+#endif  // include guard
@@ -0,0 +1,127 @@
+#ifndef _SATURN_MODEL_SET_H_
+#define _SATURN_MODEL_SET_H_
+
+#include "common.h"
+#include "feature_engine.h"
+#include "svr_model.h"
+#include "ctr_model.h"
+#include "wr_model.h"
+#include "load_shedder.h"
+
+#include <utility>
+
+
+namespace saturn
+{
+class ModelSet
+{
+    // `ModelSet` runs, for one request, any of the models that share a `FeatureEngine`:
+    // one call ingests the request-level fields, runs every requested model invocation,
+    // and returns all results together with per-stage timings.
+    //
+    // Each distinct composer is rendered once per request: `FeatureEngine` reuses
+    // a rendering until one of the composer's fields changes, and the models run
+    // in dependency order, i.e. models that only read request-level fields
+    // (`ctrModel`, `WrModel`) go before `SvrModel`, which writes the field
+    // `user_extlba` once per call.
+    //
+    // The models are not owned by `ModelSet` and must outlive it.
+    //
+    // With a `LoadShedder` attached, each request reports its latency to it,
+    // and the requests it picks take cheap paths: `SvrModel::run_cheap` in place of `run`,
+    // and `WrModel::get_win_prob` (no delivery model) in place of `get_prob`.
+
+  public:
+    struct SvrCall {
+        enum class Method {run, get_multiplier, get_cpsvr};
+
+        Method method = Method::run;
+        std::string brand_id;
+        std::string adgroup_id;
+        double user_adgroup_svr = 0.;
+        double pacing = -1.;  // `run` only
+        SvrModel::Mode mode = SvrModel::Mode::brand;  // `get_multiplier` and `get_cpsvr` only
+    };
+
+    struct Request {
+        // Request-level fields, ingested before any model runs.
+        bool reset_fields = false;
+        std::vector<std::pair<FeatureEngine::StringField, std::string>> string_fields;
+        // String fields whose values are kept elsewhere, e.g. in a mapped `ReplayFile`,
+        // and stay valid until `run` returns; ingested without a copy.
+        std::vector<std::pair<FeatureEngine::StringField, char const *>> c_str_fields;
+        std::vector<std::pair<FeatureEngine::IntField, int>> int_fields;
+        std::vector<std::pair<FeatureEngine::FloatField, double>> float_fields;
+
+        // Model invocations.
+        bool run_ctr = false;
+        bool run_wr = false;
+        std::vector<SvrCall> svr_calls;
+
+        // Passed to every model; see `SvrModel::run`.
+        Deadline deadline;
+    };
+
+    struct SvrResult {
+        int code = 0;  // return value of the `SvrModel` method
+        double svr = 0.;
+        double bid_multiplier = 0.;
+        double cpsvr = 0.;
+        bool degraded = false;
+        std::string message;
+    };
+
+    struct Result {
+        double ctr_prob = 0.;
+        double wr_win_prob = 0.;
+        double wr_dev_prob = 0.;
+        double wr_final_prob = 0.;
+        bool ctr_degraded = false;
+        bool wr_degraded = false;
+        bool shed = false;  // the request took the cheap paths
+        std::vector<SvrResult> svr;  // in the order of `Request::svr_calls`
+
+        // Microseconds spent in each stage.
+        long ingest_us = 0;
+        long ctr_us = 0;
+        long wr_us = 0;
+        long svr_us = 0;
+        long total_us = 0;
+
+        // Back to the defaults above, keeping the capacity of `svr`.
+        void clear();
+    };
+
+    ModelSet(FeatureEngine & feature_engine);
+
+    // Each model must have been created with the `FeatureEngine` of this object.
+    // Pass `nullptr` to remove a model.
+    void set_svr_model(SvrModel * model);
+    void set_ctr_model(ctrModel * model);
+    void set_wr_model(WrModel * model);
+
+    // Not owned; may be shared by several `ModelSet`s. Pass `nullptr` to detach.
+    void set_load_shedder(LoadShedder * shedder);
+
+    // Throws `SaturnError` if the request asks for a model that is not set.
+    // Errors inside `SvrModel` are reported in `SvrResult::code` and `SvrResult::message`.
+    // `result` is cleared first, so that the fields of the models not asked for, and all
+    // of them if this throws, hold the defaults rather than those of an earlier request.
+    void run(Request const & request, Result & result);
+
+    Result run(Request const & request);
+
+    FeatureEngine& get_features() {
+      return _feature_engine;
+    }
+
+  private:
+    FeatureEngine & _feature_engine;
+    SvrModel * _svr_model = nullptr;
+    ctrModel * _ctr_model = nullptr;
+    WrModel * _wr_model = nullptr;
+    LoadShedder * _load_shedder = nullptr;
+};
+
+}  // namespace
+#endif  // include guard
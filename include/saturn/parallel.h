@@ -0,0 +1,32 @@
+#ifndef _SATURN_PARALLEL_H_
+#define _SATURN_PARALLEL_H_
+
+#include "common.h"
+
+#include <functional>
+
+
+namespace saturn
+{
+
+// Run `task(worker, begin, end)` over the index range [0, `n`), cut into chunks
+// of `chunk_size`, on `n_threads` threads (0 means all hardware threads).
+//
+// Scheduling is work stealing: every thread starts with its own contiguous share
+// of chunks and takes them from the front; a thread that runs out steals from the back
+// of the share of another thread. This keeps each thread on neighbouring data
+// while still balancing uneven chunks.
+//
+// `worker` is in [0, number of threads) and identifies the calling thread,
+// so that the task can use per-thread state (e.g. its own `FeatureEngine`).
+//
+// If tasks throw, the remaining chunks are abandoned and the first exception
+// is rethrown after all threads have finished.
+void parallel_chunks(size_t n, size_t chunk_size, size_t n_threads,
+                     std::function<void(size_t worker, size_t begin, size_t end)> const & task);
+
+// The number of threads `parallel_chunks` uses for `n_threads`.
+size_t resolve_thread_count(size_t n_threads);
+
+}  // namespace
+#endif  // include guard
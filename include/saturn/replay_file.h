@@ -0,0 +1,155 @@
+#ifndef _SATURN_REPLAY_FILE_H_
+#define _SATURN_REPLAY_FILE_H_
+
+#include "common.h"
+#include "model_set.h"
+#include "request_log.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace saturn
+{
+class ReplayFile
+{
+    // `ReplayFile` reads a binary, columnar file of logged requests, the counterpart of
+    // the text files read by `RequestParser`, mapped into memory: nothing is parsed
+    // and values are read in place.
+    //
+    // Columns are named as in `RequestParser` (`FeatureEngine` fields, `brand_id`,
+    // `adgroup_id`, `user_adgroup_svr`, `pacing`), or anything else, which `fill` ignores,
+    // e.g. the per-adgroup `user_extlba/<adgroup_id>` columns used by `test_svr`.
+    //
+    // Layout, native byte order, every section aligned to 8 bytes,
+    // offsets counted from the start of the file:
+    //
+    //   header   "SATRPL01", uint64 n_rows, uint64 n_columns
+    //   columns  per column: uint32 type, uint32 name size, uint64 data offset,
+    //            uint64 dictionary offset, uint64 dictionary size,
+    //            then the name, padded with NULs to a multiple of 8 bytes
+    //   data     per column, n_rows values: int32 (`int32`), double (`float64`),
+    //            or uint32 codes into the column's dictionary (`string`)
+    //   dicts    per `string` column, uint64 offsets[size + 1] into the
+    //            NUL-terminated values that follow them, increasing from 0
+    //
+    // Write these files with `ReplayWriter`, or convert text files with `replay_convert`.
+
+  public:
+    enum class Type : uint32_t {int32 = 0, float64 = 1, string = 2};
+
+    // Throws `SaturnError` if `path` cannot be mapped or is not a valid replay file.
+    explicit ReplayFile(std::string const & path);
+    ~ReplayFile();
+
+    ReplayFile(ReplayFile const &) = delete;
+    ReplayFile & operator=(ReplayFile const &) = delete;
+
+    // Whether `path` starts with the magic of a replay file.
+    static bool is_replay_file(std::string const & path);
+
+    size_t n_rows() const;
+    size_t n_columns() const;
+
+    std::string const & name(size_t column) const;
+    Type type(size_t column) const;
+
+    // Index of the column named `name`, or `n_columns()` if there is none.
+    size_t find(std::string const & name) const;
+
+    // The values of a column of the given type, `n_rows()` of them, in the mapping.
+    // Throws `SaturnError` on a type mismatch.
+    int32_t const * ints(size_t column) const;
+    double const * floats(size_t column) const;
+    uint32_t const * codes(size_t column) const;
+
+    // The dictionary of a `string` column.
+    size_t dict_size(size_t column) const;
+    char const * string(size_t column, uint32_t code) const
+    {
+        auto const & c = _columns[column];
+        return _base + c.dict_values + c.dict_offsets[code];
+    }
+
+    // The value of a `string` column at `row`, NUL-terminated, in the mapping.
+    char const * string_at(size_t column, size_t row) const
+    {
+        return this->string(column, _columns[column].codes[row]);
+    }
+
+    // Fill the fields and SVR call of `request` from `row`, as `RequestParser::parse`
+    // does from a line, reusing the storage of `request`. String fields go in
+    // `c_str_fields`, pointing into the mapping, so `request` must not be run
+    // after this file is destroyed.
+    void fill(size_t row, ModelSet::Request & request) const;
+
+  private:
+    struct Column {
+        std::string name;
+        Type type;
+        RequestColumn kind;
+        size_t field_idx;
+        void const * data;
+        uint32_t const * codes;         // `data`, for `string`
+        uint64_t const * dict_offsets;  // relative to `dict_values`
+        size_t dict_values;             // offset in the file
+        size_t dict_size;
+    };
+
+    void _check_type(size_t column, Type type) const;
+
+    std::string _path;
+    char const * _base = nullptr;
+    size_t _size = 0;
+    size_t _n_rows = 0;
+    std::vector<Column> _columns;
+    size_t _n_string_fields = 0;
+    size_t _n_int_fields = 0;
+    size_t _n_float_fields = 0;
+    bool _has_svr_call = false;
+};
+
+
+class ReplayWriter
+{
+    // `ReplayWriter` builds a `ReplayFile` in memory, one row at a time, and writes it out.
+
+  public:
+    ReplayWriter(std::vector<std::string> const & names, std::vector<ReplayFile::Type> const & types);
+
+    // The type `RequestParser` gives column `name`: `int32` for int fields,
+    // `float64` for float fields, `user_adgroup_svr`, `pacing` and `user_extlba/...`,
+    // `string` otherwise.
+    static ReplayFile::Type column_type(std::string const & name);
+
+    // Append a row of text values, one per column.
+    // Throws `SaturnError` on a missing value or a bad number.
+    void add_row(std::vector<std::string> const & values);
+
+    // Set the value of `column` in the last row added with `add_row`.
+    void set(size_t column, std::string const & value);
+
+    size_t n_rows() const;
+
+    // Throws `SaturnError` if `path` cannot be written.
+    void write(std::string const & path) const;
+
+  private:
+    struct Column {
+        std::string name;
+        ReplayFile::Type type;
+        std::vector<int32_t> ints;
+        std::vector<double> floats;
+        std::vector<uint32_t> codes;
+        std::vector<std::string> dict;
+        std::unordered_map<std::string, uint32_t> dict_index;
+    };
+
+    std::vector<Column> _columns;
+    size_t _n_rows = 0;
+};
+
+}  // namespace
+#endif  // include guard
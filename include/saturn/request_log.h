@@ -0,0 +1,58 @@
+#ifndef _SATURN_REQUEST_LOG_H_
+#define _SATURN_REQUEST_LOG_H_
+
+#include "common.h"
+#include "model_set.h"
+
+
+namespace saturn
+{
+
+// Role of a column of a logged-request file, by its name; see `RequestParser`.
+enum class RequestColumn {string_field, int_field, float_field, brand_id, adgroup_id, user_adgroup_svr, pacing, ignored};
+
+// The role of column `name`; for `FeatureEngine` fields, sets `field_idx`
+// to the index of the field within its type.
+RequestColumn request_column(std::string const & name, size_t & field_idx);
+
+
+class RequestParser
+{
+    // `RequestParser` turns lines of a logged-request file into `ModelSet::Request`s.
+    //
+    // The file is delimiter-separated (tab by default) with a header line
+    // naming the columns. A column is one of:
+    //
+    //   - a `FeatureEngine` field name, e.g. `ctr_os` or `user_extlba`;
+    //     its value is ingested into that field;
+    //   - `brand_id`, `adgroup_id`, `user_adgroup_svr`, `pacing`: arguments of one
+    //     `SvrModel::run` call; the call is made if `adgroup_id` is present;
+    //   - anything else, which is ignored.
+    //
+    // Whether CTR and win rate run is up to the caller (`Request::run_ctr`, `run_wr`).
+
+  public:
+    RequestParser(std::string const & header, char delimiter = '\t');
+
+    // Fill the fields and SVR call of `request` from one data line.
+    // Throws `SaturnError` if the line has too few columns or a bad number.
+    void parse(std::string const & line, ModelSet::Request & request) const;
+
+    std::vector<std::string> const & columns() const;
+
+    char delimiter() const;
+
+  private:
+    char _delimiter;
+    std::vector<std::string> _names;
+    std::vector<RequestColumn> _kinds;
+    std::vector<size_t> _field_idx;  // index within its type, for fields
+    bool _has_svr_call = false;
+};
+
+
+// Split `line` at `delimiter` into `parts`, reusing their storage.
+void split_line(std::string const & line, char delimiter, std::vector<std::string> & parts);
+
+}  // namespace
+#endif  // include guard
@@ -7,7 +7,26 @@
 #include "common.h"
 #include "feature_engine.h"
 #include "svr_model.h"
+#include "svr_config.h"
 #include "wr_model.h"
 #include "ctr_model.h"
+#include "forest.h"
+#include "model_set.h"
+#include "model_loader.h"
+#include "model_context.h"
+#include "model_registry.h"
+#include "bid_scorer.h"
+#include "executor.h"
+#include "load_shedder.h"
+#include "parallel.h"
+#include "request_log.h"
+#include "replay_file.h"
+#include "histogram.h"
+#include "stats.h"
+#include "trace.h"
+#include "branch_counters.h"
+#include "memory.h"
+#include "warmup.h"
+#include "id_value_file.h"
 
 #endif
\ No newline at end of file
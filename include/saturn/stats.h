@@ -0,0 +1,87 @@
+#ifndef _SATURN_STATS_H_
+#define _SATURN_STATS_H_
+
+#include "common.h"
+#include "histogram.h"
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+namespace saturn
+{
+
+// Timestamp for stage timing: the CPU time-stamp counter where available
+// (a few nanoseconds to read, no system call), otherwise a steady clock in nanoseconds.
+inline uint64_t stats_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Nanoseconds per tick of `stats_ticks`, measured against the steady clock
+// over the life of the program so far; a call in the first 10 milliseconds
+// of the program waits until then.
+double stats_ns_per_tick();
+
+// Whether the library was built with `SATURN_STATS` (e.g. `make STATS=1`).
+// Otherwise no stage is timed and `stats()` of the models is empty.
+bool stats_enabled();
+
+
+struct StageStats {
+    // Latency of each stage of a scoring call, in nanoseconds:
+    //   ingest:      updating `FeatureEngine` fields
+    //   render:      rendering the feature vector
+    //   evaluate:    running the mars model(s)
+    //   postprocess: turning the model output into the result (e.g. the multiplier curve)
+    Histogram ingest;
+    Histogram render;
+    Histogram evaluate;
+    Histogram postprocess;
+
+    void merge(StageStats const & other);
+};
+
+
+class StageRecorder
+{
+    // Per-stage timings of one model instance, recorded by the thread that runs
+    // the model, and readable from any thread, without locks, via `snapshot`.
+
+  public:
+    enum class Stage {ingest = 0, render, evaluate, postprocess};
+
+    void record(Stage stage, uint64_t ticks)
+    {
+        _stages[static_cast<size_t>(stage)].record(ticks);
+    }
+
+    StageStats snapshot() const;
+
+  private:
+    AtomicHistogram _stages[4];
+};
+
+}  // namespace
+
+
+// Stage timing in the library sources; compiled out unless `SATURN_STATS` is defined.
+#ifdef SATURN_STATS
+#define SATURN_STATS_TICK(t) uint64_t const t = ::saturn::stats_ticks()
+#define SATURN_STATS_RECORD(recorder, stage, t0, t1) \
+    (recorder)->record(::saturn::StageRecorder::Stage::stage, (t1) - (t0))
+#else
+#define SATURN_STATS_TICK(t)
+#define SATURN_STATS_RECORD(recorder, stage, t0, t1)
+#endif
+
+#endif  // include guard
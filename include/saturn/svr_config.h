@@ -0,0 +1,96 @@
+#ifndef _SATURN_SVR_CONFIG_H_
+#define _SATURN_SVR_CONFIG_H_
+
+#include "common.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+
+namespace saturn
+{
+
+struct SvrConfigUpdate {
+    // One line of a configuration delta; see `SvrModel::apply_config_delta`.
+    enum class Section {cap, curve, default_svr, cutoff, brand_default_svr};
+    Section section;
+    std::string id;
+    double values[2] = {0., 0.};
+    bool remove = false;  // the line has '-' in place of the values
+};
+
+
+// Parses the configuration delta in `file`, in the format of `SvrModel::apply_config_delta`.
+// Throws `SaturnError` if the file cannot be read or a line is malformed, naming the line.
+std::vector<SvrConfigUpdate> read_config_delta(std::string const & file);
+
+
+struct SvrConfig {
+    // Everything `SvrModel` reads from its `path` besides the mars model, and shared by
+    // all instances bound to the same model. Immutable once published: `apply_config_delta`
+    // publishes an updated copy.
+    //
+    // The per-ID sections are held by shared pointers to immutable maps, so that copying
+    // the configuration copies none of them: `apply` copies only the sections its updates
+    // touch, and the new version shares the others, e.g. `brand_default_svr`, with the old.
+
+    using PairMap = std::map<std::string, std::tuple<double, double>>;
+    using ValueMap = std::map<std::string, double>;
+
+    uint64_t version = 0;
+
+    double fallback_multiplier = 1.;
+
+    std::shared_ptr<PairMap const> brand_default_svr = std::make_shared<PairMap>();
+    // Key is brand ID; value is default SVR value for non-LBA traffic and LBA traffic,
+    // in that order.
+    double default_nonlba_svr = 0.0001;
+    double default_lba_svr = 0.001;
+
+    std::shared_ptr<PairMap const> adgroup_default_svr = std::make_shared<PairMap>();
+    // Key is adgroup ID; value is default SVR value for non-LBA traffic and LBA traffic,
+    // in that order.
+    // This config is mainly used to turn off -1 traffic (by setting the default svr to 0).
+
+    double default_multiplier_curve_mu = 0.;
+    double default_multiplier_curve_sigma = 0.5;
+    std::shared_ptr<PairMap const> adgroup_multiplier_curve = std::make_shared<PairMap>();
+    // Key is adgroup_id; value is `mu` and `sigma` for function
+    // `logitnormal_cdf`.
+
+    double default_multiplier_cap = 2.;
+    std::shared_ptr<ValueMap const> adgroup_multiplier_cap = std::make_shared<ValueMap>();
+
+    std::shared_ptr<ValueMap const> adgroup_quantile_cutoff = std::make_shared<ValueMap>();
+    std::shared_ptr<std::set<std::string> const> adgroup_set = std::make_shared<std::set<std::string>>();
+
+    double adjust_multiplier_curve_for_pacing = 0.;
+    // Typically values are 0, 1, 2; recommended value for now is 1.
+
+    size_t n_submodels = 0;
+    size_t catalog_bytes = 0;  // heap growth while decoding the catalog
+    std::vector<std::string> load_warnings;
+
+    // Version at which the curve, cutoff or default SVR of an adgroup last changed,
+    // and at which those of all adgroups did; for invalidating default multipliers.
+    std::shared_ptr<std::map<std::string, uint64_t> const> adgroup_revision
+        = std::make_shared<std::map<std::string, uint64_t>>();
+    uint64_t all_adgroups_revision = 0;
+
+    // Applies `updates` in order, as the next version. Copies the sections they touch,
+    // once each, and leaves those held by earlier versions unchanged.
+    void apply(std::vector<SvrConfigUpdate> const & updates);
+
+    // Drops from `default_multipliers`, a cache of default (-1 traffic) multipliers by
+    // adgroup computed with the configuration at version `seen`, those that this
+    // configuration invalidates: all of them after a `brand_default_svr` update.
+    void invalidate(PairMap & default_multipliers, uint64_t seen) const;
+};
+
+}  // namespace
+#endif  // include guard
@@ -2,9 +2,19 @@
 #define _SATURN_SVR_MODEL_H_
 
 #include "common.h"
+#include "branch_counters.h"
 #include "feature_engine.h"
+#include "stats.h"
+#include "svr_config.h"
+#include "trace.h"
+#include "utils.h"
+#include "warmup.h"
 
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <tuple>
 #include <set>
 
@@ -63,6 +73,7 @@ class SvrModel
     //    "adjust_multiplier_curve_for_pacing": 0,
     //    "default_multiplier_curve": {"mu": 0.0, "sigma": 0.5},
     //    "default_multiplier_cap": 1.5,
+    //    "fallback_multiplier": 1.0,
     //    "adgroup_default_svr": [
     //         {
     //            "adgroup_id": "abc",
@@ -96,6 +107,9 @@ class SvrModel
     //
     // In this config, `type` is the exact class name of a subclass of `mars::Model`.
     //
+    // "fallback_multiplier" (default 1.0) is the multiplier returned when a call
+    // runs out of time; see `degraded`.
+    //
     // The sections "adgroup_multiplier_curve" and "adgroup_multiplier_cap" are optional;
     // they can be missing, or be present with a value of empty list.
     //
@@ -123,6 +137,8 @@ class SvrModel
     //     brand_id non_lba_default_svr lba_default_svr
     //
     // The file does not contain a header line. The columns are separated by spaces.
+    // Malformed lines are skipped and reported in `load_warnings`; if a brand_id
+    // repeats, its first line is used.
     // This file is optional. If this file or certain brand_id's are missing,
     // the `default_nonlba_svr` and `default_lba_svr` will take effect.
     //
@@ -133,24 +149,65 @@ class SvrModel
     // Traffic whose quantile falls below the cutoff value (e.g. 0.85) will get multiplier 0,
     // otherwise 1. This file is to support the 'placed' campaigns.
     // This file is optional. It contains only adgroups that use the 'placed' bidding strategy.
+    // It is read as `brand_default_svr.txt` is (see `IdValueFile`).
+
 
+    // Bind the model loaded by `prototype` to `context`, which must have the same schema
+    // as the engine of `prototype` (see `FeatureEngine::clone_context`).
+    // The configuration and the decoded mars catalog are shared, not copied: nothing is
+    // read from `path`. Sharing the catalog between threads relies on `mars::CatalogModel::run`
+    // not modifying the model, which mars does not document; it takes the rendered features
+    // as an argument and keeps no per-call state that saturn reads back.
+    // Per-call state, i.e. results, timings and the default-multiplier cache, is per instance,
+    // so each thread can run its own bound instance.
+    SvrModel(SvrModel const & prototype, FeatureEngine & context);
 
     ~SvrModel();
 
     std::string const & model_id() const;
 
+    FeatureEngine& get_features() {
+      return _feature_engine;
+    }
+
     bool has_model(std::string const & key) const;
 
     bool has_adgroup(std::string const & adgroup_id) const;
 
-    int run(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr, double pacing = -1.);
+    // The factor `run` applies to the curve output of the adgroup,
+    // i.e. `adgroup_multiplier_cap` if configured, otherwise `default_multiplier_cap`.
+    double multiplier_cap(std::string const & adgroup_id) const;
+
+    // The multiplier of fallbacks (see "fallback_multiplier" above), which is not capped.
+    double fallback_multiplier() const;
+
+    // Upper bound of the multiplier from `run` and `run_cheap` for the adgroup:
+    // max(1, `multiplier_cap`, `fallback_multiplier`).
+    double max_multiplier(std::string const & adgroup_id) const;
+
+    int run(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr, double pacing = -1.,
+            Deadline const & deadline = Deadline());
 
     enum class Mode{brand, location_group};
 
     int get_multiplier(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr,
-                       Mode mode);
+                       Mode mode, Deadline const & deadline = Deadline());
 
-    int get_cpsvr(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr, Mode mode);
+    int get_cpsvr(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr, Mode mode,
+                  Deadline const & deadline = Deadline());
+
+    // `deadline`: if the model evaluation would not finish by the deadline
+    // (judging by recent evaluation times; see `StageCost`), it is skipped and a fallback is returned:
+    // `fallback_multiplier` for `run` and `get_multiplier`,
+    // the default SVR of the brand (or adgroup) for `get_cpsvr`.
+    // Such a result has `degraded()` true; the return value is still 0.
+
+    // Cheap substitute for `run` under overload: no rendering and no model evaluation.
+    // The multiplier is the adgroup's cached default (-1 traffic) multiplier,
+    // capped as in `run`, if one has been computed; otherwise `fallback_multiplier`.
+    // Adgroups without a model get 1, as in `run`.
+    // The result is flagged as degraded.
+    int run_cheap(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr);
 
     // 0 is success; usually no need to check `message()`.
     // Other values indicate problems; check `message()`.
@@ -175,10 +232,101 @@ class SvrModel
     double bid_multiplier() const;
     double cpsvr() const;
     std::string const & message() const;
+    bool degraded() const;
+
+    // Number of degraded results since construction.
+    size_t n_degraded() const;
+
+    // Latency of the stages of the calls on this instance; see `StageStats`.
+    // Empty unless the library was built with `SATURN_STATS`.
+    // May be called from any thread, also while the model runs.
+    StageStats stats() const;
+
+    // Path taken by the last call to `run`, `get_multiplier`, `get_cpsvr` or `run_cheap`.
+    enum class Branch {
+        none = 0,
+        no_model,          // no model for the adgroup (or submodel key)
+        no_adgroup,        // `get_multiplier`: adgroup not in the catalog
+        negative_svr,      // `get_multiplier`, `get_cpsvr`: -1 traffic, not evaluated
+        default_cached,    // `run`: -1 traffic, cached default multiplier
+        default_computed,  // `run`: -1 traffic, default multiplier computed (and cached)
+        cutoff,            // quantile cutoff ('placed' adgroup)
+        curve,             // multiplier curve, or the submodel output
+        pacing_curve,      // default multiplier curve adjusted for `pacing`
+        fallback,          // evaluation skipped because of `deadline`, or `run_cheap`
+        error,             // return code 2
+    };
+
+    Branch branch() const;
+
+    static char const * branch_name(Branch branch);
+
+    // Trace the calls to `run`, `get_multiplier` and `get_cpsvr` sampled by `tracer`;
+    // `nullptr` (the default) to stop. `tracer` is not owned and must outlive the model.
+    // Instances bound to this one (see the constructor above) start with the same tracer.
+    void set_tracer(Tracer * tracer);
+
+    // Per-adgroup counts of the branches taken by the calls above, over this instance
+    // and all instances bound to the same model; see `BranchCounters::snapshot`.
+    // Empty unless the library was built with `SATURN_BRANCH_COUNTERS`.
+    BranchCounters const & branch_counters() const;
+
+    // Prepare this instance for serving, as `options` ask: compute the default (-1 traffic)
+    // multiplier of every adgroup of the catalog that has an adgroup-level default SVR into
+    // the cache that `run` fills lazily (for the others it depends on the brand of the first
+    // call), then make `sweep_calls` synthetic `run` calls, -1 traffic only to those adgroups. The sweep shows in `stats()`,
+    // not in `branch_counters()`. Adds what it did to `report`.
+    // Instances bound afterwards copy the cache (see the binding constructor), so warm up
+    // the prototype before binding. Memory is warmed for the whole process by `warm_memory`.
+    void warmup(WarmupOptions const & options, WarmupReport & report);
+
+    // Applies the per-adgroup configuration updates in `file` to this model and to every
+    // instance bound to it, atomically: a call sees either all of the updates or none.
+    // The file is plain text, one update per line, columns separated by spaces:
+    //
+    //     cap adgroup_id multiplier_cap
+    //     curve adgroup_id mu sigma
+    //     default_svr adgroup_id nonlba_svr lba_svr
+    //     cutoff adgroup_id quantile_cutoff
+    //     brand_default_svr brand_id nonlba_svr lba_svr
+    //
+    // with the meaning of the sections and files above (cutoffs are clamped to [0, 1]).
+    // A single '-' in place of the values removes the entry, so that the default applies again.
+    // Blank lines and lines starting with '#' are skipped; a later line for the same
+    // entry wins. If the file cannot be read or a line is malformed, `SaturnError` is thrown
+    // and nothing is applied. Returns the number of updates applied. Only the sections the
+    // updates touch are copied; the new configuration shares the others with the old one.
+    //
+    // The catalog of submodels and the scalar settings are not changed.
+    // May be called from any thread, on any of the bound instances; concurrent updates
+    // are serialized. Calls on other threads do not wait: each instance picks up the new
+    // configuration at its next `run`, `get_multiplier`, `get_cpsvr`, `run_cheap` or
+    // `refresh_config`, and drops from its default-multiplier cache only the adgroups whose
+    // curve, cutoff or default SVR changed (all of them on a `brand_default_svr` update,
+    // as the cache is per adgroup, not per brand). Caps apply after the cache.
+    size_t apply_config_delta(std::string const & file);
+
+    // Picks up the latest configuration, as the calls above do on entry.
+    // `has_adgroup` and `multiplier_cap` use the configuration as of then.
+    void refresh_config();
+
+    // Problems found while loading that did not stop it, such as malformed lines
+    // in the sidecar files, one summary per file; empty normally.
+    std::vector<std::string> const & load_warnings() const;
+
+    // Version of the configuration in use by this instance: 0 as loaded,
+    // plus one for each `apply_config_delta` on this model.
+    uint64_t config_version() const;
+
+    // Estimated memory of the catalog of submodels (shared by bound instances),
+    // of each per-adgroup map of the configuration (shared by bound instances), and of the
+    // default-multiplier cache and branch counters; see `MemoryUsage`.
+    // The features are in `FeatureEngine::memory_usage`.
+    MemoryUsage memory_usage() const;
 
   private:
     FeatureEngine & _feature_engine;
-    void * _mars_model = nullptr;
+    std::shared_ptr<void> _mars_model;
 
     std::string _path;
     std::string _model_id;
@@ -189,38 +337,73 @@ class SvrModel
     double _bid_multiplier = 0.;
     double _cpsvr = 0.;
     std::string _message = "";
+    bool _degraded = false;
+    size_t _n_degraded = 0;
+
+    StageCost _eval_cost;
+    std::unique_ptr<StageRecorder> _stats;
+
+    Branch _branch = Branch::none;
+    Tracer * _tracer = nullptr;
+    size_t _n_untraced = 0;  // calls since the last sampled one (`Tracer::sample`)
+    std::unique_ptr<Trace> _trace;
+    bool _tracing = false;  // whether the current call is sampled
+
+    std::shared_ptr<BranchCounters> _counters;
+    std::shared_ptr<BranchCounters::Shard> _counter_shard;  // this instance's; null if not counting
+
+    void _count_branch(std::string const & adgroup_id);
+
+    void _trace_begin(Trace::Method method, std::string const & brand_id, std::string const & adgroup_id,
+                      double user_adgroup_svr);
+    void _trace_end(int code, double result);
+
+    int _run(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr, double pacing,
+             Deadline const & deadline);
+    int _get_multiplier(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr,
+                        Mode mode, Deadline const & deadline);
+    int _get_cpsvr(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr,
+                   Mode mode, Deadline const & deadline);
+    int _run_cheap(std::string const & adgroup_id, double user_adgroup_svr);
+
+    // Whether to skip model evaluation because of `deadline`; counts the degraded result.
+    bool _skip_evaluation(Deadline const & deadline);
 
+    // These two time the evaluation into `_eval_cost`.
     double _calc_multiplier(std::string const & adgroup_id, double user_adgroup_svr, double pacing);
 
-    std::map<std::string, std::tuple<double, double>> _brand_default_svr;
-    // Key is brand ID; value is default SVR value for non-LBA traffic and LBA traffic,
-    // in that order.
-    double _default_nonlba_svr = 0.0001;
-    double _default_lba_svr = 0.001;
+    // `key`: catalog key of the submodel, without the leading '/'.
+    double _run_submodel(std::string const & key, double user_adgroup_svr);
 
-    std::map<std::string, std::tuple<double, double>> _adgroup_default_svr;
-    // Key is adgroup ID; value is default SVR value for non-LBA traffic and LBA traffic,
-    // in that order.
-    // This config is mainly used to turn off -1 traffic (by setting the default svr to 0).
-  
-    std::map<std::string, std::tuple<double, double>> _adgroup_default_multiplier;
-    // Key is adgroupid; value is default multiplier for non-LBA traffic and LBA traffic,
-    // in that order.
+    // Scratch space, so that the calls above do not allocate once warmed up.
+    std::string _key;
+    std::vector<double> _submodel_x = std::vector<double>(1);
 
-    double _default_multiplier_curve_mu = 0.;
-    double _default_multiplier_curve_sigma = 0.5;
-    std::map<std::string, std::tuple<double, double>> _adgroup_multiplier_curve;
-    // Key is adgroup_id; value is `mu` and `sigma` for function
-    // `logitnormal_cdf`.
+    // `has_model` for a catalog key without the leading '/'.
+    bool _has_catalog_key(std::string const & key) const;
+    // `key` without its leading '/', in `_key`.
+    std::string const & _catalog_key(std::string const & key);
+    // Catalog key of the submodel of `get_multiplier` and `get_cpsvr`, in `_key`.
+    std::string const & _submodel_key(std::string const & id, std::string const & adgroup_id, Mode mode);
 
-    double _default_multiplier_cap = 2.;
-    std::map<std::string, double> _adgroup_multiplier_cap;
+    using Config = SvrConfig;
+    std::shared_ptr<Config const> _config;  // this instance's snapshot
 
-    std::map<std::string, double> _adgroup_quantile_cutoff;
-    std::set<std::string> _adgroup_set;
-    
-    double _adjust_multiplier_curve_for_pacing = 0.;
-    // Typically values are 0, 1, 2; recommended value for now is 1.
+    struct ConfigCell {
+        // The latest configuration, shared by all instances bound to the same model.
+        std::shared_ptr<Config const> config;  // through `std::atomic_load`/`std::atomic_store`
+        std::atomic<uint64_t> version{0};      // of `config`, checked on every call
+        std::mutex update;                     // serializes `apply_config_delta`
+    };
+    std::shared_ptr<ConfigCell> _config_cell;
+
+    // Switch `_config` to the latest configuration, if newer, and drop the default
+    // multipliers it invalidates.
+    void _refresh_config();
+
+    std::map<std::string, std::tuple<double, double>> _adgroup_default_multiplier;
+    // Key is adgroupid; value is default multiplier for non-LBA traffic and LBA traffic,
+    // in that order.
 
     double _get_default_svr(std::string const & brand_id, std::string const & adgroup_id, int flag) const;
     // flag:
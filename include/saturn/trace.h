@@ -0,0 +1,137 @@
+#ifndef _SATURN_TRACE_H_
+#define _SATURN_TRACE_H_
+
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+namespace saturn
+{
+
+struct Trace {
+    // Record of one sampled scoring call; fixed size, so that it can be
+    // passed through `TraceBuffer` without allocation.
+
+    enum class Method : uint8_t {run, get_multiplier, get_cpsvr};
+
+    // Timestamps (`stats_ticks`) at the start of the call, after ingesting `user_extlba`,
+    // after rendering, after model evaluation, and at the end.
+    // 0 for a stage that did not run.
+    uint64_t t_start = 0;
+    uint64_t t_ingest = 0;
+    uint64_t t_render = 0;
+    uint64_t t_evaluate = 0;
+    uint64_t t_end = 0;
+
+    Method method = Method::run;
+    int branch = 0;  // `SvrModel::Branch`
+    int code = 0;
+    double user_adgroup_svr = 0.;
+    double result = 0.;  // bid multiplier, or calibrated SVR for `get_cpsvr`
+
+    // NUL-terminated, truncated if longer.
+    char brand_id[32] = {0};
+    char adgroup_id[32] = {0};
+    char submodel_key[72] = {0};  // the catalog key the model was run with
+
+    static void copy(char * dest, size_t size, std::string const & src);
+};
+
+
+class TraceBuffer
+{
+    // Bounded lock-free multi-producer multi-consumer ring of `Trace`s
+    // (after D. Vyukov): each slot carries a sequence number telling whether
+    // it is free for the producer or filled for the consumer of a given round.
+    // `push` fails instead of waiting when the ring is full.
+
+  public:
+    // `capacity` is rounded up to a power of 2.
+    explicit TraceBuffer(size_t capacity);
+
+    bool push(Trace const & trace);
+    bool pop(Trace & trace);
+
+    size_t capacity() const;
+
+  private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Trace trace;
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+    // On cache lines of their own, so that producers and the consumer do not share one.
+    // `new` honors the alignment only from C++17; `Tracer` allocates its buffer in the library.
+    alignas(64) std::atomic<size_t> _head;  // next to push
+    alignas(64) std::atomic<size_t> _tail;  // next to pop
+};
+
+
+class Tracer
+{
+    // `Tracer` samples 1 in `sample_every` scoring calls of each model and writes
+    // their `Trace`s, one tab-separated line each, to a file:
+    //
+    //   method brand_id adgroup_id submodel_key branch code user_adgroup_svr result
+    //   ingest_ns render_ns evaluate_ns postprocess_ns total_ns
+    //
+    // Stage times are -1 for stages that did not run.
+    // Models hand traces over through a lock-free ring; a background thread
+    // drains it to the file. When the ring is full, traces are dropped, never waited for.
+    // Unsampled calls only bump a counter that the model keeps.
+    //
+    // Attach to models with `SvrModel::set_tracer`; one tracer may serve any number
+    // of models and threads, and must outlive them.
+
+  public:
+    Tracer(std::string const & path, size_t sample_every, size_t capacity = 4096);
+
+    // Writes out the remaining traces.
+    ~Tracer();
+
+    Tracer(Tracer const &) = delete;
+    Tracer & operator=(Tracer const &) = delete;
+
+    // Whether the next call is to be traced, counting calls in `counter`:
+    // each caller, e.g. a model, keeps its own, starting at 0.
+    bool sample(size_t & counter) const
+    {
+        if (++counter < _sample_every) {
+            return false;
+        }
+        counter = 0;
+        return true;
+    }
+
+    void submit(Trace const & trace);
+
+    size_t n_written() const;
+    size_t n_dropped() const;
+
+  private:
+    size_t _sample_every;
+    std::unique_ptr<TraceBuffer> _buffer;  // allocated in the library: over-aligned
+    std::ofstream _file;
+    std::atomic<size_t> _n_written;
+    std::atomic<size_t> _n_dropped;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _stop = false;
+    std::thread _drainer;
+
+    void _drain();
+    void _write(Trace const & trace, double ns_per_tick);
+};
+
+}  // namespace
+#endif  // include guard
@@ -25,5 +25,64 @@ class Timer
     std::chrono::high_resolution_clock::time_point _t_start, _t_stop;
 };
 
+
+class Deadline
+{
+    // A point in time by which a scoring call should return.
+    //
+    // A default-constructed `Deadline` is not set and never expires.
+    // Models check the deadline before each expensive stage and,
+    // when the stage would not finish in time, return a fallback result
+    // and flag it as 'degraded'.
+
+    using clock = std::chrono::steady_clock;
+
+  public:
+    Deadline();
+
+    static Deadline after_microseconds(long us);
+
+    bool is_set() const;
+
+    bool expired() const;
+
+    // Whether work expected to take `expected_us` microseconds,
+    // if started now, would end past the deadline.
+    bool would_exceed(double expected_us) const;
+
+    long remaining_microseconds() const;
+
+  private:
+    bool _set = false;
+    clock::time_point _t;
+};
+
+
+class StageCost
+{
+    // Exponentially weighted moving average of the duration of a stage,
+    // used with `Deadline::would_exceed` to decide whether to skip the stage.
+    //
+    // Every run of the stage should be timed and passed to `update`, with or without
+    // a deadline. A skipped run is not observed, so `skip` decays the estimate instead,
+    // and lets every `probe_interval`-th consecutive skip run as a probe, whose duration
+    // replaces the estimate; one slow run therefore cannot keep the stage skipped for good.
+
+  public:
+    double microseconds() const;
+
+    void update(long us);
+
+    // Whether to skip the stage, because it would not finish by `deadline`.
+    bool skip(Deadline const & deadline);
+
+    static unsigned const probe_interval = 16;
+
+  private:
+    double _us = 0.;
+    unsigned _n_skipped = 0;  // consecutive
+    bool _probing = false;
+};
+
 }    // namespace
 #endif  // include guard
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef _SATURN_WARMUP_H_
+#define _SATURN_WARMUP_H_
+
+#include "common.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace saturn
+{
+
+struct WarmupOptions {
+    // What `warm_memory` and the models' `warmup` do before serving; see `WarmupReport`.
+
+    // Fault in every page of the heap and anonymous mappings, where the models live.
+    bool prefault = true;
+
+    // Lock those pages in memory (`mlock`); needs CAP_IPC_LOCK or a high enough
+    // RLIMIT_MEMLOCK, otherwise it is skipped with a note.
+    bool lock = false;
+
+    // Advise transparent huge pages for those mappings (`MADV_HUGEPAGE`), where available.
+    bool huge_pages = true;
+
+    // `SvrModel`: compute the default (-1 traffic) multiplier of every adgroup of the catalog
+    // with a default SVR of its own; the others depend on the brand of the request.
+    bool precompute_defaults = true;
+
+    // `SvrModel`: number of synthetic `run` calls over random adgroups, SVRs and pacings,
+    // to warm caches and branch predictors. They are not counted in `branch_counters()`
+    // nor traced.
+    size_t sweep_calls = 10000;
+    unsigned long seed = 0;
+};
+
+
+struct WarmupReport {
+    double seconds = 0.;               // spent in warmup, summed over the steps
+    size_t regions = 0;                // mappings visited
+    size_t prefaulted_bytes = 0;
+    size_t locked_bytes = 0;
+    size_t huge_page_bytes = 0;        // advised `MADV_HUGEPAGE`
+    size_t rss_before = 0;             // resident set size before `warm_memory`
+    size_t rss_after = 0;              // and after
+    size_t default_multipliers = 0;    // adgroups whose default multiplier was computed
+    size_t sweep_calls = 0;
+    std::vector<std::string> notes;    // steps skipped or failed, and why
+
+    // One `name value` line per item, then the notes.
+    void write(std::ostream & out) const;
+};
+
+
+// Prefault, lock and advise huge pages, as `options` ask, for the heap and every
+// private anonymous writable mapping of the process (Linux; elsewhere a note is added).
+// Call after loading the models and before serving, while no other thread allocates:
+// a mapping that goes away during the walk is skipped only where `MADV_POPULATE_READ`
+// is available, otherwise its pages are read one by one.
+void warm_memory(WarmupOptions const & options, WarmupReport & report);
+
+}  // namespace
+#endif  // include guard
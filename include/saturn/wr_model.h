@@ -3,8 +3,11 @@
 
 #include "common.h"
 #include "feature_engine.h"
+#include "stats.h"
+#include "utils.h"
 
 #include <map>
+#include <memory>
 #include <tuple>
 
 
@@ -15,11 +18,35 @@ class WrModel
   public:
     WrModel(FeatureEngine & feature_engine, std::string path);
 
+    // Bind the model loaded by `prototype` to `context`, which must have the same schema
+    // as the engine of `prototype` (see `FeatureEngine::clone_context`).
+    // The decoded mars models are shared, not decoded again (see the binding constructor
+    // of `SvrModel` for what that relies on); results and timings are per instance.
+    WrModel(WrModel const & prototype, FeatureEngine & context);
+
     ~WrModel();
 
     std::string const & model_id() const;
 
-    double get_prob(std::vector<std::string> input);
+    double get_prob(std::vector<std::string> const & input);
+
+    // Get output probability (`final_prob`) after setting features directly
+    double get_prob();
+
+    // If the models would not finish by `deadline`, use the priors instead,
+    // which are "prior_win_rate" (default 0) and "prior_delivery_rate" (default 1)
+    // in `model_config.json`, and flag the result as degraded. Set "prior_win_rate"
+    // for a model used with deadlines: with the default, a degraded result scores 0
+    // in `BidScorer`.
+    double get_prob(Deadline const & deadline);
+
+    // Cheap substitute for `get_prob` under overload: runs the win-rate model only,
+    // using the prior delivery rate. The result is flagged as degraded.
+    double get_win_prob();
+
+    FeatureEngine& get_features() {
+      return _feature_engine;
+    }
 
     // 0 is success; usually no need to check `message()`.
     // Other values indicate problems; check `message()`.
@@ -44,14 +71,34 @@ class WrModel
     double win_prob() const;
     double dev_prob() const;
     double final_prob() const;
+    bool degraded() const;
+
+    // Number of degraded results since construction.
+    size_t n_degraded() const;
+
+    // Latency of the stages of the calls on this instance; see `StageStats`.
+    // Empty unless the library was built with `SATURN_STATS`.
+    // May be called from any thread, also while the model runs.
+    StageStats stats() const;
+
+    // Estimated memory of the win-rate and delivery models together (shared by bound instances;
+    // they are decoded concurrently, so not told apart); see `MemoryUsage`. The features are in `FeatureEngine::memory_usage`.
+    MemoryUsage memory_usage() const;
 
   private:
     FeatureEngine & _feature_engine;
-    void * _mars_model = nullptr;
-    void * _deliver_model = nullptr;
+    std::shared_ptr<void> _mars_model;
+    std::shared_ptr<void> _deliver_model;
+    size_t _mars_models_bytes = 0;  // heap growth while decoding both, which run concurrently
     double _win_prob = 0.;
     double _dev_prob = 0.;
     double _final_prob = 0.;
+    double _prior_win_prob = 0.;
+    double _prior_dev_prob = 1.;
+    bool _degraded = false;
+    size_t _n_degraded = 0;
+    StageCost _eval_cost;
+    std::unique_ptr<StageRecorder> _stats;
 
     std::string _path;
     std::string _model_id;
@@ -59,6 +106,8 @@ class WrModel
 
     std::string _message = "";
 
+    // Decode the mars models of `_path`.
+    void _load_mars_models();
 };
 
 }  // namespace
@@ -0,0 +1,477 @@
+#include "saturn/saturn.h"
+
+#include <avro/Compiler.hh>
+#include <avro/DataFile.hh>
+#include <avro/Encoder.hh>
+#include <avro/Specific.hh>
+#include <avro/ValidSchema.hh>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+const std::string USAGE =
+        "Usage:\n"
+        "  gen_synthetic --out DIR [--adgroups N] [--brands B] [--brands-per-adgroup M]\n"
+        "                [--requests R] [--seed S] [--no-check]\n"
+        "\n"
+        "Writes a synthetic SVR model directory of N adgroups (default 10000) with M brand\n"
+        "submodels each (default 4, drawn from B brands, default 1000), and a request stream,\n"
+        "for load-time, memory and latency tests against catalog size:\n"
+        "\n"
+        "  DIR/model_config.json             features, default and per-adgroup curves, caps,\n"
+        "                                    default SVRs (see `SvrModel`)\n"
+        "  DIR/model_object.data             the catalog, one submodel per line of the spec\n"
+        "  DIR/brand_default_svr.txt         every brand\n"
+        "  DIR/adgroup_quantile_cutoff.txt   5% of the adgroups ('placed')\n"
+        "  DIR/catalog_spec.tsv              key, loc, scale: one line per catalog submodel,\n"
+        "                                    `/adgroup` and `/adgroup/b_brand`\n"
+        "  DIR/data_test/adgroup_ids.txt     the adgroups (as `test_svr`, `bench` expect)\n"
+        "  DIR/requests.tsv                  R requests (default 100000) for `replay` and\n"
+        "                                    `replay_bench` (see `RequestParser`)\n"
+        "\n"
+        "Adgroups are keyed in the config and cutoff files as `run` receives them and as\n"
+        "`requests.tsv` sends them, with a leading '/'; `adgroup_ids.txt` lists them without.\n"
+        "\n"
+        "`model_object.data` is an Avro data file in the layout `SvrModel` reads, `class_name`\n"
+        "and `models`, an array of `key` and `model`. Each submodel is a mars\n"
+        "`BinaryRandomForestClassifier` of one tree over `user_extlba`: 8 leaves, a step\n"
+        "version of the logistic CDF with the spec's `loc` and `scale` (see `CATALOG_SCHEMA`).\n"
+        "The tree record is the scikit-learn layout `CompiledForest::from_avro` reads, which has\n"
+        "not been checked against a mars `cc_dump`. So after writing, the directory is loaded\n"
+        "with `SvrModel` and a sample of the submodels is run (skip with --no-check); if the\n"
+        "mars in use does not decode it, this fails, and the catalog should be built from\n"
+        "`catalog_spec.tsv` in Python and written with `cc_dump` instead.\n"
+        "\n"
+        "Request traffic is skewed: adgroup popularity follows Zipf's law (s = 1);\n"
+        "2% of requests name an adgroup outside the catalog, 20% are -1 traffic,\n"
+        "and 30% carry a pacing. Output is deterministic for a given seed.";
+
+
+// `model_object.data`: a `CatalogModel` of one-tree random forests.
+const std::string CATALOG_SCHEMA = R"({
+    "type": "record", "name": "CatalogModel",
+    "fields": [
+        {"name": "class_name", "type": "string"},
+        {"name": "models", "type": {"type": "array", "items": {
+            "type": "record", "name": "CatalogEntry",
+            "fields": [
+                {"name": "key", "type": "string"},
+                {"name": "model", "type": {
+                    "type": "record", "name": "BinaryRandomForestClassifier",
+                    "fields": [
+                        {"name": "class_name", "type": "string"},
+                        {"name": "predictor_count", "type": "int"},
+                        {"name": "trees", "type": {"type": "array", "items": {
+                            "type": "record", "name": "Tree",
+                            "fields": [
+                                {"name": "children_left", "type": {"type": "array", "items": "int"}},
+                                {"name": "children_right", "type": {"type": "array", "items": "int"}},
+                                {"name": "feature", "type": {"type": "array", "items": "int"}},
+                                {"name": "threshold", "type": {"type": "array", "items": "double"}},
+                                {"name": "value", "type": {"type": "array", "items": "double"}}
+                            ]}}}
+                    ]}}
+            ]}}}
+    ]
+})";
+
+
+struct Submodel {
+    std::string key;
+    double loc;
+    double scale;
+};
+
+
+struct Tree {
+    // scikit-learn layout: node 0 is the root; a leaf has `children_left[i] == -1`.
+    std::vector<int> children_left;
+    std::vector<int> children_right;
+    std::vector<int> feature;
+    std::vector<double> threshold;
+    std::vector<double> value;
+
+    // Appends the subtree over leaves [lo, hi) of `n_leaves` and returns its root.
+    // Leaf i holds the middle quantile of its bin, (i + 0.5) / n_leaves; the splits are
+    // the logistic quantiles between the bins.
+    int grow(Submodel const & m, int lo, int hi, int n_leaves)
+    {
+        int node = static_cast<int>(value.size());
+        children_left.push_back(-1);
+        children_right.push_back(-1);
+        feature.push_back(-2);
+        threshold.push_back(-2.);
+        value.push_back((lo + hi) / 2. / n_leaves);
+        if (hi - lo > 1) {
+            int mid = (lo + hi) / 2;
+            feature[node] = 0;
+            threshold[node] = m.loc + m.scale * std::log(static_cast<double>(mid) / (n_leaves - mid));
+            children_left[node] = grow(m, lo, mid, n_leaves);
+            children_right[node] = grow(m, mid, hi, n_leaves);
+        }
+        return node;
+    }
+};
+
+
+// The catalog as `CATALOG_SCHEMA`, encoded as `next` produces the submodels: the `models`
+// array goes out in blocks, so that only one block of submodels is held at a time,
+// not a `GenericDatum` of the whole catalog.
+struct StreamedCatalog {
+    std::function<bool(Submodel &)> next;  // false after the last submodel
+};
+
+
+namespace avro
+{
+
+template <>
+struct codec_traits<StreamedCatalog> {
+    static void encode_ints(Encoder & e, std::vector<int> const & v)
+    {
+        e.arrayStart();
+        e.setItemCount(v.size());
+        for (auto x : v) {
+            e.startItem();
+            e.encodeInt(x);
+        }
+        e.arrayEnd();
+    }
+
+    static void encode_doubles(Encoder & e, std::vector<double> const & v)
+    {
+        e.arrayStart();
+        e.setItemCount(v.size());
+        for (auto x : v) {
+            e.startItem();
+            e.encodeDouble(x);
+        }
+        e.arrayEnd();
+    }
+
+    static void encode(Encoder & e, StreamedCatalog const & catalog)
+    {
+        size_t const BLOCK = 1024;
+        e.encodeString("CatalogModel");
+        e.arrayStart();
+        std::vector<Submodel> block(BLOCK);
+        for (;;) {
+            size_t n = 0;
+            while (n < BLOCK && catalog.next(block[n])) {
+                n++;
+            }
+            if (n == 0) {
+                break;
+            }
+            e.setItemCount(n);
+            for (size_t i = 0; i < n; i++) {
+                Tree tree;
+                tree.grow(block[i], 0, 8, 8);
+                e.startItem();
+                e.encodeString(block[i].key);
+                e.encodeString("BinaryRandomForestClassifier");
+                e.encodeInt(1);
+                e.arrayStart();
+                e.setItemCount(1);
+                e.startItem();
+                encode_ints(e, tree.children_left);
+                encode_ints(e, tree.children_right);
+                encode_ints(e, tree.feature);
+                encode_doubles(e, tree.threshold);
+                encode_doubles(e, tree.value);
+                e.arrayEnd();
+            }
+        }
+        e.arrayEnd();
+    }
+};
+
+}  // namespace avro
+
+
+// `mkdir -p`: creates `path` and its missing parents; false on failure, with `errno` set.
+bool make_dirs(std::string const & path)
+{
+    for (size_t i = 1; i <= path.size(); i++) {
+        if (i < path.size() && path[i] != '/') {
+            continue;
+        }
+        auto dir = path.substr(0, i);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+std::string adgroup_name(size_t i)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "ag%07zu", i);
+    return buf;
+}
+
+
+std::string brand_name(size_t i)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "br%06zu", i);
+    return buf;
+}
+
+
+// The `j`-th brand of adgroup `i`, among `n_brands`; a fixed scatter, so that
+// the requests can pick matching brands without storing the assignment.
+size_t brand_of(size_t i, size_t j, size_t n_brands)
+{
+    return (i * 7919 + j * 104729) % n_brands;
+}
+
+
+// Loads `dir` with `SvrModel` and runs each sampled adgroup submodel at an SVR well below
+// and one well above its `loc`: the submodel must be in the catalog, and on the multiplier
+// curve the higher SVR must get the higher multiplier. Says why and returns false if not.
+bool check_load(std::string const & dir, std::vector<Submodel> const & samples)
+{
+    try {
+        saturn::FeatureEngine feature_engine;
+        saturn::SvrModel model(feature_engine, dir);
+        for (auto const & m : samples) {
+            if (!model.has_model(m.key)) {
+                std::cerr << "check: no submodel `" << m.key << "` in the catalog" << std::endl;
+                return false;
+            }
+            double multipliers[2];
+            double const svrs[2] = {0.01 * m.loc, 10. * m.loc};
+            for (size_t k = 0; k < 2; k++) {
+                if (model.run("", m.key, svrs[k]) != 0) {
+                    std::cerr << "check: `" << m.key << "`: " << model.message() << std::endl;
+                    return false;
+                }
+                multipliers[k] = model.bid_multiplier();
+            }
+            if (model.branch() == saturn::SvrModel::Branch::curve && !(multipliers[1] > multipliers[0])) {
+                std::cerr << "check: `" << m.key << "` gives multiplier " << multipliers[0] << " at SVR "
+                          << svrs[0] << " and " << multipliers[1] << " at " << svrs[1] << std::endl;
+                return false;
+            }
+        }
+    } catch (std::exception const & e) {
+        std::cerr << "check: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char const * const * argv)
+{
+    std::string out;
+    size_t n_adgroups = 10000;
+    size_t n_brands = 1000;
+    size_t brands_per_adgroup = 4;
+    size_t n_requests = 100000;
+    unsigned long seed = 0;
+    bool check = true;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--out" && has_value) {
+            out = argv[++i];
+        } else if (arg == "--adgroups" && has_value) {
+            n_adgroups = std::stoul(argv[++i]);
+        } else if (arg == "--brands" && has_value) {
+            n_brands = std::stoul(argv[++i]);
+        } else if (arg == "--brands-per-adgroup" && has_value) {
+            brands_per_adgroup = std::stoul(argv[++i]);
+        } else if (arg == "--requests" && has_value) {
+            n_requests = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && has_value) {
+            seed = std::stoul(argv[++i]);
+        } else if (arg == "--no-check") {
+            check = false;
+        } else {
+            std::cout << USAGE << std::endl;
+            return 1;
+        }
+    }
+    while (!out.empty() && out.back() == '/') {
+        out.pop_back();
+    }
+    if (out.empty() || n_adgroups == 0 || n_brands == 0) {
+        std::cout << USAGE << std::endl;
+        return 1;
+    }
+    brands_per_adgroup = std::min(brands_per_adgroup, n_brands);
+
+    if (!make_dirs(out + "/data_test")) {
+        std::cerr << "cannot create '" << out << "/data_test': " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    std::normal_distribution<double> normal(0., 1.);
+
+    // model_config.json
+    {
+        std::ofstream f(out + "/model_config.json");
+        f << "{\n"
+          << "  \"type\": \"CatalogModel\",\n"
+          << "  \"features\": [\n"
+          << "    {\"type\": \"DirectNumber\", \"args\": {\"column\": \"user_extlba\"}}\n"
+          << "  ],\n"
+          << "  \"default_nonlba_svr\": 0.0001,\n"
+          << "  \"default_lba_svr\": 0.001,\n"
+          << "  \"adjust_multiplier_curve_for_pacing\": 1,\n"
+          << "  \"default_multiplier_curve\": {\"mu\": 0.0, \"sigma\": 0.5},\n"
+          << "  \"default_multiplier_cap\": 1.5,\n"
+          << "  \"fallback_multiplier\": 1.0,\n";
+        // 10% of the adgroups have their own curve, 10% their own cap, 1% their own default SVR.
+        char const * sep = "\n";
+        f << "  \"adgroup_default_svr\": [";
+        for (size_t i = 0; i < n_adgroups; i += 100) {
+            f << sep << "    {\"adgroup_id\": \"/" << adgroup_name(i) << "\", \"nonlba\": "
+              << 0.0001 * (1. + uniform(rng)) << ", \"lba\": " << 0.001 * (1. + uniform(rng)) << "}";
+            sep = ",\n";
+        }
+        f << "\n  ],\n";
+        sep = "\n";
+        f << "  \"adgroup_multiplier_curve\": [";
+        for (size_t i = 3; i < n_adgroups; i += 10) {
+            f << sep << "    {\"adgroup_id\": \"/" << adgroup_name(i) << "\", \"mu\": "
+              << 0.5 * normal(rng) << ", \"sigma\": " << 0.3 + uniform(rng) << "}";
+            sep = ",\n";
+        }
+        f << "\n  ],\n";
+        sep = "\n";
+        f << "  \"adgroup_multiplier_cap\": [";
+        for (size_t i = 7; i < n_adgroups; i += 10) {
+            f << sep << "    {\"adgroup_id\": \"/" << adgroup_name(i) << "\", \"cap\": "
+              << 1. + 2. * uniform(rng) << "}";
+            sep = ",\n";
+        }
+        f << "\n  ]\n}\n";
+    }
+
+    // brand_default_svr.txt
+    {
+        std::ofstream f(out + "/brand_default_svr.txt");
+        for (size_t b = 0; b < n_brands; b++) {
+            f << brand_name(b) << ' ' << 0.0001 * (1. + uniform(rng)) << ' ' << 0.001 * (1. + uniform(rng)) << '\n';
+        }
+    }
+
+    // adgroup_quantile_cutoff.txt
+    {
+        std::ofstream f(out + "/adgroup_quantile_cutoff.txt");
+        for (size_t i = 5; i < n_adgroups; i += 20) {
+            f << '/' << adgroup_name(i) << ' ' << 0.5 + 0.45 * uniform(rng) << '\n';
+        }
+    }
+
+    // catalog_spec.tsv, model_object.data, data_test/adgroup_ids.txt
+    std::vector<Submodel> samples;  // about 100 adgroup submodels, for `check_load`
+    {
+        std::ofstream spec(out + "/catalog_spec.tsv");
+        std::ofstream ids(out + "/data_test/adgroup_ids.txt");
+        spec << "key\tloc\tscale\n";
+
+        // The adgroup submodel, then its brand submodels, adgroup by adgroup.
+        size_t i = 0;  // adgroup of the next submodel
+        size_t j = 0;  // 0 for the adgroup's own submodel, k + 1 for its k-th brand
+        double loc = 0.;
+        StreamedCatalog catalog;
+        catalog.next = [&](Submodel & m) {
+            if (i == n_adgroups) {
+                return false;
+            }
+            auto adgroup = adgroup_name(i);
+            if (j == 0) {
+                ids << adgroup << '\n';
+                // Quantiles of user-level SVR, which is around 1e-4 to 1e-2.
+                loc = 0.001 * std::exp(normal(rng));
+                m.key = '/' + adgroup;
+                m.loc = loc;
+            } else {
+                m.key = '/' + adgroup + "/b_" + brand_name(brand_of(i, j - 1, n_brands));
+                m.loc = loc * std::exp(0.3 * normal(rng));
+            }
+            m.scale = m.loc * (0.2 + uniform(rng));
+            spec << m.key << '\t' << m.loc << '\t' << m.scale << '\n';
+            if (j == 0 && i % std::max<size_t>(n_adgroups / 100, 1) == 0) {
+                samples.push_back(m);
+            }
+            if (++j > brands_per_adgroup) {
+                i++;
+                j = 0;
+            }
+            return true;
+        };
+
+        auto schema = avro::compileJsonSchemaFromString(CATALOG_SCHEMA);
+        avro::DataFileWriter<StreamedCatalog> writer((out + "/model_object.data").c_str(), schema);
+        writer.write(catalog);
+        writer.close();
+    }
+
+    // requests.tsv
+    {
+        // Zipf(1) popularity over the adgroups.
+        std::vector<double> cdf(n_adgroups);
+        double sum = 0.;
+        for (size_t i = 0; i < n_adgroups; i++) {
+            sum += 1. / static_cast<double>(i + 1);
+            cdf[i] = sum;
+        }
+        // A fixed shuffle, so that popularity does not follow the adgroup IDs.
+        std::vector<size_t> order(n_adgroups);
+        for (size_t i = 0; i < n_adgroups; i++) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), rng);
+
+        char const * oses[] = {"ios", "android", "other"};
+        char const * device_types[] = {"phone", "tablet", "desktop", "ctv"};
+
+        std::ofstream f(out + "/requests.tsv");
+        f << "brand_id\tadgroup_id\tuser_adgroup_svr\tpacing\tctr_os\tctr_device_type\n";
+        for (size_t r = 0; r < n_requests; r++) {
+            auto rank = static_cast<size_t>(
+                std::lower_bound(cdf.begin(), cdf.end(), uniform(rng) * sum) - cdf.begin());
+            size_t i = order[std::min(rank, n_adgroups - 1)];
+            std::string adgroup = (uniform(rng) < 0.02) ? adgroup_name(n_adgroups + i) : adgroup_name(i);
+            auto brand = brand_name(brand_of(i, static_cast<size_t>(uniform(rng) * brands_per_adgroup), n_brands));
+            double svr = (uniform(rng) < 0.2) ? -1. : 0.001 * std::exp(normal(rng));
+            double pacing = (uniform(rng) < 0.3) ? uniform(rng) : -1.;
+            f << brand << "\t/" << adgroup << '\t' << svr << '\t' << pacing << '\t'
+              << oses[static_cast<size_t>(uniform(rng) * 3) % 3] << '\t'
+              << device_types[static_cast<size_t>(uniform(rng) * 4) % 4] << '\n';
+        }
+    }
+
+    std::cerr << "wrote " << out << ": " << n_adgroups << " adgroups, "
+              << n_adgroups * (1 + brands_per_adgroup) << " submodels, "
+              << n_requests << " requests" << std::endl;
+
+    if (check) {
+        if (!check_load(out, samples)) {
+            return 1;
+        }
+        std::cerr << "loaded " << out << " with `SvrModel` and ran " << samples.size() << " submodels" << std::endl;
+    }
+    return 0;
+}
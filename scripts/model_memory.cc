@@ -0,0 +1,86 @@
+#include "saturn/saturn.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace saturn;
+
+const std::string USAGE =
+        "Usage:\n"
+        "  model_memory [--svr DIR] [--ctr DIR] [--wr DIR]\n"
+        "\n"
+        "Loads the models, one at a time and without serving traffic, and prints their\n"
+        "`memory_usage()` and that of the `FeatureEngine` (name, entries, bytes; `~` marks\n"
+        "the mars objects, measured as heap growth), then the growth of the heap and of the\n"
+        "resident set size over each load.";
+
+
+struct Growth {
+    size_t heap0 = heap_in_use();
+    size_t rss0 = resident_bytes();
+
+    void print(std::string const & what) const
+    {
+        auto heap = heap_in_use();
+        auto rss = resident_bytes();
+        std::cout << what << " load: heap +" << (heap > heap0 ? heap - heap0 : 0)
+                  << " bytes, RSS +" << (rss > rss0 ? rss - rss0 : 0) << " bytes" << std::endl;
+    }
+};
+
+
+int main(int argc, char const * const * argv)
+{
+    std::string svr, ctr, wr;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--svr" && has_value) {
+            svr = strip_slash(argv[++i]);
+        } else if (arg == "--ctr" && has_value) {
+            ctr = strip_slash(argv[++i]);
+        } else if (arg == "--wr" && has_value) {
+            wr = strip_slash(argv[++i]);
+        } else {
+            std::cout << USAGE << std::endl;
+            return 1;
+        }
+    }
+    if (svr.empty() && ctr.empty() && wr.empty()) {
+        std::cout << USAGE << std::endl;
+        return 1;
+    }
+
+    Growth total;
+    FeatureEngine feature_engine;
+    std::unique_ptr<SvrModel> svr_model;
+    std::unique_ptr<ctrModel> ctr_model;
+    std::unique_ptr<WrModel> wr_model;
+    MemoryUsage usage;
+
+    if (!svr.empty()) {
+        Growth growth;
+        svr_model.reset(new SvrModel(feature_engine, svr));
+        growth.print("svr");
+        usage.add("svr.", svr_model->memory_usage());
+    }
+    if (!ctr.empty()) {
+        Growth growth;
+        ctr_model.reset(new ctrModel(feature_engine, ctr));
+        growth.print("ctr");
+        usage.add("ctr.", ctr_model->memory_usage());
+    }
+    if (!wr.empty()) {
+        Growth growth;
+        wr_model.reset(new WrModel(feature_engine, wr));
+        growth.print("wr");
+        usage.add("wr.", wr_model->memory_usage());
+    }
+    total.print("total");
+    usage.add("features.", feature_engine.memory_usage());
+
+    std::cout << std::endl;
+    usage.write(std::cout);
+    return 0;
+}
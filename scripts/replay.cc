@@ -0,0 +1,195 @@
+#include "saturn/saturn.h"
+#include "saturn/utils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace saturn;
+
+const std::string USAGE =
+        "Usage:\n"
+        "  replay [--svr DIR] [--ctr DIR] [--wr DIR] [--threads N] [--chunk K] [--block B]\n"
+        "         [--trace FILE [--trace-every N]] request_file\n"
+        "\n"
+        "Scores a tab-separated file of logged requests (header line first; see `RequestParser`),\n"
+        "or a binary replay file made by `replay_convert` (see `ReplayFile`), which needs no parsing,\n"
+        "and writes one line per request to stdout, in input order:\n"
+        "  code  svr  bid_multiplier  ctr_prob  wr_final_prob\n"
+        "`--threads 0` (the default) uses all hardware threads.\n"
+        "`--trace` writes a `Tracer` trace of 1 in N (default 1000) SVR calls per model to FILE.\n"
+        "Throughput is reported on stderr.";
+
+
+// Score `ctx.request`, filled in by the caller.
+std::string score(ModelContext & ctx)
+{
+    std::ostringstream out;
+    try {
+        if (!ctx.svr_model) {
+            ctx.request.svr_calls.clear();
+        }
+        ctx.model_set.run(ctx.request, ctx.result);
+        if (ctx.result.svr.empty()) {
+            out << 0 << '\t' << 0. << '\t' << 0.;
+        } else {
+            auto const & s = ctx.result.svr[0];
+            out << s.code << '\t' << s.svr << '\t' << s.bid_multiplier;
+        }
+        out << '\t' << ctx.result.ctr_prob << '\t' << ctx.result.wr_final_prob;
+    } catch (std::exception const & e) {
+        out << -1 << '\t' << "error: " << e.what();
+    }
+    return out.str();
+}
+
+
+std::string score_line(ModelContext & ctx, RequestParser const & parser, std::string const & line)
+{
+    try {
+        parser.parse(line, ctx.request);
+    } catch (std::exception const & e) {
+        return std::string("-1\terror: ") + e.what();
+    }
+    return score(ctx);
+}
+
+
+int main(int argc, char const * const * argv)
+{
+    std::string svr, ctr, wr, input, trace;
+    size_t trace_every = 1000;
+    size_t n_threads = 0;
+    size_t chunk_size = 256;
+    size_t block_size = 1 << 16;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--svr" && has_value) {
+            svr = strip_slash(argv[++i]);
+        } else if (arg == "--ctr" && has_value) {
+            ctr = strip_slash(argv[++i]);
+        } else if (arg == "--wr" && has_value) {
+            wr = strip_slash(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            n_threads = std::stoul(argv[++i]);
+        } else if (arg == "--chunk" && has_value) {
+            chunk_size = std::stoul(argv[++i]);
+        } else if (arg == "--block" && has_value) {
+            block_size = std::stoul(argv[++i]);
+        } else if (arg == "--trace" && has_value) {
+            trace = argv[++i];
+        } else if (arg == "--trace-every" && has_value) {
+            trace_every = std::stoul(argv[++i]);
+        } else if (input.empty() && arg.size() > 0 && arg[0] != '-') {
+            input = arg;
+        } else {
+            std::cout << USAGE << std::endl;
+            return 1;
+        }
+    }
+    if (input.empty() || chunk_size == 0 || block_size == 0 || (svr.empty() && ctr.empty() && wr.empty())) {
+        std::cout << USAGE << std::endl;
+        return 1;
+    }
+
+    // A binary replay file is scored in place; a text file is parsed line by line.
+    std::unique_ptr<ReplayFile> replay_file;
+    std::unique_ptr<RequestParser> parser;
+    std::ifstream file;
+    if (ReplayFile::is_replay_file(input)) {
+        try {
+            replay_file.reset(new ReplayFile(input));
+        } catch (SaturnError const & e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    } else {
+        file.open(input);
+        std::string header;
+        if (!file || !std::getline(file, header)) {
+            std::cerr << "cannot read '" << input << "'" << std::endl;
+            return 1;
+        }
+        parser.reset(new RequestParser(header));
+    }
+
+    n_threads = resolve_thread_count(n_threads);
+    auto load_timer = Timer();
+    load_timer.start();
+    std::unique_ptr<Tracer> tracer;  // declared first: outlives the models
+    std::vector<std::unique_ptr<ModelContext>> contexts;
+    contexts.emplace_back(new ModelContext(svr, ctr, wr));
+    if (!trace.empty() && contexts[0]->svr_model) {
+        tracer.reset(new Tracer(trace, trace_every));
+        contexts[0]->svr_model->set_tracer(tracer.get());  // bound copies below inherit it
+    }
+    for (size_t t = 1; t < n_threads; t++) {
+        contexts.emplace_back(new ModelContext(*contexts[0]));
+    }
+    load_timer.stop();
+
+    // Lines (or rows) are read in blocks; each block is scored in parallel,
+    // then written out in order.
+    std::vector<std::string> lines(block_size);
+    std::vector<std::string> outputs(block_size);
+    size_t n_rows = 0;
+    size_t n_errors = 0;
+    auto timer = Timer();
+    timer.start();
+    while (true) {
+        size_t n = 0;
+        if (replay_file) {
+            n = std::min(block_size, replay_file->n_rows() - n_rows);
+        } else {
+            while (n < block_size && std::getline(file, lines[n])) {
+                if (!lines[n].empty()) {
+                    n++;
+                }
+            }
+        }
+        if (n == 0) {
+            break;
+        }
+        parallel_chunks(n, chunk_size, n_threads, [&](size_t worker, size_t begin, size_t end) {
+            auto & ctx = *contexts[worker];
+            for (size_t i = begin; i < end; i++) {
+                if (replay_file) {
+                    replay_file->fill(n_rows + i, ctx.request);
+                    outputs[i] = score(ctx);
+                } else {
+                    outputs[i] = score_line(ctx, *parser, lines[i]);
+                }
+            }
+        });
+        for (size_t i = 0; i < n; i++) {
+            if (outputs[i].compare(0, 3, "-1\t") == 0) {
+                n_errors++;
+            }
+            std::cout << outputs[i] << '\n';
+        }
+        n_rows += n;
+    }
+    std::cout.flush();
+    timer.stop();
+
+    std::cerr << "threads:      " << n_threads << std::endl;
+    std::cerr << "load seconds: " << load_timer.seconds() << std::endl;
+    std::cerr << "rows:         " << n_rows << std::endl;
+    std::cerr << "errors:       " << n_errors << std::endl;
+    std::cerr << "seconds:      " << timer.seconds() << std::endl;
+    std::cerr << "rows/sec:     " << (timer.seconds() > 0 ? n_rows / timer.seconds() : 0.) << std::endl;
+    if (tracer) {
+        contexts.clear();
+        tracer.reset();  // writes out the remaining traces
+        std::cerr << "traces in:    " << trace << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include "saturn/saturn.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace saturn;
+
+const std::string USAGE =
+        "Usage:\n"
+        "  replay_convert [--delimiter C] request_file out_file\n"
+        "  replay_convert --svr-test DIR [out_file]\n"
+        "\n"
+        "Converts logged requests from text to the binary, columnar format of `ReplayFile`,\n"
+        "which `replay`, `replay_bench` and `test_svr` read without parsing.\n"
+        "\n"
+        "The first form converts a delimiter-separated file with a header line, as read by\n"
+        "`replay` (see `RequestParser`). Int and float `FeatureEngine` fields, `user_adgroup_svr`\n"
+        "and `pacing` are stored as numbers, every other column as strings.\n"
+        "\n"
+        "The second form converts the test data of an SVR model directory, as read by `test_svr`:\n"
+        "`data_test/raw.txt` with the names and types in `data_test/column_list.txt`, if present,\n"
+        "and one float column `user_extlba/<adgroup_id>` per line of `data_test/adgroup_ids.txt`\n"
+        "from `data_test/user_extlba/<adgroup_id>.txt`. `out_file` defaults to\n"
+        "`DIR/data_test/replay.rpl`, where `test_svr` looks for it.";
+
+
+ReplayFile::Type column_list_type(std::string const & type)
+{
+    if (type == "str") {
+        return ReplayFile::Type::string;
+    }
+    if (type == "int") {
+        return ReplayFile::Type::int32;
+    }
+    if (type == "float") {
+        return ReplayFile::Type::float64;
+    }
+    throw SaturnError("unrecognized type '" + type + "' in column_list.txt");
+}
+
+
+size_t convert_requests(std::string const & input, char delimiter, std::string const & output)
+{
+    std::ifstream file(input);
+    std::string line;
+    if (!file || !std::getline(file, line)) {
+        throw SaturnError("cannot read '" + input + "'");
+    }
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    std::vector<std::string> names;
+    split_line(line, delimiter, names);
+    std::vector<ReplayFile::Type> types;
+    for (auto const & name : names) {
+        types.push_back(ReplayWriter::column_type(name));
+    }
+
+    ReplayWriter writer(names, types);
+    std::vector<std::string> parts;
+    size_t line_no = 1;
+    while (std::getline(file, line)) {
+        line_no++;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        split_line(line, delimiter, parts);
+        try {
+            writer.add_row(parts);
+        } catch (SaturnError const & e) {
+            throw SaturnError(input + ":" + std::to_string(line_no) + ": " + e.what());
+        }
+    }
+    writer.write(output);
+    return writer.n_rows();
+}
+
+
+size_t convert_svr_test(std::string const & dir, std::string const & output)
+{
+    auto data = dir + "/data_test/";
+
+    // Request-level fields, if any.
+    std::vector<std::string> names;
+    std::vector<ReplayFile::Type> types;
+    {
+        std::ifstream file(data + "column_list.txt");
+        std::string name, type;
+        while (file >> name >> type) {
+            names.push_back(name);
+            types.push_back(column_list_type(type));
+        }
+    }
+    size_t n_fields = names.size();
+
+    std::vector<std::string> adgroup_ids;
+    {
+        std::ifstream file(data + "adgroup_ids.txt");
+        std::string adgroup_id;
+        while (file >> adgroup_id) {
+            adgroup_ids.push_back(adgroup_id);
+        }
+    }
+    if (adgroup_ids.empty()) {
+        throw SaturnError("no adgroups in '" + data + "adgroup_ids.txt'");
+    }
+    for (auto const & adgroup_id : adgroup_ids) {
+        names.push_back("user_extlba/" + adgroup_id);
+        types.push_back(ReplayFile::Type::float64);
+    }
+
+    // Rows are added from `raw.txt` if present, otherwise from the first adgroup file;
+    // the other columns are set in the same rows.
+    std::vector<std::unique_ptr<std::ifstream>> svr_files;
+    for (auto const & adgroup_id : adgroup_ids) {
+        auto path = data + "user_extlba/" + adgroup_id + ".txt";
+        svr_files.emplace_back(new std::ifstream(path));
+        if (!*svr_files.back()) {
+            throw SaturnError("cannot read '" + path + "'");
+        }
+    }
+    std::ifstream raw;
+    if (n_fields > 0) {
+        raw.open(data + "raw.txt");
+        if (!raw) {
+            throw SaturnError("cannot read '" + data + "raw.txt'");
+        }
+    }
+
+    ReplayWriter writer(names, types);
+    std::vector<std::string> row(names.size(), "0");
+    std::vector<std::string> parts;
+    std::string line, value;
+    while (true) {
+        if (n_fields > 0) {
+            if (!std::getline(raw, line)) {
+                break;
+            }
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            split_line(line, '\t', parts);
+            if (parts.size() < n_fields) {
+                throw SaturnError("too few columns in line " + std::to_string(writer.n_rows() + 1) + " of raw.txt");
+            }
+            std::copy(parts.begin(), parts.begin() + static_cast<std::ptrdiff_t>(n_fields), row.begin());
+        } else if (!(*svr_files[0] >> value)) {
+            break;
+        } else {
+            row[0] = value;
+        }
+        writer.add_row(row);
+        for (size_t i = (n_fields > 0 ? 0 : 1); i < adgroup_ids.size(); i++) {
+            if (!(*svr_files[i] >> value)) {
+                throw SaturnError("user-level SVR files contain different number of records");
+            }
+            writer.set(n_fields + i, value);
+        }
+    }
+    for (auto const & f : svr_files) {
+        if (*f >> value) {
+            throw SaturnError("user-level SVR files contain different number of records");
+        }
+    }
+    writer.write(output);
+    return writer.n_rows();
+}
+
+
+int main(int argc, char const * const * argv)
+{
+    std::string svr_test;
+    char delimiter = '\t';
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--svr-test" && has_value) {
+            svr_test = strip_slash(argv[++i]);
+        } else if (arg == "--delimiter" && has_value && std::string(argv[i + 1]).size() == 1) {
+            delimiter = argv[++i][0];
+        } else if (arg.size() > 0 && arg[0] != '-') {
+            files.push_back(arg);
+        } else {
+            std::cout << USAGE << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        if (!svr_test.empty() && files.size() <= 1) {
+            auto output = files.empty() ? svr_test + "/data_test/replay.rpl" : files[0];
+            auto n = convert_svr_test(svr_test, output);
+            std::cerr << "wrote " << n << " rows to " << output << std::endl;
+        } else if (svr_test.empty() && files.size() == 2) {
+            auto n = convert_requests(files[0], delimiter, files[1]);
+            std::cerr << "wrote " << n << " rows to " << files[1] << std::endl;
+        } else {
+            std::cout << USAGE << std::endl;
+            return 1;
+        }
+    } catch (std::exception const & e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
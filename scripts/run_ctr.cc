@@ -20,7 +20,9 @@ using namespace saturn;
 
 const std::string USAGE =
         "Usage:\n"
-        "  run_Ctr model_file_path run features\n";
+        "  run_Ctr model_file_path run features\n"
+        "\n"
+        "The exit code is 0 on success, 1 on bad usage and 2 if the features are malformed.\n";
 
 
 int run(saturn::ctrModel * ctr_model, int argc, char const * const * argv)
@@ -36,7 +38,13 @@ int run(saturn::ctrModel * ctr_model, int argc, char const * const * argv)
   //   std::cout << input[i] << std::endl;
   //   }
  //   std::cout << "inside Run"<< std::endl;
-    ctr_model->get_prob(input);
+    // The probability is read from `prob()`; the exit code is the status alone.
+    try {
+        ctr_model->get_prob(input);
+    } catch (std::exception const & e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 2;
+    }
     return 0;
 }
 
@@ -45,8 +53,10 @@ int main(int argc, char const * const * argv)
 {
     auto timer = Timer();
     double prob = 0.0;
+    int exit_code = 0;
     if (argc < 18) { // What is count including features + args. 
-        return 0;
+        std::cout << USAGE << std::endl;
+        return 1;
     } else {
         std::string modelpath = std::string(argv[1]);
         while (modelpath.back() == '/') {
@@ -58,12 +68,13 @@ int main(int argc, char const * const * argv)
     auto ctr_model = new saturn::ctrModel(feature_engine, modelpath);
  //   std::cout << "MOdel Parsed from FEATYRE"<< std::endl;
     timer.start();
-    prob = run(ctr_model, argc, argv);
+    exit_code = run(ctr_model, argc, argv);
     timer.stop();
-    std::cout << "prob:" << ctr_model->prob() << std::endl;
+    prob = ctr_model->prob();
+    std::cout << "prob:" << prob << std::endl;
     delete ctr_model;
     }
     std::cout << "Time:" << (double)timer.milliseconds() << "milliseconds"<< std::endl;
     std::cout << "Probability: " << prob << "prod"<< std::endl;
-    return 1;
+    return exit_code;
 }
@@ -0,0 +1,332 @@
+#include "saturn/saturn.h"
+#include "saturn/utils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace saturn;
+
+const std::string USAGE =
+        "Usage:\n"
+        "  saturn_score [--svr DIR] [--ctr DIR] [--wr DIR] [--manifest FILE] [--threads N] [--batch B]\n"
+        "               [--chunk K] [--format tsv|binary] [--delimiter C] [--progress SECONDS]\n"
+        "               [--warmup N [--lock]] [request_file]\n"
+        "\n"
+        "Loads the models concurrently (see `ModelLoader`), given by directory or by a manifest\n"
+        "of `kind path` lines (kind `svr`, `ctr` or `wr`, at most one each), and scores a stream of requests, one per line, read from\n"
+        "`request_file` or, if it is missing or '-', from stdin. The first line is a header\n"
+        "naming the columns (see `RequestParser`). `request_file` may also be a binary replay\n"
+        "file made by `replay_convert` (see `ReplayFile`), which is read in place.\n"
+        "\n"
+        "Requests are read in batches of B (default 65536), each scored in parallel on N threads\n"
+        "(default 0: all hardware threads) in chunks of K (default 256), and written to stdout\n"
+        "in input order, one result per request:\n"
+        "\n"
+        "  tsv     a header line, then\n"
+        "          code  svr  bid_multiplier  ctr_prob  wr_win_prob  wr_final_prob  error\n"
+        "          `code` is that of `SvrModel::run` (0 without an SVR call), or -1 if the\n"
+        "          request failed otherwise; a request fails if `code` is not 0, with the\n"
+        "          reason in `error` (otherwise empty)\n"
+        "  binary  48-byte records in native byte order:\n"
+        "          int32 code, int32 0, then doubles svr, bid_multiplier, ctr_prob,\n"
+        "          wr_win_prob, wr_final_prob; reasons of failures go to stderr\n"
+        "\n"
+        "`--warmup N` warms up before scoring (see `WarmupOptions`): the default multiplier of every\n"
+        "adgroup with its own default SVR, N synthetic SVR calls, then prefaulting (`--lock`: and locking) model memory.\n"
+        "\n"
+        "Load times (wall against CPU), the warmup and throughput are reported on stderr, throughput also\n"
+        "every `--progress` seconds if given.\n"
+        "The exit code is 0 if every request was scored, 2 if some failed, 1 on bad usage or input.";
+
+
+struct Record {
+    int32_t code;
+    int32_t reserved;
+    double svr;
+    double bid_multiplier;
+    double ctr_prob;
+    double wr_win_prob;
+    double wr_final_prob;
+};
+
+
+// Score `ctx.request`, filled in by the caller. On failure `record.code` is not 0:
+// the code of the SVR call, or -1 if scoring threw; the reason is in `error`.
+void score(ModelContext & ctx, Record & record, std::string & error)
+{
+    record = Record{0, 0, 0., 0., 0., 0., 0.};
+    error.clear();
+    try {
+        if (!ctx.svr_model) {
+            ctx.request.svr_calls.clear();
+        }
+        ctx.model_set.run(ctx.request, ctx.result);
+        if (!ctx.result.svr.empty()) {
+            auto const & s = ctx.result.svr[0];
+            record.code = s.code;
+            record.svr = s.svr;
+            record.bid_multiplier = s.bid_multiplier;
+            if (s.code != 0) {
+                error = s.message;
+            }
+        }
+        record.ctr_prob = ctx.result.ctr_prob;
+        record.wr_win_prob = ctx.result.wr_win_prob;
+        record.wr_final_prob = ctx.result.wr_final_prob;
+    } catch (std::exception const & e) {
+        record.code = -1;
+        error = e.what();
+    }
+}
+
+
+// Append `record` and `error` to `out` as one TSV line; `error` loses tabs and newlines.
+void write_tsv(Record const & record, std::string const & error, std::string & out)
+{
+    char buf[160];
+    int n = std::snprintf(buf, sizeof(buf), "%d\t%.10g\t%.10g\t%.10g\t%.10g\t%.10g\t",
+                          record.code, record.svr, record.bid_multiplier,
+                          record.ctr_prob, record.wr_win_prob, record.wr_final_prob);
+    out.append(buf, static_cast<size_t>(std::min(n, static_cast<int>(sizeof(buf)) - 1)));
+    for (char c : error) {
+        out += (c == '\t' || c == '\n' || c == '\r') ? ' ' : c;
+    }
+    out += '\n';
+}
+
+
+void print_stats(size_t n_threads, double load_seconds, size_t n_rows, size_t n_errors, double seconds)
+{
+    std::cerr << "threads:      " << n_threads << std::endl;
+    std::cerr << "load seconds: " << load_seconds << std::endl;
+    std::cerr << "rows:         " << n_rows << std::endl;
+    std::cerr << "errors:       " << n_errors << std::endl;
+    std::cerr << "seconds:      " << seconds << std::endl;
+    std::cerr << "rows/sec:     " << (seconds > 0 ? n_rows / seconds : 0.) << std::endl;
+}
+
+
+int main(int argc, char const * const * argv)
+{
+    std::string svr, ctr, wr, manifest, input, format = "tsv";
+    size_t n_threads = 0;
+    size_t batch_size = 1 << 16;
+    size_t chunk_size = 256;
+    char delimiter = '\t';
+    double progress = 0.;
+    bool warmup = false;
+    WarmupOptions warmup_options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--svr" && has_value) {
+            svr = strip_slash(argv[++i]);
+        } else if (arg == "--ctr" && has_value) {
+            ctr = strip_slash(argv[++i]);
+        } else if (arg == "--wr" && has_value) {
+            wr = strip_slash(argv[++i]);
+        } else if (arg == "--manifest" && has_value) {
+            manifest = argv[++i];
+        } else if (arg == "--threads" && has_value) {
+            n_threads = std::stoul(argv[++i]);
+        } else if (arg == "--batch" && has_value) {
+            batch_size = std::stoul(argv[++i]);
+        } else if (arg == "--chunk" && has_value) {
+            chunk_size = std::stoul(argv[++i]);
+        } else if (arg == "--format" && has_value) {
+            format = argv[++i];
+        } else if (arg == "--delimiter" && has_value && std::string(argv[i + 1]).size() == 1) {
+            delimiter = argv[++i][0];
+        } else if (arg == "--warmup" && has_value) {
+            warmup = true;
+            warmup_options.sweep_calls = std::stoul(argv[++i]);
+        } else if (arg == "--lock") {
+            warmup_options.lock = true;
+        } else if (arg == "--progress" && has_value) {
+            progress = std::stod(argv[++i]);
+        } else if (input.empty() && arg.size() > 0 && (arg[0] != '-' || arg == "-")) {
+            input = arg;
+        } else {
+            std::cout << USAGE << std::endl;
+            return 1;
+        }
+    }
+    bool binary = format == "binary";
+    if ((!binary && format != "tsv") || batch_size == 0 || chunk_size == 0 ||
+            (svr.empty() && ctr.empty() && wr.empty() && manifest.empty())) {
+        std::cout << USAGE << std::endl;
+        return 1;
+    }
+
+    std::vector<ModelLoader::Entry> entries;
+    try {
+        if (!manifest.empty()) {
+            entries = ModelLoader::read_manifest(manifest);
+        }
+    } catch (SaturnError const & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (!svr.empty()) {
+        entries.push_back(ModelLoader::Entry{ModelLoader::Kind::svr, svr});
+    }
+    if (!ctr.empty()) {
+        entries.push_back(ModelLoader::Entry{ModelLoader::Kind::ctr, ctr});
+    }
+    if (!wr.empty()) {
+        entries.push_back(ModelLoader::Entry{ModelLoader::Kind::wr, wr});
+    }
+
+    // A binary replay file is scored in place; text is parsed line by line.
+    std::unique_ptr<ReplayFile> replay_file;
+    std::unique_ptr<RequestParser> parser;
+    std::ifstream file;
+    std::istream * in = &std::cin;
+    try {
+        if (!input.empty() && input != "-" && ReplayFile::is_replay_file(input)) {
+            replay_file.reset(new ReplayFile(input));
+        } else {
+            if (!input.empty() && input != "-") {
+                file.open(input);
+                in = &file;
+            }
+            std::ios::sync_with_stdio(false);
+            std::string header;
+            if (!*in || !std::getline(*in, header)) {
+                std::cerr << "cannot read '" << (input.empty() ? "-" : input) << "'" << std::endl;
+                return 1;
+            }
+            parser.reset(new RequestParser(header, delimiter));
+        }
+    } catch (SaturnError const & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    n_threads = resolve_thread_count(n_threads);
+    auto load_timer = Timer();
+    load_timer.start();
+    std::vector<std::unique_ptr<ModelContext>> contexts;
+    WarmupReport warmup_report;
+    try {
+        contexts.emplace_back(new ModelContext(entries));
+        if (warmup && contexts[0]->svr_model) {
+            // Before binding, so that the other contexts copy the default multipliers.
+            contexts[0]->svr_model->warmup(warmup_options, warmup_report);
+        }
+        for (size_t t = 1; t < n_threads; t++) {
+            contexts.emplace_back(new ModelContext(*contexts[0]));
+        }
+    } catch (std::exception const & e) {
+        std::cerr << "cannot load models: " << e.what() << std::endl;
+        return 1;
+    }
+    if (warmup) {
+        warm_memory(warmup_options, warmup_report);
+    }
+    load_timer.stop();
+    contexts[0]->load_report.write(std::cerr);
+    if (contexts[0]->svr_model) {
+        for (auto const & warning : contexts[0]->svr_model->load_warnings()) {
+            std::cerr << "warning: " << warning << std::endl;
+        }
+    }
+    if (warmup) {
+        warmup_report.write(std::cerr);
+    }
+
+    if (!binary) {
+        std::cout << "code\tsvr\tbid_multiplier\tctr_prob\twr_win_prob\twr_final_prob\terror\n";
+    }
+
+    std::vector<std::string> lines(replay_file ? 0 : batch_size);
+    std::vector<Record> records(batch_size);
+    std::vector<std::string> errors(batch_size);
+    std::string out;
+    size_t n_rows = 0;
+    size_t n_errors = 0;
+    size_t n_reported = 0;
+    double last_progress = 0.;
+    auto timer = Timer();
+    timer.start();
+    while (true) {
+        size_t n = 0;
+        if (replay_file) {
+            n = std::min(batch_size, replay_file->n_rows() - n_rows);
+        } else {
+            while (n < batch_size && std::getline(*in, lines[n])) {
+                if (!lines[n].empty()) {
+                    n++;
+                }
+            }
+        }
+        if (n == 0) {
+            break;
+        }
+
+        parallel_chunks(n, chunk_size, n_threads, [&](size_t worker, size_t begin, size_t end) {
+            auto & ctx = *contexts[worker];
+            for (size_t i = begin; i < end; i++) {
+                if (replay_file) {
+                    replay_file->fill(n_rows + i, ctx.request);
+                } else {
+                    try {
+                        parser->parse(lines[i], ctx.request);
+                    } catch (std::exception const & e) {
+                        records[i] = Record{-1, 0, 0., 0., 0., 0., 0.};
+                        errors[i] = e.what();
+                        continue;
+                    }
+                }
+                score(ctx, records[i], errors[i]);
+            }
+        });
+
+        out.clear();
+        for (size_t i = 0; i < n; i++) {
+            if (records[i].code != 0) {
+                n_errors++;
+                if (binary && n_reported < 10) {
+                    std::cerr << "request " << n_rows + i << ": " << errors[i] << std::endl;
+                    if (++n_reported == 10) {
+                        std::cerr << "(further errors not shown)" << std::endl;
+                    }
+                }
+            }
+            if (!binary) {
+                write_tsv(records[i], errors[i], out);
+            }
+        }
+        if (binary) {
+            std::cout.write(reinterpret_cast<char const *>(records.data()),
+                            static_cast<std::streamsize>(n * sizeof(Record)));
+        } else {
+            std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+        }
+        n_rows += n;
+
+        if (progress > 0.) {
+            if (timer.seconds() - last_progress >= progress) {  // a running timer reads the time so far
+                last_progress = timer.seconds();
+                std::cerr << "progress: " << n_rows << " rows, " << n_errors << " errors, "
+                          << n_rows / last_progress << " rows/sec" << std::endl;
+            }
+        }
+    }
+    std::cout.flush();
+    timer.stop();
+
+    print_stats(n_threads, load_timer.seconds(), n_rows, n_errors, timer.seconds());
+    if (!std::cout) {
+        std::cerr << "error writing results" << std::endl;
+        return 1;
+    }
+    return n_errors > 0 ? 2 : 0;
+}
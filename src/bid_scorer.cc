@@ -0,0 +1,137 @@
+#include "saturn/common.h"
+#include "saturn/bid_scorer.h"
+
+#include <algorithm>
+
+namespace saturn
+{
+
+namespace
+{
+
+// Min-heap on expected value: the k-th best is at the front.
+bool better(BidScorer::Score const & a, BidScorer::Score const & b)
+{
+    return a.expected_value > b.expected_value;
+}
+
+}  // namespace
+
+
+BidScorer::BidScorer(SvrModel * svr_model, ctrModel * ctr_model, WrModel * wr_model)
+    : _svr_model(svr_model), _ctr_model(ctr_model), _wr_model(wr_model)
+{
+    for (auto f : {
+                svr_model ? &svr_model->get_features() : nullptr,
+                ctr_model ? &ctr_model->get_features() : nullptr,
+                wr_model ? &wr_model->get_features() : nullptr
+            }) {
+        if (f) {
+            if (_feature_engine && _feature_engine != f) {
+                throw SaturnError("models of a `BidScorer` must share one `FeatureEngine`");
+            }
+            _feature_engine = f;
+        }
+    }
+}
+
+
+void BidScorer::score(std::vector<Candidate> const & candidates, size_t k, std::vector<Score> & top,
+                      Deadline const & deadline)
+{
+    top.clear();
+    _n_pruned = 0;
+    if (k == 0) {
+        return;
+    }
+    if (_svr_model) {
+        _svr_model->refresh_config();  // for `max_multiplier` below
+    }
+
+    // Whether a candidate whose expected value is at most `bound` could enter the top k.
+    auto admissible = [&](double bound) {
+        if (bound <= 0.) {
+            return false;
+        }
+        return top.size() < k || bound > top.front().expected_value;
+    };
+
+    Score s;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        auto const & c = candidates[i];
+        auto cap = [&](double b) {
+            return (c.max_bid >= 0. && b > c.max_bid) ? c.max_bid : b;
+        };
+
+        double bound = cap(_svr_model ? c.bid * _svr_model->max_multiplier(c.adgroup_id) : c.bid);
+        if (!admissible(bound)) {
+            _n_pruned++;
+            continue;
+        }
+
+        if (_feature_engine) {
+            for (auto const & f : c.string_fields) {
+                _feature_engine->update_field(f.first, f.second);
+            }
+            for (auto const & f : c.int_fields) {
+                _feature_engine->update_field(f.first, f.second);
+            }
+        }
+
+        s.index = i;
+        s.bid_multiplier = 1.;
+        s.ctr = 1.;
+        s.win_prob = 1.;
+        s.degraded = false;
+
+        if (_svr_model) {
+            if (_svr_model->run(c.brand_id, c.adgroup_id, c.user_adgroup_svr, c.pacing, deadline) != 0) {
+                _n_pruned++;
+                continue;
+            }
+            s.bid_multiplier = _svr_model->bid_multiplier();
+            s.degraded = _svr_model->degraded();
+        }
+        s.capped_bid = cap(c.bid * s.bid_multiplier);
+        if (!admissible(s.capped_bid)) {
+            _n_pruned++;
+            continue;
+        }
+
+        if (_ctr_model) {
+            s.ctr = _ctr_model->get_prob(deadline);
+            s.degraded = s.degraded || _ctr_model->degraded();
+            if (!admissible(s.capped_bid * s.ctr)) {
+                _n_pruned++;
+                continue;
+            }
+        }
+
+        if (_wr_model) {
+            s.win_prob = _wr_model->get_prob(deadline);
+            s.degraded = s.degraded || _wr_model->degraded();
+        }
+        s.expected_value = s.capped_bid * s.ctr * s.win_prob;
+        if (!admissible(s.expected_value)) {
+            continue;
+        }
+
+        if (top.size() == k) {
+            std::pop_heap(top.begin(), top.end(), better);
+            top.back() = s;
+        } else {
+            top.push_back(s);
+        }
+        std::push_heap(top.begin(), top.end(), better);
+    }
+
+    std::sort_heap(top.begin(), top.end(), better);
+}
+
+
+size_t BidScorer::n_pruned() const
+{
+    return _n_pruned;
+}
+
+}  // namespace
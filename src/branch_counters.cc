@@ -0,0 +1,215 @@
+#include "saturn/common.h"
+#include "saturn/branch_counters.h"
+#include "saturn/memory.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+
+namespace saturn
+{
+
+uint64_t BranchCounts::total() const
+{
+    uint64_t n = 0;
+    for (auto c : counts) {
+        n += c;
+    }
+    return n;
+}
+
+
+void BranchCounts::merge(BranchCounts const & other)
+{
+    for (size_t i = 0; i < n_slots; i++) {
+        counts[i] += other.counts[i];
+    }
+}
+
+
+char const * BranchCounts::slot_name(Slot slot)
+{
+    switch (slot) {
+        case no_model: return "no_model";
+        case no_adgroup: return "no_adgroup";
+        case default_multiplier: return "default_multiplier";
+        case cutoff: return "cutoff";
+        case curve: return "curve";
+        case pacing_curve: return "pacing_curve";
+        case fallback: return "fallback";
+        case error: return "error";
+        case n_slots: break;
+    }
+    return "unknown";
+}
+
+
+bool branch_counters_enabled()
+{
+#ifdef SATURN_BRANCH_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+BranchCounters::Shard::Shard(size_t n_lines)
+    : _blocks(new std::atomic<Block *>[(n_lines + lines_per_block - 1) / lines_per_block]),
+      _n_lines(n_lines)
+{
+    static_assert(sizeof(Line) == 64, "one line of counters per cache line");
+    for (size_t i = 0; i * lines_per_block < n_lines; i++) {
+        _blocks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+
+BranchCounters::Shard::~Shard()
+{
+    for (size_t i = 0; i * lines_per_block < _n_lines; i++) {
+        delete _blocks[i].load(std::memory_order_relaxed);
+    }
+}
+
+
+BranchCounters::Shard::Block * BranchCounters::Shard::_add_block(size_t i)
+{
+    auto block = new Block();
+    for (auto & line : block->lines) {
+        for (auto & c : line.counts) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+    // Release: a reader that sees the block sees it zeroed.
+    _blocks[i].store(block, std::memory_order_release);
+    return block;
+}
+
+
+void BranchCounters::Shard::add_to(std::map<size_t, BranchCounts> & out) const
+{
+    for (size_t i = 0; i * lines_per_block < _n_lines; i++) {
+        auto block = _blocks[i].load(std::memory_order_acquire);
+        if (block == nullptr) {
+            continue;
+        }
+        for (size_t j = 0; j < lines_per_block && i * lines_per_block + j < _n_lines; j++) {
+            BranchCounts counts;
+            for (size_t k = 0; k < BranchCounts::n_slots; k++) {
+                counts.counts[k] = block->lines[j].counts[k].load(std::memory_order_relaxed);
+            }
+            if (counts.total() > 0) {
+                out[i * lines_per_block + j].merge(counts);
+            }
+        }
+    }
+}
+
+
+size_t BranchCounters::Shard::memory_bytes() const
+{
+    size_t n_blocks = (_n_lines + lines_per_block - 1) / lines_per_block;
+    size_t bytes = sizeof(Shard) + n_blocks * sizeof(std::atomic<Block *>);
+    for (size_t i = 0; i < n_blocks; i++) {
+        if (_blocks[i].load(std::memory_order_acquire) != nullptr) {
+            bytes += sizeof(Block);
+        }
+    }
+    return bytes;
+}
+
+
+BranchCounters::BranchCounters(std::set<std::string> const & adgroups)
+    : _adgroups(adgroups.begin(), adgroups.end())
+{
+}
+
+
+size_t BranchCounters::index(std::string const & adgroup_id) const
+{
+    std::string_view id(adgroup_id);
+    if (!id.empty() && id[0] == '/') {
+        id.remove_prefix(1);
+    }
+    auto it = std::lower_bound(_adgroups.begin(), _adgroups.end(), id,
+                               [](std::string const & a, std::string_view b) { return std::string_view(a) < b; });
+    if (it == _adgroups.end() || std::string_view(*it) != id) {
+        return _adgroups.size();
+    }
+    return static_cast<size_t>(it - _adgroups.begin());
+}
+
+
+size_t BranchCounters::n_adgroups() const
+{
+    return _adgroups.size();
+}
+
+
+std::shared_ptr<BranchCounters::Shard> BranchCounters::add_shard()
+{
+    auto shard = std::make_shared<Shard>(_adgroups.size() + 1);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _shards.push_back(shard);
+    return shard;
+}
+
+
+void BranchCounters::remove_shard(std::shared_ptr<Shard> const & shard)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = std::find(_shards.begin(), _shards.end(), shard);
+    if (it != _shards.end()) {
+        shard->add_to(_retired);
+        _shards.erase(it);
+    }
+}
+
+
+std::map<std::string, BranchCounts> BranchCounters::snapshot() const
+{
+    std::map<size_t, BranchCounts> sums;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        sums = _retired;
+        for (auto const & shard : _shards) {
+            shard->add_to(sums);
+        }
+    }
+    std::map<std::string, BranchCounts> out;
+    for (auto const & entry : sums) {
+        out.emplace(entry.first < _adgroups.size() ? _adgroups[entry.first] : std::string(), entry.second);
+    }
+    return out;
+}
+
+
+size_t BranchCounters::memory_bytes() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t bytes = heap_bytes(_adgroups) + heap_bytes(_retired);
+    for (auto const & shard : _shards) {
+        bytes += shard->memory_bytes();
+    }
+    return bytes;
+}
+
+
+void BranchCounters::write_tsv(std::ostream & out) const
+{
+    out << "adgroup_id";
+    for (size_t k = 0; k < BranchCounts::n_slots; k++) {
+        out << '\t' << BranchCounts::slot_name(static_cast<BranchCounts::Slot>(k));
+    }
+    out << '\n';
+    for (auto const & entry : this->snapshot()) {
+        out << entry.first;
+        for (auto c : entry.second.counts) {
+            out << '\t' << c;
+        }
+        out << '\n';
+    }
+}
+
+}  // namespace
@@ -6,9 +6,11 @@
 #include "mars/numeric.h"
 #include "mars/utils.h"
 
+#include <algorithm>
 #include <any>
 #include <cassert>
 #include <fstream>
+#include <memory>
 #include <tuple>
 
 #include <iostream>
@@ -31,21 +33,17 @@ ctrModel::ctrModel(FeatureEngine & feature_engine, std::string path)
     _path = path;
     _model_id = path;  // TODO: improve this later, adding more info
 
-    auto f = static_cast<mars::FeatureEngine *>(_feature_engine._mars_feature_engine);
-    mars::JsonReader jreader((_path + "/model_config.json").c_str());
-    jreader.seek("/", "features");
-    _composer_id = f->add_composer(jreader);
+    _composer_id = _feature_engine._add_composer(_path + "/model_config.json");
 
-    mars::AvroReader areader((_path + "/ctr_model_object.data").c_str());
-    auto const class_name = areader.get_scalar<std::string>("class_name");
-    if ("ChainModel" != class_name) {
-        throw SaturnError(mars::make_string(
-        "expecting a `ChainModel` for `ctrModel`; got a `", class_name, "`"));
+    mars::JsonReader jreader((_path + "/model_config.json").c_str());
+    if (jreader.has_member("/", "prior_ctr")) {
+        _prior_ctr = jreader.get_scalar<double>("/", "prior_ctr");
     }
 
-
-    auto model = mars::ChainModel::from_avro(areader);
-    _mars_model = static_cast<void *>(model.release());
+    this->_load_mars_model();
+#ifdef SATURN_STATS
+    _stats.reset(new StageRecorder());
+#endif
 
     // Read in `adgroup_quantile_cutoff.txt` file.
     // If file does not exist, no adgroup is using the 'placed' strategy.
@@ -53,15 +51,53 @@ ctrModel::ctrModel(FeatureEngine & feature_engine, std::string path)
 }
 
 
+ctrModel::ctrModel(ctrModel const & prototype, FeatureEngine & context)
+    : _feature_engine(context),
+      _mars_model(prototype._mars_model),
+      _mars_model_bytes(prototype._mars_model_bytes),
+      _prior_ctr(prototype._prior_ctr),
+      _eval_cost(prototype._eval_cost),
+      _path(prototype._path),
+      _model_id(prototype._model_id),
+      _composer_id(prototype._composer_id)
+{
+    if (!context.same_schema(prototype._feature_engine)) {
+        throw SaturnError("`FeatureEngine` of the model to bind has a different schema");
+    }
+#ifdef SATURN_STATS
+    _stats.reset(new StageRecorder());
+#endif
+}
+
+
 ctrModel::~ctrModel()
 {
-    delete static_cast<mars::ChainModel *>(_mars_model);
 }
 
 
-double ctrModel::get_prob(std::vector<std::string> input)
+void ctrModel::_load_mars_model()
 {
+    mars::AvroReader areader((_path + "/ctr_model_object.data").c_str());
+    auto const class_name = areader.get_scalar<std::string>("class_name");
+    if ("ChainModel" != class_name) {
+        throw SaturnError(mars::make_string(
+        "expecting a `ChainModel` for `ctrModel`; got a `", class_name, "`"));
+    }
+
+    auto heap0 = heap_in_use();
+    auto model = mars::ChainModel::from_avro(areader);
+    auto heap1 = heap_in_use();
+    _mars_model_bytes = heap1 - std::min(heap0, heap1);
+    _mars_model = std::shared_ptr<void>(model.release(), [](void * m) {
+        delete static_cast<mars::ChainModel *>(m);
+    });
+}
+
 
+double ctrModel::get_prob(std::vector<std::string> const & input)
+{
+
+    SATURN_STATS_TICK(t0);
     _feature_engine.update_field(FeatureEngine::StringField::ctr_campaign_id, input[0]);
     _feature_engine.update_field(FeatureEngine::StringField::ctr_creative_id, input[1]);
     _feature_engine.update_field(FeatureEngine::StringField::ctr_creative_type, input[2]);
@@ -79,26 +115,47 @@ double ctrModel::get_prob(std::vector<std::string> input)
     _feature_engine.update_field(FeatureEngine::StringField::ctr_hour, input[14]);
     _feature_engine.update_field(FeatureEngine::StringField::ctr_age, input[15]);
     _feature_engine.update_field(FeatureEngine::IntField::ctr_sl_adjusted_confidence, std::stoi(input[16]));
+    SATURN_STATS_TICK(t1);
+    SATURN_STATS_RECORD(_stats, ingest, t0, t1);
 
-    auto f = static_cast<mars::FeatureEngine *>(_feature_engine._mars_feature_engine);
-    auto x = f->render(_composer_id);
-    auto m = static_cast<mars::ChainModel *>(_mars_model);
-
-    auto z = m->predict_one(x);
-    
-    _prob = std::any_cast<double>(std::get<0>(z));
+    this->get_prob(Deadline());
     return 0;
 }
 
 double ctrModel::get_prob()
 {
-    auto f = static_cast<mars::FeatureEngine *>(_feature_engine._mars_feature_engine);
-    auto x = f->render(_composer_id);
-    auto m = static_cast<mars::ChainModel *>(_mars_model);
+    return this->get_prob(Deadline());
+}
+
+double ctrModel::get_prob(Deadline const & deadline)
+{
+    _degraded = false;
+    if (_eval_cost.skip(deadline)) {
+        _degraded = true;
+        _n_degraded++;
+        _prob = _prior_ctr;
+        return _prob;
+    }
+
+    auto timer = Timer();
+    timer.start();
+
+    SATURN_STATS_TICK(t0);
+    auto const & x = _feature_engine._render(_composer_id);
+    SATURN_STATS_TICK(t1);
+    auto m = static_cast<mars::ChainModel *>(_mars_model.get());
 
     auto z = m->predict_one(x);
+    SATURN_STATS_TICK(t2);
     
     _prob = std::any_cast<double>(std::get<0>(z));
+    SATURN_STATS_TICK(t3);
+    SATURN_STATS_RECORD(_stats, render, t0, t1);
+    SATURN_STATS_RECORD(_stats, evaluate, t1, t2);
+    SATURN_STATS_RECORD(_stats, postprocess, t2, t3);
+
+    timer.stop();
+    _eval_cost.update(timer.microseconds());
     return _prob;
 }
 
@@ -112,4 +169,26 @@ double ctrModel::prob() const
 {
     return _prob;
 }
+
+bool ctrModel::degraded() const
+{
+    return _degraded;
+}
+
+size_t ctrModel::n_degraded() const
+{
+    return _n_degraded;
+}
+
+MemoryUsage ctrModel::memory_usage() const
+{
+    MemoryUsage usage;
+    usage.add_heap_growth("model", 1, _mars_model_bytes);
+    return usage;
+}
+
+StageStats ctrModel::stats() const
+{
+    return _stats ? _stats->snapshot() : StageStats();
+}
 }  // namespace
\ No newline at end of file
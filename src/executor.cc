@@ -0,0 +1,226 @@
+#include "saturn/common.h"
+#include "saturn/executor.h"
+
+namespace saturn
+{
+
+namespace
+{
+
+Executor::Callback make_promise_callback(std::future<ModelSet::Result> & future)
+{
+    auto promise = std::make_shared<std::promise<ModelSet::Result>>();
+    future = promise->get_future();
+    return [promise](ModelSet::Result const & result, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(result);
+        }
+    };
+}
+
+}  // namespace
+
+
+Executor::Executor(ModelPaths const & paths, size_t n_workers, size_t queue_capacity)
+    : _queue(queue_capacity), _n_rejected(0), _n_completed(0), _n_callback_errors(0),
+      _load_shedder(nullptr)
+{
+    if (n_workers == 0) {
+        throw SaturnError("`Executor` needs at least one worker");
+    }
+    // The other workers bind the models of the first, sharing their configuration.
+    _workers.emplace_back(new ModelContext(paths.svr, paths.ctr, paths.wr));
+    for (size_t i = 1; i < n_workers; i++) {
+        _workers.emplace_back(new ModelContext(*_workers[0]));
+    }
+    for (auto & w : _workers) {
+        _threads.emplace_back(&Executor::_work, this, std::ref(*w));
+    }
+}
+
+
+Executor::~Executor()
+{
+    this->shutdown();
+}
+
+
+void Executor::_work(ModelContext & worker)
+{
+    Job job;
+    ModelSet::Result result;
+    while (_queue.pop(job)) {
+        auto shedder = _load_shedder.load(std::memory_order_acquire);
+        if (shedder) {
+            shedder->record_queue_depth(_queue.size());
+        }
+        worker.model_set.set_load_shedder(shedder);
+
+        // The result is reused across jobs: nothing of the previous one may reach this
+        // job's callback, whatever the request asks for and wherever `run` throws.
+        result.clear();
+        std::exception_ptr error;
+        try {
+            worker.model_set.run(job.request, result);
+        } catch (...) {
+            error = std::current_exception();
+            result.clear();
+        }
+        if (job.callback) {
+            // An exception escaping the thread would terminate the process.
+            try {
+                job.callback(result, error);
+            } catch (...) {
+                _n_callback_errors.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        _n_completed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+bool Executor::try_submit(ModelSet::Request request, Callback callback)
+{
+    Job job{std::move(request), std::move(callback)};
+    if (!_queue.try_push(std::move(job))) {
+        _n_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+
+bool Executor::try_submit(ModelSet::Request request, std::future<ModelSet::Result> & future)
+{
+    std::future<ModelSet::Result> f;
+    if (!this->try_submit(std::move(request), make_promise_callback(f))) {
+        return false;
+    }
+    future = std::move(f);
+    return true;
+}
+
+
+void Executor::submit(ModelSet::Request request, Callback callback)
+{
+    Job job{std::move(request), std::move(callback)};
+    if (!_queue.push(std::move(job))) {
+        throw SaturnError("`Executor` has been shut down");
+    }
+}
+
+
+std::future<ModelSet::Result> Executor::submit(ModelSet::Request request)
+{
+    std::future<ModelSet::Result> future;
+    this->submit(std::move(request), make_promise_callback(future));
+    return future;
+}
+
+
+void Executor::set_load_shedder(LoadShedder * shedder)
+{
+    _load_shedder.store(shedder, std::memory_order_release);
+}
+
+
+void Executor::shutdown()
+{
+    _queue.close();
+    for (auto & t : _threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+}
+
+
+size_t Executor::n_workers() const
+{
+    return _workers.size();
+}
+
+size_t Executor::queue_depth() const
+{
+    return _queue.size();
+}
+
+size_t Executor::queue_capacity() const
+{
+    return _queue.capacity();
+}
+
+size_t Executor::n_rejected() const
+{
+    return _n_rejected.load(std::memory_order_relaxed);
+}
+
+size_t Executor::n_completed() const
+{
+    return _n_completed.load(std::memory_order_relaxed);
+}
+
+size_t Executor::n_callback_errors() const
+{
+    return _n_callback_errors.load(std::memory_order_relaxed);
+}
+
+Executor::Stats Executor::stats() const
+{
+    Stats stats;
+    for (auto const & w : _workers) {
+        if (w->svr_model) {
+            stats.svr.merge(w->svr_model->stats());
+        }
+        if (w->ctr_model) {
+            stats.ctr.merge(w->ctr_model->stats());
+        }
+        if (w->wr_model) {
+            stats.wr.merge(w->wr_model->stats());
+        }
+    }
+    return stats;
+}
+
+
+WarmupReport Executor::warmup(WarmupOptions const & options)
+{
+    // The workers are idle until the first request; the queue orders their
+    // later accesses after these.
+    WarmupReport report;
+    for (auto & w : _workers) {
+        if (w->svr_model) {
+            w->svr_model->warmup(options, report);
+        }
+    }
+    warm_memory(options, report);  // last, so that it covers the caches filled above
+    return report;
+}
+
+
+size_t Executor::apply_svr_config_delta(std::string const & file)
+{
+    // The workers' models are bound to one another: one update reaches all of them.
+    for (auto & w : _workers) {
+        if (w->svr_model) {
+            return w->svr_model->apply_config_delta(file);
+        }
+    }
+    return 0;
+}
+
+
+std::map<std::string, BranchCounts> Executor::svr_branch_counts() const
+{
+    // The workers' models are bound to one another and share their counters.
+    for (auto const & w : _workers) {
+        if (w->svr_model) {
+            return w->svr_model->branch_counters().snapshot();
+        }
+    }
+    return {};
+}
+
+}  // namespace
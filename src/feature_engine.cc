@@ -1,7 +1,11 @@
 #include "saturn/feature_engine.h"
 #include "mars/mars.h"
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <unordered_map>
 
 namespace saturn
 {
@@ -77,6 +81,44 @@ const std::vector<std::string> FeatureEngine::FLOAT_FIELDS({
 });
 
 
+struct FeatureEngine::Schema {
+    // Columns of the mars engines, i.e. all fields.
+    std::vector<std::string> columns;
+
+    // The model config files whose composers were registered, in order, and the ID
+    // mars gave each. A context created by `clone_context` registers them again
+    // on a mars engine of its own, and must get the same IDs.
+    std::vector<std::pair<std::string, std::string>> registrations;
+
+    struct Composer {
+        // Field indices (across the 3 types) this composer reads.
+        std::vector<size_t> columns;
+        // Position of the composer's rendering in `_renderings` of each context.
+        size_t slot = 0;
+    };
+    std::map<std::string, Composer> composers;
+
+    struct Dictionary {
+        // Code to value, and value to code.
+        std::vector<std::string> values;
+        std::unordered_map<std::string, int> codes;
+        // True if the field is read by nothing but `OneHot` features.
+        // Then all values outside the vocabulary render identically,
+        // and a change between two of them needs no ingestion.
+        bool onehot_only = true;
+    };
+    // Indexed by string field; empty `values` means no dictionary.
+    std::vector<Dictionary> dictionaries;
+
+    // Heap growth of a mars engine as the composers were registered.
+    size_t mars_engine_bytes = 0;
+
+    Schema(std::vector<std::string> const & columns_)
+        : columns(columns_), dictionaries(STRING_FIELDS.size())
+    {}
+};
+
+
 FeatureEngine::FeatureEngine()
 {
     std::vector<std::string> columns;
@@ -88,7 +130,40 @@ FeatureEngine::FeatureEngine()
         throw SaturnError("field names for `FeatureEngine` are not all unique");
     }
 
+    _schema = std::make_shared<Schema>(columns);
     _mars_feature_engine = static_cast<void *>(new mars::FeatureEngine(columns));
+    this->_init_context();
+}
+
+
+FeatureEngine::FeatureEngine(std::shared_ptr<Schema> schema)
+    : _schema(std::move(schema))
+{
+    std::unique_ptr<mars::FeatureEngine> f(new mars::FeatureEngine(_schema->columns));
+    for (auto const & r : _schema->registrations) {
+        mars::JsonReader jreader(r.first.c_str());
+        jreader.seek("/", "features");
+        if (f->add_composer(jreader) != r.second) {
+            throw SaturnError(mars::make_string("composer of '", r.first, "' got a different ID in the cloned context"));
+        }
+    }
+    _mars_feature_engine = static_cast<void *>(f.release());
+    this->_init_context();
+}
+
+
+FeatureEngine::FeatureEngine(FeatureEngine && other)
+    : _schema(std::move(other._schema)),
+      _mars_feature_engine(other._mars_feature_engine),
+      _clock(other._clock),
+      _generation(std::move(other._generation)),
+      _string_values(std::move(other._string_values)),
+      _int_values(std::move(other._int_values)),
+      _float_values(std::move(other._float_values)),
+      _renderings(std::move(other._renderings)),
+      _string_codes(std::move(other._string_codes))
+{
+    other._mars_feature_engine = nullptr;
 }
 
 
@@ -97,10 +172,85 @@ FeatureEngine::~FeatureEngine()
     delete static_cast<mars::FeatureEngine *>(_mars_feature_engine);
 }
 
-void FeatureEngine::update_field(StringField idx, std::string const & value)
+
+void FeatureEngine::_init_context()
+{
+    auto n_columns = STRING_FIELDS.size() + INT_FIELDS.size() + FLOAT_FIELDS.size();
+    _clock = 0;
+    _generation.assign(n_columns, 0);
+    _string_values.assign(STRING_FIELDS.size(), std::string());
+    _int_values.assign(INT_FIELDS.size(), 0);
+    _float_values.assign(FLOAT_FIELDS.size(), 0.0);
+    _renderings.assign(_schema->composers.size(), Rendering());
+    _string_codes.assign(STRING_FIELDS.size(), -1);
+}
+
+
+MemoryUsage FeatureEngine::memory_usage() const
+{
+    MemoryUsage usage;
+
+    size_t composer_bytes = heap_bytes(_schema->registrations) + heap_bytes(_schema->composers);
+    for (auto const & c : _schema->composers) {
+        composer_bytes += heap_bytes(c.second.columns);
+    }
+    usage.add("composers", _schema->composers.size(), composer_bytes);
+
+    size_t n_values = 0;
+    size_t dictionary_bytes = _schema->dictionaries.capacity() * sizeof(Schema::Dictionary);
+    for (auto const & d : _schema->dictionaries) {
+        n_values += d.values.size();
+        dictionary_bytes += heap_bytes(d.values) + heap_bytes(d.codes);
+    }
+    usage.add("vocabularies", n_values, dictionary_bytes);
+
+    // Each context registers the composers on a mars engine of its own.
+    usage.add_heap_growth("mars_engine", _schema->registrations.size(), _schema->mars_engine_bytes);
+
+    size_t context_bytes = heap_bytes(_generation) + heap_bytes(_string_values) + heap_bytes(_int_values)
+        + heap_bytes(_float_values) + heap_bytes(_string_codes) + _renderings.capacity() * sizeof(Rendering);
+    for (auto const & r : _renderings) {
+        context_bytes += heap_bytes(r.x);
+    }
+    usage.add("context", _renderings.size(), context_bytes);
+    return usage;
+}
+
+
+FeatureEngine FeatureEngine::clone_context() const
+{
+    return FeatureEngine(_schema);
+}
+
+
+bool FeatureEngine::same_schema(FeatureEngine const & other) const
+{
+    return _schema == other._schema;
+}
+
+
+void FeatureEngine::_ingest(size_t column)
 {
     auto f = static_cast<mars::FeatureEngine *>(_mars_feature_engine);
-    f->ingest_column(_string_field_idx_base + static_cast<size_t>(idx), mars::Column(value));
+    if (column < _int_field_idx_base) {
+        f->ingest_column(column, mars::Column(_string_values[column - _string_field_idx_base]));
+    } else if (column < _float_field_idx_base) {
+        f->ingest_column(column, mars::Column(_int_values[column - _int_field_idx_base]));
+    } else {
+        f->ingest_column(column, mars::Column(_float_values[column - _float_field_idx_base]));
+    }
+    _generation[column] = ++_clock;
+}
+
+void FeatureEngine::update_field(StringField idx, std::string const & value)
+{
+    auto i = static_cast<size_t>(idx);
+    auto column = _string_field_idx_base + i;
+    if (_generation[column] != 0 && _string_values[i] == value) {
+        return;
+    }
+    _string_values[i] = value;
+    this->_string_changed(i);
 }
 
 void FeatureEngine::update_field(StringField idx, std::string const * value)
@@ -110,34 +260,259 @@ void FeatureEngine::update_field(StringField idx, std::string const * value)
 
 void FeatureEngine::update_field(StringField idx, char const * c_str)
 {
-    auto f = static_cast<mars::FeatureEngine *>(_mars_feature_engine);
-    f->ingest_column(_string_field_idx_base + static_cast<size_t>(idx), mars::Column(c_str));
+    auto i = static_cast<size_t>(idx);
+    auto column = _string_field_idx_base + i;
+    if (_generation[column] != 0 && _string_values[i] == c_str) {
+        return;
+    }
+    _string_values[i] = c_str;
+    this->_string_changed(i);
+}
+
+void FeatureEngine::_string_changed(size_t idx)
+{
+    auto column = _string_field_idx_base + idx;
+    auto const & dict = _schema->dictionaries[idx];
+    if (dict.values.empty()) {
+        this->_ingest(column);
+        return;
+    }
+
+    auto code = this->_encode(idx);
+    bool equivalent = dict.onehot_only && _generation[column] != 0 && code == _string_codes[idx];
+    _string_codes[idx] = code;
+    if (!equivalent) {
+        this->_ingest(column);
+    }
 }
 
 void FeatureEngine::update_field(IntField idx, int value)
 {
-    auto f = static_cast<mars::FeatureEngine *>(_mars_feature_engine);
-    f->ingest_column(_int_field_idx_base + static_cast<size_t>(idx), mars::Column(value));
+    auto i = static_cast<size_t>(idx);
+    auto column = _int_field_idx_base + i;
+    if (_generation[column] != 0 && _int_values[i] == value) {
+        return;
+    }
+    _int_values[i] = value;
+    this->_ingest(column);
 }
 
 void FeatureEngine::update_field(FloatField idx, double value)
 {
-    auto f = static_cast<mars::FeatureEngine *>(_mars_feature_engine);
-    f->ingest_column(_float_field_idx_base + static_cast<size_t>(idx), mars::Column(value));
+    auto i = static_cast<size_t>(idx);
+    auto column = _float_field_idx_base + i;
+    if (_generation[column] != 0 && _float_values[i] == value) {
+        return;
+    }
+    _float_values[i] = value;
+    this->_ingest(column);
 }
 
 void FeatureEngine::reset_fields()
 {
-    auto f = static_cast<mars::FeatureEngine *>(_mars_feature_engine);
     for (size_t idx = 0; idx < STRING_FIELDS.size(); idx++) {
-        f->ingest_column(_string_field_idx_base + idx, mars::Column(""));
+        this->update_field(static_cast<StringField>(idx), "");
     }
     for (size_t idx = 0; idx < INT_FIELDS.size(); idx++) {
-        f->ingest_column(_int_field_idx_base + idx, mars::Column(0));
+        this->update_field(static_cast<IntField>(idx), 0);
     }
     for (size_t idx = 0; idx < FLOAT_FIELDS.size(); idx++) {
-        f->ingest_column(_float_field_idx_base + idx, mars::Column(0.0));
+        this->update_field(static_cast<FloatField>(idx), 0.0);
+    }
+}
+
+
+int FeatureEngine::field_code(StringField idx) const
+{
+    return _string_codes[static_cast<size_t>(idx)];
+}
+
+size_t FeatureEngine::vocabulary_size(StringField idx) const
+{
+    return _schema->dictionaries[static_cast<size_t>(idx)].values.size();
+}
+
+
+int FeatureEngine::_encode(size_t idx) const
+{
+    auto const & dict = _schema->dictionaries[idx];
+    auto it = dict.codes.find(_string_values[idx]);
+    if (it != dict.codes.end()) {
+        return it->second;
+    }
+    return static_cast<int>(dict.values.size());
+}
+
+
+void FeatureEngine::_build_dictionary(size_t idx, std::vector<std::string> const & values)
+{
+    auto & dict = _schema->dictionaries[idx];
+    for (auto const & v : values) {
+        if (dict.codes.emplace(v, static_cast<int>(dict.values.size())).second) {
+            dict.values.push_back(v);
+        }
+    }
+
+    // The vocabulary changed, hence so may the code of the current value.
+    // Ingestion may have been skipped for the value as equivalent to the previous one
+    // under the old vocabulary, so bring the mars engine up to date.
+    _string_codes[idx] = this->_encode(idx);
+    if (_generation[_string_field_idx_base + idx] != 0) {
+        this->_ingest(_string_field_idx_base + idx);
+    }
+}
+
+
+size_t FeatureEngine::_column_index(std::string const & name) const
+{
+    auto it = std::find(STRING_FIELDS.cbegin(), STRING_FIELDS.cend(), name);
+    if (it != STRING_FIELDS.cend()) {
+        return _string_field_idx_base + static_cast<size_t>(std::distance(STRING_FIELDS.cbegin(), it));
+    }
+    it = std::find(INT_FIELDS.cbegin(), INT_FIELDS.cend(), name);
+    if (it != INT_FIELDS.cend()) {
+        return _int_field_idx_base + static_cast<size_t>(std::distance(INT_FIELDS.cbegin(), it));
+    }
+    it = std::find(FLOAT_FIELDS.cbegin(), FLOAT_FIELDS.cend(), name);
+    if (it != FLOAT_FIELDS.cend()) {
+        return _float_field_idx_base + static_cast<size_t>(std::distance(FLOAT_FIELDS.cbegin(), it));
+    }
+    throw SaturnError(mars::make_string("unknown field name `", name, "`"));
+}
+
+
+std::string FeatureEngine::_add_composer(std::string const & config_file)
+{
+    // Registration happens only while loading models, hence one mutex for all engines.
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (_schema.use_count() > 1) {
+        // Copy on write: contexts cloned from this engine keep the current schema.
+        _schema = std::make_shared<Schema>(*_schema);
+    }
+
+    mars::JsonReader jreader(config_file.c_str());
+
+    // Collect the fields read by the features. The known feature types name
+    // either one column (`args.column`) or several (`args.columns`);
+    // a feature of any other type may read anything, so the composer then
+    // depends on every field.
+    // The vocabulary of each `OneHot` feature on a string field goes into
+    // the dictionary of that field.
+    std::vector<size_t> columns;
+    std::vector<std::pair<size_t, std::vector<std::string>>> vocabularies;
+    std::vector<size_t> non_onehot;
+    bool all_columns = false;
+    jreader.seek("/", "features");
+    auto n = jreader.get_array_size();
+    for (size_t i = 0; i < n; i++) {
+        jreader.save_cursor();
+        jreader.seek_in_array(i);
+        auto type = jreader.get_scalar<std::string>("type");
+        bool onehot = (type == "OneHot");
+        bool known = onehot || type == "DirectNumber" || type == "HashedColumn"
+                     || type == "HashedColumnCross" || type == "HashedColumnBundle";
+        if (!known || !(jreader.has_member("args", "column") || jreader.has_member("args", "columns"))) {
+            all_columns = true;
+        }
+        if (jreader.has_member("args", "column")) {
+            auto column = this->_column_index(jreader.get_scalar<std::string>("args", "column"));
+            columns.push_back(column);
+            if (!onehot) {
+                non_onehot.push_back(column);
+            } else if (column < _int_field_idx_base) {
+                vocabularies.emplace_back(column - _string_field_idx_base,
+                                          jreader.get_vector<std::string>("args", "values"));
+            }
+        }
+        if (jreader.has_member("args", "columns")) {
+            for (auto const & name : jreader.get_vector<std::string>("args", "columns")) {
+                columns.push_back(this->_column_index(name));
+                non_onehot.push_back(columns.back());
+            }
+        }
+        jreader.restore_cursor();
+    }
+
+    if (all_columns) {
+        // Such a feature may read any string field verbatim, too.
+        columns.clear();
+        for (size_t i = 0; i < _generation.size(); i++) {
+            columns.push_back(i);
+            if (i < _int_field_idx_base) {
+                non_onehot.push_back(i);
+            }
+        }
+    }
+
+    for (auto const & v : vocabularies) {
+        this->_build_dictionary(v.first, v.second);
+    }
+    for (auto column : non_onehot) {
+        if (column < _int_field_idx_base) {
+            auto & dict = _schema->dictionaries[column - _string_field_idx_base];
+            if (dict.onehot_only && _generation[column] != 0) {
+                this->_ingest(column);  // See `_build_dictionary`.
+            }
+            dict.onehot_only = false;
+        }
+    }
+
+    std::sort(columns.begin(), columns.end());
+    columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+
+    jreader.seek("/", "features");
+    auto f = static_cast<mars::FeatureEngine *>(_mars_feature_engine);
+    auto heap0 = heap_in_use();
+    auto composer_id = f->add_composer(jreader);
+    auto heap1 = heap_in_use();
+    if (heap1 > heap0) {
+        _schema->mars_engine_bytes += heap1 - heap0;
+    }
+    // A model loaded again, e.g. after `ModelRegistry` evicted it, registers nothing new,
+    // so that the schema grows with the distinct models loaded, not with the loads.
+    auto registration = std::make_pair(config_file, composer_id);
+    if (std::find(_schema->registrations.begin(), _schema->registrations.end(), registration)
+            == _schema->registrations.end()) {
+        _schema->registrations.push_back(std::move(registration));
+    }
+
+    // The same composer may be registered by several models.
+    auto it = _schema->composers.find(composer_id);
+    if (it == _schema->composers.end()) {
+        it = _schema->composers.emplace(composer_id, Schema::Composer()).first;
+        it->second.slot = _schema->composers.size() - 1;
+        _renderings.resize(_schema->composers.size());
+    }
+    it->second.columns = columns;
+    _renderings[it->second.slot].rendered_at = 0;
+    return composer_id;
+}
+
+
+std::vector<double> const & FeatureEngine::_render(std::string const & composer_id)
+{
+    auto it = _schema->composers.find(composer_id);
+    if (it == _schema->composers.end()) {
+        throw SaturnError(mars::make_string("unknown composer `", composer_id, "`"));
+    }
+    auto const & composer = it->second;
+    auto & rendering = _renderings[composer.slot];
+
+    bool current = rendering.rendered_at != 0;
+    for (auto column : composer.columns) {
+        if (_generation[column] > rendering.rendered_at) {
+            current = false;
+            break;
+        }
+    }
+    if (!current) {
+        auto f = static_cast<mars::FeatureEngine *>(_mars_feature_engine);
+        rendering.x = f->render(composer_id);
+        rendering.rendered_at = ++_clock;
     }
+    return rendering.x;
 }
 
 } // namespace
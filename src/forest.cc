@@ -0,0 +1,289 @@
+#include "saturn/common.h"
+#include "saturn/forest.h"
+#include "mars/mars.h"
+#include "mars/utils.h"
+
+#include <algorithm>
+#include <functional>
+#include <tuple>
+
+namespace saturn
+{
+
+
+CompiledForest::CompiledForest(size_t n_predictors)
+    : _n_predictors(n_predictors)
+{
+}
+
+
+CompiledForest CompiledForest::from_avro(std::string const & path)
+{
+    mars::AvroReader areader(path.c_str());
+    auto const class_name = areader.get_scalar<std::string>("class_name");
+    if ("BinaryRandomForestClassifier" != class_name) {
+        throw SaturnError(mars::make_string(
+                              "expecting a `BinaryRandomForestClassifier` for `CompiledForest`; get a `",
+                              class_name,
+                              "`"));
+    }
+
+    auto forest = CompiledForest(static_cast<size_t>(areader.get_scalar<int>("predictor_count")));
+
+    auto n_trees = areader.get_array_size("trees");
+    if (n_trees == 0) {
+        throw SaturnError(mars::make_string("'", path, "' has no trees"));
+    }
+    areader.save_cursor();
+    areader.seek("trees");
+    for (size_t i = 0; i < n_trees; i++) {
+        areader.save_cursor();
+        areader.seek_in_array(i);
+        forest.add_tree(
+            areader.get_vector<int>("children_left"),
+            areader.get_vector<int>("children_right"),
+            areader.get_vector<int>("feature"),
+            areader.get_vector<double>("threshold"),
+            areader.get_vector<double>("value"));
+        areader.restore_cursor();
+    }
+    areader.restore_cursor();
+
+    forest.compile_bitvector();
+    return forest;
+}
+
+
+void CompiledForest::add_tree(
+    std::vector<int> const & children_left,
+    std::vector<int> const & children_right,
+    std::vector<int> const & feature,
+    std::vector<double> const & threshold,
+    std::vector<double> const & value)
+{
+    auto n = children_left.size();
+    if (n == 0 || children_right.size() != n || feature.size() != n
+            || threshold.size() != n || value.size() != n) {
+        throw SaturnError("tree arrays must be non-empty and of equal length");
+    }
+
+    _has_bitvector = false;
+
+    auto const base = _feature.size();
+    _roots.push_back(static_cast<uint32_t>(base));
+
+    // Breadth-first renumbering; `order[k]` is the original index of new node `base + k`.
+    // Children are enqueued in pairs, hence are adjacent in the new numbering.
+    std::vector<int> order;
+    order.reserve(n);
+    order.push_back(0);
+    for (size_t k = 0; k < order.size(); k++) {
+        auto i = order[k];
+        if (children_left[i] >= 0) {
+            if (children_left[i] >= static_cast<int>(n) || children_right[i] < 0
+                    || children_right[i] >= static_cast<int>(n)) {
+                throw SaturnError(mars::make_string("invalid child index at tree node ", i));
+            }
+            if (feature[i] < 0 || feature[i] >= static_cast<int>(_n_predictors)) {
+                throw SaturnError(mars::make_string(
+                                      "feature index ", feature[i], " out of range at tree node ", i));
+            }
+            order.push_back(children_left[i]);
+            order.push_back(children_right[i]);
+        }
+        if (order.size() > n) {
+            throw SaturnError("tree arrays do not describe a tree");
+        }
+    }
+
+    size_t next_child = base + 1;
+    for (auto i : order) {
+        if (children_left[i] >= 0) {
+            _feature.push_back(feature[i]);
+            _threshold.push_back(threshold[i]);
+            _left.push_back(static_cast<int32_t>(next_child));
+            next_child += 2;
+        } else {
+            _feature.push_back(-1);
+            _threshold.push_back(value[i]);
+            _left.push_back(-1);
+        }
+    }
+}
+
+
+bool CompiledForest::compile_bitvector()
+{
+    if (_roots.empty()) {
+        throw SaturnError("cannot compile a forest without trees");
+    }
+    _has_bitvector = false;
+    _qs_offsets.assign(_n_predictors + 1, 0);
+    _qs_threshold.clear();
+    _qs_tree.clear();
+    _qs_mask.clear();
+    _qs_leaf_base.clear();
+    _qs_leaf_value.clear();
+
+    // (feature, threshold, tree, mask) for every split node.
+    std::vector<std::tuple<int32_t, double, uint32_t, uint64_t>> splits;
+
+    // Numbers the leaves under node `i` from left to right, appending their values,
+    // and records a mask for every split node: when x goes right at the node,
+    // the leaves of its left subtree become unreachable.
+    // Returns the number of leaves under `i`.
+    uint32_t tree = 0;
+    uint32_t leaf_base = 0;
+    std::function<uint32_t(size_t)> visit = [&](size_t i) -> uint32_t {
+        if (_feature[i] < 0) {
+            _qs_leaf_value.push_back(_threshold[i]);
+            return 1;
+        }
+        auto first = static_cast<uint32_t>(_qs_leaf_value.size()) - leaf_base;
+        auto n_left = visit(_left[i]);
+        auto n_right = visit(_left[i] + 1);
+        if (first + n_left + n_right <= 64) {
+            uint64_t left_bits = (n_left == 64) ? ~uint64_t(0) : (((uint64_t(1) << n_left) - 1) << first);
+            splits.emplace_back(_feature[i], _threshold[i], tree, ~left_bits);
+        }
+        return n_left + n_right;
+    };
+
+    for (tree = 0; tree < _roots.size(); tree++) {
+        leaf_base = static_cast<uint32_t>(_qs_leaf_value.size());
+        _qs_leaf_base.push_back(leaf_base);
+        if (visit(_roots[tree]) > 64) {
+            _qs_leaf_base.clear();
+            _qs_leaf_value.clear();
+            _qs_offsets.clear();
+            return false;
+        }
+    }
+
+    std::stable_sort(splits.begin(), splits.end(),
+    [](auto const & a, auto const & b) {
+        return std::make_tuple(std::get<0>(a), std::get<1>(a)) < std::make_tuple(std::get<0>(b), std::get<1>(b));
+    });
+
+    for (auto const & s : splits) {
+        _qs_offsets[std::get<0>(s) + 1]++;
+        _qs_threshold.push_back(std::get<1>(s));
+        _qs_tree.push_back(std::get<2>(s));
+        _qs_mask.push_back(std::get<3>(s));
+    }
+    for (size_t f = 0; f < _n_predictors; f++) {
+        _qs_offsets[f + 1] += _qs_offsets[f];
+    }
+
+    _has_bitvector = true;
+    return true;
+}
+
+
+size_t CompiledForest::n_predictors() const
+{
+    return _n_predictors;
+}
+
+size_t CompiledForest::n_trees() const
+{
+    return _roots.size();
+}
+
+size_t CompiledForest::n_nodes() const
+{
+    return _feature.size();
+}
+
+bool CompiledForest::has_bitvector() const
+{
+    return _has_bitvector;
+}
+
+
+double CompiledForest::predict_one(double const * x) const
+{
+    int32_t const * feature = _feature.data();
+    double const * threshold = _threshold.data();
+    int32_t const * left = _left.data();
+
+    double sum = 0.;
+    for (auto root : _roots) {
+        size_t i = root;
+        while (feature[i] >= 0) {
+            i = left[i] + !(x[feature[i]] <= threshold[i]);
+        }
+        sum += threshold[i];
+    }
+    return sum / _roots.size();
+}
+
+
+double CompiledForest::predict_one(std::vector<double> const & x) const
+{
+    if (x.size() != _n_predictors) {
+        throw SaturnError(mars::make_string(
+                              "expecting ", _n_predictors, " predictors; got ", x.size()));
+    }
+    if (_roots.empty()) {
+        throw SaturnError("forest has no trees");
+    }
+    return this->predict_one(x.data());
+}
+
+
+double CompiledForest::predict_one_bitvector(double const * x) const
+{
+    if (!_has_bitvector) {
+        throw SaturnError("bit-vector evaluation is not available for this forest");
+    }
+
+    thread_local std::vector<uint64_t> leaves;
+    leaves.assign(_roots.size(), ~uint64_t(0));
+
+    for (size_t f = 0; f < _n_predictors; f++) {
+        double const v = x[f];
+        for (auto k = _qs_offsets[f], end = _qs_offsets[f + 1]; k < end; k++) {
+            if (v <= _qs_threshold[k]) {
+                break;
+            }
+            leaves[_qs_tree[k]] &= _qs_mask[k];
+        }
+    }
+
+    double sum = 0.;
+    for (size_t t = 0; t < _roots.size(); t++) {
+        sum += _qs_leaf_value[_qs_leaf_base[t] + __builtin_ctzll(leaves[t])];
+    }
+    return sum / _roots.size();
+}
+
+
+void CompiledForest::predict_many(double const * x, size_t n_rows, double * out) const
+{
+    const size_t block = 64;
+
+    int32_t const * feature = _feature.data();
+    double const * threshold = _threshold.data();
+    int32_t const * left = _left.data();
+
+    for (size_t r0 = 0; r0 < n_rows; r0 += block) {
+        size_t r1 = std::min(r0 + block, n_rows);
+        std::fill(out + r0, out + r1, 0.);
+        for (auto root : _roots) {
+            for (size_t r = r0; r < r1; r++) {
+                double const * row = x + r * _n_predictors;
+                size_t i = root;
+                while (feature[i] >= 0) {
+                    i = left[i] + !(row[feature[i]] <= threshold[i]);
+                }
+                out[r] += threshold[i];
+            }
+        }
+        for (size_t r = r0; r < r1; r++) {
+            out[r] /= _roots.size();
+        }
+    }
+}
+
+}  // namespace
@@ -0,0 +1,197 @@
+#include "saturn/common.h"
+#include "saturn/histogram.h"
+#include "mars/utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace saturn
+{
+
+namespace
+{
+
+int msb(uint64_t v)
+{
+    return 63 - __builtin_clzll(v);
+}
+
+}  // namespace
+
+
+Histogram::Histogram(int precision_bits)
+    : _bits(precision_bits)
+{
+    if (_bits < 2 || _bits > 20) {
+        throw SaturnError(mars::make_string(
+                              "`precision_bits` must be in [2, 20]; got ", precision_bits));
+    }
+    _counts.assign(_n_buckets(_bits), 0);
+}
+
+
+size_t Histogram::_n_buckets(int bits)
+{
+    // 2^bits single-value buckets, then 2^(bits - 1) buckets per power of 2 above.
+    return (size_t(1) << bits) + size_t(64 - bits) * (size_t(1) << (bits - 1));
+}
+
+
+size_t Histogram::_index(uint64_t value, int bits)
+{
+    if (value < (uint64_t(1) << bits)) {
+        return static_cast<size_t>(value);
+    }
+    int shift = msb(value) - bits + 1;  // `value >> shift` is in [2^(bits - 1), 2^bits)
+    uint64_t half = uint64_t(1) << (bits - 1);
+    return static_cast<size_t>((uint64_t(1) << bits) + uint64_t(shift - 1) * half + ((value >> shift) - half));
+}
+
+
+uint64_t Histogram::_upper(size_t index, int bits)
+{
+    if (index < (size_t(1) << bits)) {
+        return index;
+    }
+    uint64_t half = uint64_t(1) << (bits - 1);
+    uint64_t r = index - (size_t(1) << bits);
+    int shift = static_cast<int>(r / half) + 1;
+    uint64_t sub = r % half + half;
+    return ((sub + 1) << shift) - 1;
+}
+
+
+void Histogram::record(uint64_t value)
+{
+    this->record(value, 1);
+}
+
+
+void Histogram::record(uint64_t value, uint64_t n)
+{
+    if (n == 0) {
+        return;
+    }
+    _counts[_index(value, _bits)] += n;
+    if (_count == 0 || value < _min) {
+        _min = value;
+    }
+    if (value > _max) {
+        _max = value;
+    }
+    _count += n;
+    _sum += static_cast<double>(value) * n;
+}
+
+
+void Histogram::merge(Histogram const & other)
+{
+    if (other._bits != _bits) {
+        throw SaturnError("can not merge histograms of different precision");
+    }
+    if (other._count == 0) {
+        return;
+    }
+    for (size_t i = 0; i < _counts.size(); i++) {
+        _counts[i] += other._counts[i];
+    }
+    _min = (_count == 0) ? other._min : std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+    _count += other._count;
+    _sum += other._sum;
+}
+
+
+void Histogram::reset()
+{
+    std::fill(_counts.begin(), _counts.end(), 0);
+    _count = 0;
+    _min = 0;
+    _max = 0;
+    _sum = 0.;
+}
+
+
+uint64_t Histogram::count() const
+{
+    return _count;
+}
+
+uint64_t Histogram::min() const
+{
+    return _min;
+}
+
+uint64_t Histogram::max() const
+{
+    return _max;
+}
+
+double Histogram::mean() const
+{
+    return _count == 0 ? 0. : _sum / _count;
+}
+
+int Histogram::precision_bits() const
+{
+    return _bits;
+}
+
+
+uint64_t Histogram::percentile(double p) const
+{
+    if (_count == 0) {
+        return 0;
+    }
+    p = std::min(std::max(p, 0.), 100.);
+    auto rank = static_cast<uint64_t>(std::ceil(p / 100. * _count));
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < _counts.size(); i++) {
+        seen += _counts[i];
+        if (seen >= rank) {
+            return std::min(_upper(i, _bits), _max);
+        }
+    }
+    return _max;
+}
+
+
+AtomicHistogram::AtomicHistogram(int precision_bits)
+    : _bits(precision_bits)
+{
+    if (_bits < 2 || _bits > 20) {
+        throw SaturnError(mars::make_string(
+                              "`precision_bits` must be in [2, 20]; got ", precision_bits));
+    }
+    auto n = Histogram::_n_buckets(_bits);
+    _counts.reset(new std::atomic<uint64_t>[n]);
+    for (size_t i = 0; i < n; i++) {
+        _counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+
+void AtomicHistogram::snapshot(Histogram & out, double scale) const
+{
+    auto n = Histogram::_n_buckets(_bits);
+    for (size_t i = 0; i < n; i++) {
+        auto c = _counts[i].load(std::memory_order_relaxed);
+        if (c > 0) {
+            // Midpoint of the bucket.
+            uint64_t lower = (i == 0) ? 0 : Histogram::_upper(i - 1, _bits) + 1;
+            double mid = (static_cast<double>(lower) + static_cast<double>(Histogram::_upper(i, _bits))) / 2.;
+            out.record(static_cast<uint64_t>(mid * scale + 0.5), c);
+        }
+    }
+}
+
+
+int AtomicHistogram::precision_bits() const
+{
+    return _bits;
+}
+
+}  // namespace
@@ -0,0 +1,266 @@
+#include "saturn/common.h"
+#include "saturn/id_value_file.h"
+#include "saturn/parallel.h"
+#include "mars/utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <numeric>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace saturn
+{
+
+namespace
+{
+
+// Below this, a file is parsed as one chunk.
+size_t const MIN_CHUNK_BYTES = 1 << 20;
+
+
+bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+
+// What one chunk of the file yields; merged in chunk order.
+struct Chunk {
+    char const * begin;
+    char const * end;
+    size_t n_lines = 0;  // lines started in the chunk
+    std::vector<std::string> ids;
+    std::vector<double> values;
+    size_t n_malformed = 0;
+    std::vector<IdValueFile::Error> errors;  // lines counted from the chunk's first
+};
+
+
+void parse_chunk(Chunk & chunk, size_t n_values)
+{
+    std::vector<double> row(n_values);
+    char const * p = chunk.begin;
+    while (p < chunk.end) {
+        char const * eol = static_cast<char const *>(std::memchr(p, '\n', chunk.end - p));
+        if (eol == nullptr) {
+            eol = chunk.end;
+        }
+        chunk.n_lines++;
+
+        auto fail = [&](std::string message) {
+            if (chunk.n_malformed++ < IdValueFile::max_errors) {
+                chunk.errors.push_back(IdValueFile::Error{chunk.n_lines, std::move(message)});
+            }
+        };
+        auto skip_blanks = [&]() {
+            while (p < eol && is_blank(*p)) {
+                p++;
+            }
+        };
+        auto token_end = [&]() {
+            char const * q = p;
+            while (q < eol && !is_blank(*q)) {
+                q++;
+            }
+            return q;
+        };
+
+        skip_blanks();
+        if (p == eol) {
+            p = eol + 1;  // blank line
+            continue;
+        }
+        char const * id_end = token_end();
+        char const * id = p;
+        p = id_end;
+
+        size_t n = 0;
+        bool ok = true;
+        for (skip_blanks(); p < eol; skip_blanks()) {
+            char const * end = token_end();
+            if (n == n_values) {
+                n++;  // too many; counted for the message
+                p = end;
+                continue;
+            }
+            char const * first = (*p == '+' && end - p > 1) ? p + 1 : p;  // as `>>` would take it
+            double x;
+            auto result = std::from_chars(first, end, x);
+            if (result.ec != std::errc() || result.ptr != end || !std::isfinite(x)) {
+                fail(mars::make_string("bad number `", std::string(p, end), "`"));
+                ok = false;
+                break;
+            }
+            row[n++] = x;
+            p = end;
+        }
+        if (ok && n != n_values) {
+            fail(mars::make_string("expecting ", n_values, " value(s) after the id, got ", n));
+            ok = false;
+        }
+        if (ok) {
+            chunk.ids.emplace_back(id, id_end);
+            chunk.values.insert(chunk.values.end(), row.begin(), row.end());
+        }
+        p = eol + 1;
+    }
+}
+
+}  // namespace
+
+
+IdValueFile::IdValueFile(std::string const & path, size_t n_values, size_t n_threads)
+    : _path(path), _n_values(n_values)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return;
+        }
+        throw SaturnError(mars::make_string("cannot open '", path, "': ", std::strerror(errno)));
+    }
+    _exists = true;
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw SaturnError(mars::make_string("cannot read '", path, "': ", std::strerror(errno)));
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return;
+    }
+    void * m = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) {
+        throw SaturnError(mars::make_string("cannot map '", path, "': ", std::strerror(errno)));
+    }
+    ::madvise(m, size, MADV_SEQUENTIAL);
+    char const * base = static_cast<char const *>(m);
+    char const * end = base + size;
+
+    // Cut at the first line break after each even split point.
+    n_threads = resolve_thread_count(n_threads);
+    size_t n_chunks = std::max<size_t>(1, std::min(n_threads * 4, size / MIN_CHUNK_BYTES));
+    std::vector<Chunk> chunks;
+    char const * begin = base;
+    for (size_t i = 1; i <= n_chunks && begin < end; i++) {
+        char const * cut = (i == n_chunks) ? end : base + size / n_chunks * i;
+        if (cut < begin) {
+            cut = begin;
+        }
+        if (cut < end) {
+            auto nl = static_cast<char const *>(std::memchr(cut, '\n', end - cut));
+            cut = (nl == nullptr) ? end : nl + 1;
+        }
+        Chunk c;
+        c.begin = begin;
+        c.end = cut;
+        chunks.push_back(std::move(c));
+        begin = cut;
+    }
+
+    try {
+        parallel_chunks(chunks.size(), 1, std::min(chunks.size(), n_threads),
+                        [&](size_t, size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                parse_chunk(chunks[i], _n_values);
+            }
+        });
+    } catch (...) {
+        ::munmap(m, size);
+        throw;
+    }
+    ::munmap(m, size);
+
+    size_t n_rows = 0;
+    for (auto const & c : chunks) {
+        n_rows += c.ids.size();
+    }
+    _ids.reserve(n_rows);
+    _values.reserve(n_rows * _n_values);
+    size_t line0 = 0;
+    for (auto & c : chunks) {
+        std::move(c.ids.begin(), c.ids.end(), std::back_inserter(_ids));
+        _values.insert(_values.end(), c.values.begin(), c.values.end());
+        for (auto & e : c.errors) {
+            if (_errors.size() < max_errors) {
+                _errors.push_back(Error{line0 + e.line, std::move(e.message)});
+            }
+        }
+        _n_malformed += c.n_malformed;
+        line0 += c.n_lines;
+    }
+}
+
+
+bool IdValueFile::exists() const
+{
+    return _exists;
+}
+
+size_t IdValueFile::size() const
+{
+    return _ids.size();
+}
+
+std::string const & IdValueFile::id(size_t row) const
+{
+    return _ids[row];
+}
+
+double IdValueFile::value(size_t row, size_t column) const
+{
+    return _values[row * _n_values + column];
+}
+
+
+std::vector<size_t> IdValueFile::sorted_unique_rows() const
+{
+    std::vector<size_t> rows(_ids.size());
+    std::iota(rows.begin(), rows.end(), size_t(0));
+    // Stable, so that the first of equal ids comes first.
+    std::stable_sort(rows.begin(), rows.end(), [this](size_t a, size_t b) {
+        return _ids[a] < _ids[b];
+    });
+    rows.erase(std::unique(rows.begin(), rows.end(), [this](size_t a, size_t b) {
+        return _ids[a] == _ids[b];
+    }), rows.end());
+    return rows;
+}
+
+
+size_t IdValueFile::n_malformed() const
+{
+    return _n_malformed;
+}
+
+std::vector<IdValueFile::Error> const & IdValueFile::errors() const
+{
+    return _errors;
+}
+
+
+std::string IdValueFile::error_summary() const
+{
+    if (_n_malformed == 0) {
+        return "";
+    }
+    std::string summary = mars::make_string(_path, ": ", _n_malformed, " malformed line(s) skipped");
+    size_t const shown = 3;
+    for (size_t i = 0; i < _errors.size() && i < shown; i++) {
+        summary += mars::make_string("; line ", _errors[i].line, ": ", _errors[i].message);
+    }
+    if (_n_malformed > shown) {
+        summary += "; ...";
+    }
+    return summary;
+}
+
+}  // namespace
@@ -0,0 +1,121 @@
+#include "saturn/common.h"
+#include "saturn/load_shedder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace saturn
+{
+
+
+LoadShedder::LoadShedder()
+    : LoadShedder(Config())
+{
+}
+
+
+LoadShedder::LoadShedder(Config const & config)
+    : _config(config),
+      _latency_us(0.), _queue_depth(0), _shed_rate(0.), _shedding(false),
+      _n_observations(0), _n_calls(0), _n_shed(0)
+{
+    if (config.latency_low_us > config.latency_high_us || config.queue_low > config.queue_high) {
+        throw SaturnError("`LoadShedder` 'low' thresholds must not exceed 'high' thresholds");
+    }
+    if (config.window == 0 || config.step <= 0. || config.max_shed_rate < 0. || config.max_shed_rate > 1.) {
+        throw SaturnError("invalid `LoadShedder` config");
+    }
+}
+
+
+void LoadShedder::record_latency(long us)
+{
+    // Weight 1/16 on the newest observation. Concurrent updates may occasionally
+    // overwrite each other, which does not matter for a moving average.
+    double avg = _latency_us.load(std::memory_order_relaxed);
+    _latency_us.store(avg + (us - avg) / 16., std::memory_order_relaxed);
+
+    if ((_n_observations.fetch_add(1, std::memory_order_relaxed) + 1) % _config.window == 0) {
+        this->_adjust();
+    }
+}
+
+
+void LoadShedder::record_queue_depth(size_t depth)
+{
+    _queue_depth.store(depth, std::memory_order_relaxed);
+}
+
+
+void LoadShedder::_adjust()
+{
+    std::unique_lock<std::mutex> lock(_adjust_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;  // Someone else is adjusting for this window.
+    }
+
+    double latency = _latency_us.load(std::memory_order_relaxed);
+    size_t depth = _queue_depth.load(std::memory_order_relaxed);
+    bool use_queue = _config.queue_high > 0;
+
+    bool overloaded = latency > _config.latency_high_us || (use_queue && depth > _config.queue_high);
+    bool relieved = latency < _config.latency_low_us && (!use_queue || depth <= _config.queue_low);
+
+    double rate = _shed_rate.load(std::memory_order_relaxed);
+    if (overloaded) {
+        rate = std::min(_config.max_shed_rate, rate + _config.step);
+        _shedding.store(true, std::memory_order_relaxed);
+    } else if (relieved && _shedding.load(std::memory_order_relaxed)) {
+        rate = std::max(0., rate - _config.step);
+        if (rate < 1e-9) {
+            rate = 0.;
+            _shedding.store(false, std::memory_order_relaxed);
+        }
+    }
+    _shed_rate.store(rate, std::memory_order_relaxed);
+}
+
+
+bool LoadShedder::should_shed()
+{
+    if (!_shedding.load(std::memory_order_relaxed)) {
+        _n_calls.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    // Call n is shed iff floor((n + 1) * rate) > floor(n * rate).
+    double rate = _shed_rate.load(std::memory_order_relaxed);
+    auto n = static_cast<double>(_n_calls.fetch_add(1, std::memory_order_relaxed));
+    bool shed = std::floor((n + 1.) * rate) > std::floor(n * rate);
+    if (shed) {
+        _n_shed.fetch_add(1, std::memory_order_relaxed);
+    }
+    return shed;
+}
+
+
+LoadShedder::State LoadShedder::state() const
+{
+    return _shedding.load(std::memory_order_relaxed) ? State::shedding : State::normal;
+}
+
+double LoadShedder::shed_rate() const
+{
+    return _shed_rate.load(std::memory_order_relaxed);
+}
+
+double LoadShedder::latency_us() const
+{
+    return _latency_us.load(std::memory_order_relaxed);
+}
+
+size_t LoadShedder::n_shed() const
+{
+    return _n_shed.load(std::memory_order_relaxed);
+}
+
+size_t LoadShedder::n_calls() const
+{
+    return _n_calls.load(std::memory_order_relaxed);
+}
+
+}  // namespace
@@ -0,0 +1,118 @@
+#include "saturn/common.h"
+#include "saturn/memory.h"
+
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace saturn
+{
+
+void MemoryUsage::add(std::string const & name, size_t count, size_t bytes)
+{
+    items.push_back(Item{name, count, bytes, false});
+}
+
+
+void MemoryUsage::add_heap_growth(std::string const & name, size_t count, size_t bytes)
+{
+    items.push_back(Item{name, count, bytes, true});
+}
+
+
+void MemoryUsage::add(std::string const & prefix, MemoryUsage const & other)
+{
+    for (auto const & item : other.items) {
+        items.push_back(Item{prefix + item.name, item.count, item.bytes, item.heap_growth});
+    }
+}
+
+
+size_t MemoryUsage::total() const
+{
+    size_t n = 0;
+    for (auto const & item : items) {
+        n += item.bytes;
+    }
+    return n;
+}
+
+
+size_t MemoryUsage::counted() const
+{
+    size_t n = 0;
+    for (auto const & item : items) {
+        if (!item.heap_growth) {
+            n += item.bytes;
+        }
+    }
+    return n;
+}
+
+
+void MemoryUsage::write(std::ostream & out) const
+{
+    for (auto const & item : items) {
+        out << std::left << std::setw(48) << item.name << std::right
+            << std::setw(10) << item.count
+            << std::setw(14) << item.bytes << (item.heap_growth ? " ~" : "") << '\n';
+    }
+    out << std::left << std::setw(48) << "total" << std::right
+        << std::setw(10) << ""
+        << std::setw(14) << this->total() << '\n';
+}
+
+
+size_t heap_in_use()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    auto info = mallinfo();
+    return static_cast<size_t>(static_cast<unsigned int>(info.uordblks)) +
+           static_cast<size_t>(static_cast<unsigned int>(info.hblkhd));
+#else
+    return 0;
+#endif
+}
+
+
+size_t resident_bytes()
+{
+    // Second field of /proc/self/statm, in pages.
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    if (!(statm >> size >> resident)) {
+        return 0;
+    }
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+
+size_t file_bytes(std::string const & dir, std::string const & suffix)
+{
+    auto d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return 0;
+    }
+    size_t n = 0;
+    while (auto entry = readdir(d)) {
+        std::string name = entry->d_name;
+        struct stat st;
+        if (name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0
+            && stat((dir + "/" + name).c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            n += static_cast<size_t>(st.st_size);
+        }
+    }
+    closedir(d);
+    return n;
+}
+
+}  // namespace
@@ -0,0 +1,92 @@
+#include "saturn/common.h"
+#include "saturn/model_context.h"
+#include "mars/utils.h"
+
+namespace saturn
+{
+
+namespace
+{
+
+std::vector<ModelLoader::Entry> model_entries(std::string const & svr, std::string const & ctr, std::string const & wr)
+{
+    std::vector<ModelLoader::Entry> entries;
+    if (!svr.empty()) {
+        entries.push_back(ModelLoader::Entry{ModelLoader::Kind::svr, svr});
+    }
+    if (!ctr.empty()) {
+        entries.push_back(ModelLoader::Entry{ModelLoader::Kind::ctr, ctr});
+    }
+    if (!wr.empty()) {
+        entries.push_back(ModelLoader::Entry{ModelLoader::Kind::wr, wr});
+    }
+    return entries;
+}
+
+}  // namespace
+
+
+ModelContext::ModelContext(std::vector<ModelLoader::Entry> const & entries)
+    : model_set(feature_engine)
+{
+    size_t n_of_kind[3] = {0, 0, 0};
+    for (auto const & entry : entries) {
+        if (++n_of_kind[static_cast<size_t>(entry.kind)] > 1) {
+            throw SaturnError(mars::make_string("more than one `", ModelLoader::kind_name(entry.kind), "` model"));
+        }
+    }
+
+    ModelLoader loader(feature_engine, entries);
+    load_report = loader.report();
+    if (!loader.svr_models().empty()) {
+        svr_model = std::move(loader.svr_models()[0]);
+        model_set.set_svr_model(svr_model.get());
+    }
+    if (!loader.ctr_models().empty()) {
+        ctr_model = std::move(loader.ctr_models()[0]);
+        model_set.set_ctr_model(ctr_model.get());
+    }
+    if (!loader.wr_models().empty()) {
+        wr_model = std::move(loader.wr_models()[0]);
+        model_set.set_wr_model(wr_model.get());
+    }
+    request.reset_fields = true;
+    request.run_ctr = !!ctr_model;
+    request.run_wr = !!wr_model;
+}
+
+
+ModelContext::ModelContext(std::string const & svr, std::string const & ctr, std::string const & wr)
+    : ModelContext(model_entries(svr, ctr, wr))
+{
+}
+
+
+ModelContext::ModelContext(ModelContext const & prototype)
+    : feature_engine(prototype.feature_engine.clone_context()), model_set(feature_engine),
+      request(prototype.request)
+{
+    if (prototype.svr_model) {
+        svr_model.reset(new SvrModel(*prototype.svr_model, feature_engine));
+        model_set.set_svr_model(svr_model.get());
+    }
+    if (prototype.ctr_model) {
+        ctr_model.reset(new ctrModel(*prototype.ctr_model, feature_engine));
+        model_set.set_ctr_model(ctr_model.get());
+    }
+    if (prototype.wr_model) {
+        wr_model.reset(new WrModel(*prototype.wr_model, feature_engine));
+        model_set.set_wr_model(wr_model.get());
+    }
+}
+
+
+std::string strip_slash(std::string path)
+{
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+}  // namespace
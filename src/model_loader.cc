@@ -0,0 +1,170 @@
+#include "saturn/common.h"
+#include "saturn/model_loader.h"
+#include "saturn/parallel.h"
+#include "saturn/utils.h"
+#include "mars/utils.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace saturn
+{
+
+namespace
+{
+
+double process_cpu_seconds()
+{
+    timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) {
+        return 0.;
+    }
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+}  // namespace
+
+
+std::vector<ModelLoader::Entry> ModelLoader::read_manifest(std::string const & file)
+{
+    std::ifstream in(file);
+    if (!in) {
+        throw SaturnError(mars::make_string("cannot read manifest '", file, "'"));
+    }
+    std::vector<Entry> entries;
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        std::istringstream fields(line);
+        std::string kind, path, extra;
+        if (!(fields >> kind) || kind[0] == '#') {
+            continue;
+        }
+        if (!(fields >> path) || (fields >> extra)) {
+            throw SaturnError(mars::make_string(file, ":", line_no, ": expecting `kind path`"));
+        }
+        Entry entry;
+        if (kind == "svr") {
+            entry.kind = Kind::svr;
+        } else if (kind == "ctr") {
+            entry.kind = Kind::ctr;
+        } else if (kind == "wr") {
+            entry.kind = Kind::wr;
+        } else {
+            throw SaturnError(mars::make_string(file, ":", line_no, ": unknown model kind `", kind, "`"));
+        }
+        entry.path = path;
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+
+ModelLoader::ModelLoader(FeatureEngine & feature_engine, std::vector<Entry> const & entries, size_t n_threads)
+{
+    size_t n = entries.size();
+    size_t n_svr = 0, n_ctr = 0, n_wr = 0;
+    std::vector<size_t> slot(n);  // index within its kind
+    for (size_t i = 0; i < n; i++) {
+        switch (entries[i].kind) {
+            case Kind::svr: slot[i] = n_svr++; break;
+            case Kind::ctr: slot[i] = n_ctr++; break;
+            case Kind::wr: slot[i] = n_wr++; break;
+        }
+        Report::Model m;
+        m.kind = entries[i].kind;
+        m.path = entries[i].path;
+        _report.models.push_back(m);
+    }
+    _svr_models.resize(n_svr);
+    _ctr_models.resize(n_ctr);
+    _wr_models.resize(n_wr);
+
+    auto cpu0 = process_cpu_seconds();
+    auto timer = Timer();
+    timer.start();
+    if (n > 0) {
+        n_threads = std::min(n, resolve_thread_count(n_threads));
+        // One model per chunk; every task writes only its own slots.
+        parallel_chunks(n, 1, n_threads, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                auto const & entry = entries[i];
+                auto model_timer = Timer();
+                model_timer.start();
+                switch (entry.kind) {
+                    case Kind::svr:
+                        _svr_models[slot[i]].reset(new SvrModel(feature_engine, entry.path));
+                        break;
+                    case Kind::ctr:
+                        _ctr_models[slot[i]].reset(new ctrModel(feature_engine, entry.path));
+                        break;
+                    case Kind::wr:
+                        _wr_models[slot[i]].reset(new WrModel(feature_engine, entry.path));
+                        break;
+                }
+                model_timer.stop();
+                _report.models[i].wall_seconds = model_timer.seconds();
+            }
+        });
+    }
+    timer.stop();
+    _report.wall_seconds = timer.seconds();
+    _report.cpu_seconds = process_cpu_seconds() - cpu0;
+}
+
+
+std::vector<std::unique_ptr<SvrModel>> & ModelLoader::svr_models()
+{
+    return _svr_models;
+}
+
+std::vector<std::unique_ptr<ctrModel>> & ModelLoader::ctr_models()
+{
+    return _ctr_models;
+}
+
+std::vector<std::unique_ptr<WrModel>> & ModelLoader::wr_models()
+{
+    return _wr_models;
+}
+
+ModelLoader::Report const & ModelLoader::report() const
+{
+    return _report;
+}
+
+
+char const * ModelLoader::kind_name(Kind kind)
+{
+    switch (kind) {
+        case Kind::svr: return "svr";
+        case Kind::ctr: return "ctr";
+        case Kind::wr: return "wr";
+    }
+    return "";
+}
+
+
+void ModelLoader::Report::write(std::ostream & out) const
+{
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    double summed = 0.;
+    for (auto const & m : models) {
+        out << std::left << std::setw(4) << kind_name(m.kind) << std::right << std::setw(10)
+            << m.wall_seconds << " s  " << m.path << '\n';
+        summed += m.wall_seconds;
+    }
+    out << "wall " << wall_seconds << " s, CPU " << cpu_seconds << " s (parallelism "
+        << (wall_seconds > 0. ? cpu_seconds / wall_seconds : 0.) << "), per-model wall summed "
+        << summed << " s\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+}  // namespace
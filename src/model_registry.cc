@@ -0,0 +1,355 @@
+#include "saturn/common.h"
+#include "saturn/memory.h"
+#include "saturn/model_registry.h"
+#include "saturn/utils.h"
+#include "mars/utils.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+namespace saturn
+{
+
+namespace
+{
+
+ModelRegistry::Loaded load_model(FeatureEngine & feature_engine, ModelRegistry::Kind kind, std::string const & path)
+{
+    std::vector<ModelLoader::Entry> entries(1, ModelLoader::Entry{kind, path});
+    ModelLoader loader(feature_engine, entries, 1);
+    ModelRegistry::Loaded loaded;
+    switch (kind) {
+        case ModelRegistry::Kind::svr:
+            loaded.svr_model.reset(loader.svr_models()[0].release());
+            loaded.bytes = loaded.svr_model->memory_usage().counted();
+            break;
+        case ModelRegistry::Kind::ctr:
+            loaded.ctr_model.reset(loader.ctr_models()[0].release());
+            loaded.bytes = loaded.ctr_model->memory_usage().counted();
+            break;
+        case ModelRegistry::Kind::wr:
+            loaded.wr_model.reset(loader.wr_models()[0].release());
+            loaded.bytes = loaded.wr_model->memory_usage().counted();
+            break;
+    }
+    loaded.bytes += file_bytes(path, ".data");
+    return loaded;
+}
+
+}  // namespace
+
+
+ModelRegistry::ModelRegistry(FeatureEngine & feature_engine, size_t memory_budget, LoadFunction load)
+    : _feature_engine(feature_engine), _memory_budget(memory_budget), _load_function(std::move(load)),
+      _owner(std::this_thread::get_id()), _engine_base(feature_engine.memory_usage().counted())
+{
+    if (!_load_function) {
+        _load_function = [this](Kind kind, std::string const & path) {
+            return load_model(_feature_engine, kind, path);
+        };
+    }
+}
+
+
+void ModelRegistry::add(Kind kind, std::string const & id, std::string const & path, bool pinned)
+{
+    this->_check_owner("add");
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto key = std::make_pair(kind, id);
+    if (_entries.count(key) > 0) {
+        throw SaturnError(mars::make_string(ModelLoader::kind_name(kind), " model `", id, "` is already registered"));
+    }
+    auto & entry = _entries[key];
+    entry.kind = kind;
+    entry.id = id;
+    entry.path = path;
+    if (pinned) {
+        entry.pinned = true;
+        this->_use(entry);
+    }
+}
+
+
+void ModelRegistry::add_manifest(std::string const & file)
+{
+    std::ifstream in(file);
+    if (!in) {
+        throw SaturnError(mars::make_string("cannot read manifest '", file, "'"));
+    }
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        std::istringstream fields(line);
+        std::string kind_name, id, path, flag, extra;
+        if (!(fields >> kind_name) || kind_name[0] == '#') {
+            continue;
+        }
+        if (!(fields >> id >> path)) {
+            throw SaturnError(mars::make_string(file, ":", line_no, ": expecting `kind id path [pinned]`"));
+        }
+        bool pinned = false;
+        if (fields >> flag) {
+            if (flag != "pinned" || (fields >> extra)) {
+                throw SaturnError(mars::make_string(file, ":", line_no, ": expecting `kind id path [pinned]`"));
+            }
+            pinned = true;
+        }
+        Kind kind;
+        if (kind_name == "svr") {
+            kind = Kind::svr;
+        } else if (kind_name == "ctr") {
+            kind = Kind::ctr;
+        } else if (kind_name == "wr") {
+            kind = Kind::wr;
+        } else {
+            throw SaturnError(mars::make_string(file, ":", line_no, ": unknown model kind `", kind_name, "`"));
+        }
+        this->add(kind, id, path, pinned);
+    }
+}
+
+
+bool ModelRegistry::has(Kind kind, std::string const & id) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.count(std::make_pair(kind, id)) > 0;
+}
+
+
+std::shared_ptr<SvrModel> ModelRegistry::svr(std::string const & id)
+{
+    this->_check_owner("svr");
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto & entry = this->_entry(Kind::svr, id);
+    this->_use(entry);
+    return entry.svr_model;
+}
+
+std::shared_ptr<ctrModel> ModelRegistry::ctr(std::string const & id)
+{
+    this->_check_owner("ctr");
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto & entry = this->_entry(Kind::ctr, id);
+    this->_use(entry);
+    return entry.ctr_model;
+}
+
+std::shared_ptr<WrModel> ModelRegistry::wr(std::string const & id)
+{
+    this->_check_owner("wr");
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto & entry = this->_entry(Kind::wr, id);
+    this->_use(entry);
+    return entry.wr_model;
+}
+
+
+void ModelRegistry::pin(Kind kind, std::string const & id)
+{
+    this->_check_owner("pin");
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto & entry = this->_entry(kind, id);
+    entry.pinned = true;
+    if (!entry.resident) {
+        this->_use(entry);
+    }
+}
+
+
+void ModelRegistry::unpin(Kind kind, std::string const & id)
+{
+    this->_check_owner("unpin");
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto & entry = this->_entry(kind, id);
+    entry.pinned = false;
+    this->_fit(nullptr);
+}
+
+
+bool ModelRegistry::evict(Kind kind, std::string const & id)
+{
+    this->_check_owner("evict");
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto & entry = this->_entry(kind, id);
+    if (!entry.resident || entry.pinned) {
+        return false;
+    }
+    this->_drop(entry);
+    return true;
+}
+
+
+size_t ModelRegistry::memory_budget() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _memory_budget;
+}
+
+
+void ModelRegistry::set_memory_budget(size_t bytes)
+{
+    this->_check_owner("set_memory_budget");
+    std::lock_guard<std::mutex> lock(_mutex);
+    _memory_budget = bytes;
+    this->_fit(nullptr);
+}
+
+
+ModelRegistry::Stats ModelRegistry::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Stats stats;
+    for (auto const & kv : _entries) {
+        auto const & e = kv.second;
+        Stats::Model m;
+        m.kind = e.kind;
+        m.id = e.id;
+        m.path = e.path;
+        m.resident = e.resident;
+        m.pinned = e.pinned;
+        m.bytes = e.bytes;
+        m.hits = e.hits;
+        m.loads = e.loads;
+        m.evictions = e.evictions;
+        m.load_seconds = e.load_seconds;
+        stats.models.push_back(m);
+    }
+    stats.memory_budget = _memory_budget;
+    stats.resident_bytes = _resident_bytes;
+    stats.engine_bytes = _engine_bytes;
+    stats.n_resident = _lru.size();
+    stats.hits = _hits;
+    stats.misses = _misses;
+    stats.loads = _loads;
+    stats.failed_loads = _failed_loads;
+    stats.evictions = _evictions;
+    stats.load_microseconds = _load_microseconds;
+    return stats;
+}
+
+
+void ModelRegistry::_check_owner(char const * method) const
+{
+    if (std::this_thread::get_id() != _owner) {
+        throw SaturnError(mars::make_string("ModelRegistry::", method,
+                                            " called off the thread that owns the registry and its feature engine"));
+    }
+}
+
+
+ModelRegistry::Entry & ModelRegistry::_entry(Kind kind, std::string const & id)
+{
+    auto it = _entries.find(std::make_pair(kind, id));
+    if (it == _entries.end()) {
+        throw SaturnError(mars::make_string("no ", ModelLoader::kind_name(kind), " model `", id, "` is registered"));
+    }
+    return it->second;
+}
+
+
+void ModelRegistry::_use(Entry & entry)
+{
+    if (entry.resident) {
+        entry.hits++;
+        _hits++;
+        _lru.splice(_lru.begin(), _lru, entry.lru);
+        return;
+    }
+    _misses++;
+    this->_load(entry);
+    // Make room after loading: the size of a model is known only once it is loaded.
+    this->_fit(&entry);
+}
+
+
+void ModelRegistry::_load(Entry & entry)
+{
+    auto timer = Timer();
+    timer.start();
+    Loaded loaded;
+    try {
+        loaded = _load_function(entry.kind, entry.path);
+    } catch (...) {
+        _failed_loads++;
+        throw;
+    }
+    timer.stop();
+    size_t engine = _feature_engine.memory_usage().counted();
+    _engine_bytes = (engine > _engine_base) ? engine - _engine_base : 0;
+
+    entry.svr_model = std::move(loaded.svr_model);
+    entry.ctr_model = std::move(loaded.ctr_model);
+    entry.wr_model = std::move(loaded.wr_model);
+    entry.resident = true;
+    entry.bytes = loaded.bytes;
+    entry.loads++;
+    entry.load_seconds += timer.seconds();
+    _lru.push_front(&entry);
+    entry.lru = _lru.begin();
+    _resident_bytes += loaded.bytes;
+    _loads++;
+    _load_microseconds.record(static_cast<uint64_t>(timer.microseconds()));
+}
+
+
+void ModelRegistry::_drop(Entry & entry)
+{
+    entry.svr_model.reset();
+    entry.ctr_model.reset();
+    entry.wr_model.reset();
+    entry.resident = false;
+    _lru.erase(entry.lru);
+    _resident_bytes -= entry.bytes;
+    entry.evictions++;
+    _evictions++;
+}
+
+
+void ModelRegistry::_fit(Entry const * keep)
+{
+    if (_memory_budget == 0) {
+        return;
+    }
+    auto it = _lru.end();
+    while (_resident_bytes + _engine_bytes > _memory_budget && it != _lru.begin()) {
+        --it;
+        Entry * e = *it;
+        if (e == keep || e->pinned) {
+            continue;
+        }
+        auto next = std::next(it);
+        this->_drop(*e);
+        it = next;
+    }
+}
+
+
+void ModelRegistry::Stats::write(std::ostream & out) const
+{
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << "budget " << memory_budget << " bytes, resident " << resident_bytes << " bytes in "
+        << n_resident << " model(s), engine growth " << engine_bytes << " bytes\n"
+        << "hits " << hits << ", misses " << misses << ", loads " << loads << ", failed loads "
+        << failed_loads << ", evictions " << evictions << '\n';
+    if (load_microseconds.count() > 0) {
+        out << "load ms: p50 " << load_microseconds.percentile(50.) * 1e-3
+            << ", p90 " << load_microseconds.percentile(90.) * 1e-3
+            << ", p99 " << load_microseconds.percentile(99.) * 1e-3
+            << ", max " << load_microseconds.max() * 1e-3 << '\n';
+    }
+    for (auto const & m : models) {
+        out << std::left << std::setw(4) << ModelLoader::kind_name(m.kind) << ' ' << m.id
+            << (m.resident ? " resident" : " evicted") << (m.pinned ? " pinned" : "")
+            << " bytes " << m.bytes << " hits " << m.hits << " loads " << m.loads
+            << " evictions " << m.evictions << " load_s " << m.load_seconds << ' ' << m.path << '\n';
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+}  // namespace
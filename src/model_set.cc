@@ -0,0 +1,180 @@
+#include "saturn/common.h"
+#include "saturn/model_set.h"
+#include "saturn/utils.h"
+
+namespace saturn
+{
+
+
+ModelSet::ModelSet(FeatureEngine & feature_engine)
+    : _feature_engine(feature_engine)
+{
+}
+
+
+void ModelSet::set_svr_model(SvrModel * model)
+{
+    if (model && &model->get_features() != &_feature_engine) {
+        throw SaturnError("`SvrModel` uses a different `FeatureEngine` than the `ModelSet`");
+    }
+    _svr_model = model;
+}
+
+void ModelSet::set_ctr_model(ctrModel * model)
+{
+    if (model && &model->get_features() != &_feature_engine) {
+        throw SaturnError("`ctrModel` uses a different `FeatureEngine` than the `ModelSet`");
+    }
+    _ctr_model = model;
+}
+
+void ModelSet::set_wr_model(WrModel * model)
+{
+    if (model && &model->get_features() != &_feature_engine) {
+        throw SaturnError("`WrModel` uses a different `FeatureEngine` than the `ModelSet`");
+    }
+    _wr_model = model;
+}
+
+
+void ModelSet::set_load_shedder(LoadShedder * shedder)
+{
+    _load_shedder = shedder;
+}
+
+
+void ModelSet::Result::clear()
+{
+    ctr_prob = 0.;
+    wr_win_prob = 0.;
+    wr_dev_prob = 0.;
+    wr_final_prob = 0.;
+    ctr_degraded = false;
+    wr_degraded = false;
+    shed = false;
+    svr.clear();
+    ingest_us = 0;
+    ctr_us = 0;
+    wr_us = 0;
+    svr_us = 0;
+    total_us = 0;
+}
+
+
+void ModelSet::run(Request const & request, Result & result)
+{
+    result.clear();
+    if (request.run_ctr && !_ctr_model) {
+        throw SaturnError("request asks for CTR but `ModelSet` has no `ctrModel`");
+    }
+    if (request.run_wr && !_wr_model) {
+        throw SaturnError("request asks for win rate but `ModelSet` has no `WrModel`");
+    }
+    if (!request.svr_calls.empty() && !_svr_model) {
+        throw SaturnError("request asks for SVR but `ModelSet` has no `SvrModel`");
+    }
+
+    auto total = Timer();
+    auto timer = Timer();
+    total.start();
+
+    bool shed = _load_shedder && _load_shedder->should_shed();
+    result.shed = shed;
+
+    timer.start();
+    if (request.reset_fields) {
+        _feature_engine.reset_fields();
+    }
+    for (auto const & f : request.string_fields) {
+        _feature_engine.update_field(f.first, f.second);
+    }
+    for (auto const & f : request.c_str_fields) {
+        _feature_engine.update_field(f.first, f.second);
+    }
+    for (auto const & f : request.int_fields) {
+        _feature_engine.update_field(f.first, f.second);
+    }
+    for (auto const & f : request.float_fields) {
+        _feature_engine.update_field(f.first, f.second);
+    }
+    timer.stop();
+    result.ingest_us = timer.microseconds();
+
+    // Readers of request-level fields first.
+    if (request.run_ctr) {
+        timer.start();
+        result.ctr_prob = _ctr_model->get_prob(request.deadline);
+        result.ctr_degraded = _ctr_model->degraded();
+        timer.stop();
+        result.ctr_us = timer.microseconds();
+    }
+
+    if (request.run_wr) {
+        timer.start();
+        if (shed) {
+            _wr_model->get_win_prob();
+        } else {
+            _wr_model->get_prob(request.deadline);
+        }
+        result.wr_degraded = _wr_model->degraded();
+        result.wr_win_prob = _wr_model->win_prob();
+        result.wr_dev_prob = _wr_model->dev_prob();
+        result.wr_final_prob = _wr_model->final_prob();
+        timer.stop();
+        result.wr_us = timer.microseconds();
+    }
+
+    // `SvrModel` updates `user_extlba` for each call.
+    timer.start();
+    result.svr.resize(request.svr_calls.size());
+    for (size_t i = 0; i < request.svr_calls.size(); i++) {
+        auto const & call = request.svr_calls[i];
+        auto & r = result.svr[i];
+        switch (call.method) {
+            case SvrCall::Method::run:
+                if (shed) {
+                    r.code = _svr_model->run_cheap(call.brand_id, call.adgroup_id, call.user_adgroup_svr);
+                } else {
+                    r.code = _svr_model->run(call.brand_id, call.adgroup_id, call.user_adgroup_svr, call.pacing,
+                                             request.deadline);
+                }
+                break;
+            case SvrCall::Method::get_multiplier:
+                r.code = _svr_model->get_multiplier(call.brand_id, call.adgroup_id, call.user_adgroup_svr, call.mode,
+                                                    request.deadline);
+                break;
+            case SvrCall::Method::get_cpsvr:
+                r.code = _svr_model->get_cpsvr(call.brand_id, call.adgroup_id, call.user_adgroup_svr, call.mode,
+                                               request.deadline);
+                break;
+        }
+        r.svr = _svr_model->svr();
+        r.bid_multiplier = _svr_model->bid_multiplier();
+        r.cpsvr = _svr_model->cpsvr();
+        r.degraded = _svr_model->degraded();
+        if (r.code != 0) {
+            r.message = _svr_model->message();
+        } else {
+            r.message.clear();
+        }
+    }
+    timer.stop();
+    result.svr_us = timer.microseconds();
+
+    total.stop();
+    result.total_us = total.microseconds();
+
+    if (_load_shedder) {
+        _load_shedder->record_latency(result.total_us);
+    }
+}
+
+
+ModelSet::Result ModelSet::run(Request const & request)
+{
+    Result result;
+    this->run(request, result);
+    return result;
+}
+
+}  // namespace
@@ -0,0 +1,109 @@
+#include "saturn/common.h"
+#include "saturn/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace saturn
+{
+
+namespace
+{
+
+struct Share {
+    std::mutex mutex;
+    std::deque<size_t> chunks;
+};
+
+}  // namespace
+
+
+size_t resolve_thread_count(size_t n_threads)
+{
+    if (n_threads == 0) {
+        n_threads = std::thread::hardware_concurrency();
+    }
+    return n_threads == 0 ? 1 : n_threads;
+}
+
+
+void parallel_chunks(size_t n, size_t chunk_size, size_t n_threads,
+                     std::function<void(size_t worker, size_t begin, size_t end)> const & task)
+{
+    if (chunk_size == 0) {
+        throw SaturnError("`chunk_size` must be positive");
+    }
+    n_threads = resolve_thread_count(n_threads);
+    size_t n_chunks = (n + chunk_size - 1) / chunk_size;
+
+    std::vector<std::unique_ptr<Share>> shares;
+    for (size_t t = 0; t < n_threads; t++) {
+        shares.emplace_back(new Share());
+        for (size_t c = n_chunks * t / n_threads; c < n_chunks * (t + 1) / n_threads; c++) {
+            shares[t]->chunks.push_back(c);
+        }
+    }
+
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto next_chunk = [&](size_t worker, size_t & chunk) {
+        {
+            auto & own = *shares[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.chunks.empty()) {
+                chunk = own.chunks.front();
+                own.chunks.pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < n_threads; k++) {
+            auto & victim = *shares[(worker + k) % n_threads];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.chunks.empty()) {
+                chunk = victim.chunks.back();
+                victim.chunks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto run = [&](size_t worker) {
+        size_t chunk;
+        while (!failed.load(std::memory_order_relaxed) && next_chunk(worker, chunk)) {
+            size_t begin = chunk * chunk_size;
+            size_t end = std::min(begin + chunk_size, n);
+            try {
+                task(worker, begin, end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                failed.store(true, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < n_threads; t++) {
+        threads.emplace_back(run, t);
+    }
+    run(0);
+    for (auto & t : threads) {
+        t.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}  // namespace
@@ -0,0 +1,472 @@
+#include "saturn/common.h"
+#include "saturn/replay_file.h"
+#include "mars/utils.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace saturn
+{
+
+namespace
+{
+
+char const MAGIC[8] = {'S', 'A', 'T', 'R', 'P', 'L', '0', '1'};
+
+struct FileHeader {
+    char magic[8];
+    uint64_t n_rows;
+    uint64_t n_columns;
+};
+
+struct ColumnHeader {
+    uint32_t type;
+    uint32_t name_size;
+    uint64_t data_offset;
+    uint64_t dict_offset;
+    uint64_t dict_size;
+};
+
+size_t padded(size_t n)
+{
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+}  // namespace
+
+
+ReplayFile::ReplayFile(std::string const & path)
+    : _path(path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw SaturnError(mars::make_string("cannot open replay file '", path, "': ", std::strerror(errno)));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        throw SaturnError(mars::make_string("'", path, "' is not a replay file"));
+    }
+    _size = static_cast<size_t>(st.st_size);
+    void * p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        throw SaturnError(mars::make_string("cannot map replay file '", path, "': ", std::strerror(errno)));
+    }
+    _base = static_cast<char const *>(p);
+
+    try {
+        auto const * header = reinterpret_cast<FileHeader const *>(_base);
+        if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+            throw SaturnError(mars::make_string("'", path, "' is not a replay file"));
+        }
+        _n_rows = header->n_rows;
+
+        auto bad = [&](std::string const & what) {
+            return SaturnError(mars::make_string("corrupt replay file '", path, "': ", what));
+        };
+        size_t offset = sizeof(FileHeader);
+        for (uint64_t i = 0; i < header->n_columns; i++) {
+            if (offset + sizeof(ColumnHeader) > _size) {
+                throw bad("truncated column list");
+            }
+            auto const * ch = reinterpret_cast<ColumnHeader const *>(_base + offset);
+            offset += sizeof(ColumnHeader);
+            if (ch->type > static_cast<uint32_t>(Type::string) || offset + padded(ch->name_size) > _size) {
+                throw bad("bad column " + std::to_string(i));
+            }
+
+            Column c;
+            c.name.assign(_base + offset, ch->name_size);
+            offset += padded(ch->name_size);
+            c.type = static_cast<Type>(ch->type);
+            c.field_idx = 0;
+            c.kind = request_column(c.name, c.field_idx);
+            size_t width = (c.type == Type::float64) ? sizeof(double) : sizeof(uint32_t);
+            if (ch->data_offset % 8 != 0 || ch->data_offset > _size || _n_rows > (_size - ch->data_offset) / width) {
+                throw bad("data of column '" + c.name + "' out of range");
+            }
+            c.data = _base + ch->data_offset;
+            c.codes = nullptr;
+            c.dict_offsets = nullptr;
+            c.dict_values = 0;
+            c.dict_size = 0;
+
+            if (c.type == Type::string) {
+                if (ch->dict_offset % 8 != 0 || ch->dict_offset > _size ||
+                        ch->dict_size >= (_size - ch->dict_offset) / sizeof(uint64_t)) {
+                    throw bad("dictionary of column '" + c.name + "' out of range");
+                }
+                c.codes = static_cast<uint32_t const *>(c.data);
+                c.dict_offsets = reinterpret_cast<uint64_t const *>(_base + ch->dict_offset);
+                c.dict_size = ch->dict_size;
+                c.dict_values = ch->dict_offset + (c.dict_size + 1) * sizeof(uint64_t);
+                if (c.dict_offsets[0] != 0 || c.dict_offsets[c.dict_size] > _size - c.dict_values) {
+                    throw bad("dictionary of column '" + c.name + "' out of range");
+                }
+                // Every value must end with its NUL before the next one starts.
+                for (size_t k = 0; k < c.dict_size; k++) {
+                    if (c.dict_offsets[k + 1] <= c.dict_offsets[k] ||
+                            _base[c.dict_values + c.dict_offsets[k + 1] - 1] != '\0') {
+                        throw bad("bad offset " + std::to_string(k + 1) + " in the dictionary of column '"
+                                  + c.name + "'");
+                    }
+                }
+                for (size_t r = 0; r < _n_rows; r++) {
+                    if (c.codes[r] >= c.dict_size) {
+                        throw bad("code out of range in column '" + c.name + "'");
+                    }
+                }
+            }
+            switch (c.kind) {
+                case RequestColumn::string_field: _n_string_fields++; break;
+                case RequestColumn::int_field: _n_int_fields++; break;
+                case RequestColumn::float_field: _n_float_fields++; break;
+                case RequestColumn::adgroup_id: _has_svr_call = true; break;
+                default: break;
+            }
+            _columns.push_back(c);
+        }
+
+        // Fields ingested into the `FeatureEngine` must have the types of the fields.
+        for (auto const & c : _columns) {
+            bool ok = true;
+            switch (c.kind) {
+                case RequestColumn::string_field:
+                case RequestColumn::brand_id:
+                case RequestColumn::adgroup_id:
+                    ok = c.type == Type::string;
+                    break;
+                case RequestColumn::int_field:
+                    ok = c.type == Type::int32;
+                    break;
+                case RequestColumn::float_field:
+                case RequestColumn::user_adgroup_svr:
+                case RequestColumn::pacing:
+                    ok = c.type == Type::float64;
+                    break;
+                case RequestColumn::ignored:
+                    break;
+            }
+            if (!ok) {
+                throw bad("column '" + c.name + "' has the wrong type");
+            }
+        }
+    } catch (...) {
+        ::munmap(const_cast<char *>(_base), _size);
+        throw;
+    }
+    ::madvise(const_cast<char *>(_base), _size, MADV_SEQUENTIAL);
+}
+
+
+ReplayFile::~ReplayFile()
+{
+    ::munmap(const_cast<char *>(_base), _size);
+}
+
+
+bool ReplayFile::is_replay_file(std::string const & path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+
+size_t ReplayFile::n_rows() const
+{
+    return _n_rows;
+}
+
+size_t ReplayFile::n_columns() const
+{
+    return _columns.size();
+}
+
+std::string const & ReplayFile::name(size_t column) const
+{
+    return _columns[column].name;
+}
+
+ReplayFile::Type ReplayFile::type(size_t column) const
+{
+    return _columns[column].type;
+}
+
+size_t ReplayFile::find(std::string const & name) const
+{
+    for (size_t i = 0; i < _columns.size(); i++) {
+        if (_columns[i].name == name) {
+            return i;
+        }
+    }
+    return _columns.size();
+}
+
+
+void ReplayFile::_check_type(size_t column, Type type) const
+{
+    if (_columns[column].type != type) {
+        throw SaturnError(mars::make_string(
+                              "column '", _columns[column].name, "' of '", _path, "' has another type"));
+    }
+}
+
+int32_t const * ReplayFile::ints(size_t column) const
+{
+    this->_check_type(column, Type::int32);
+    return static_cast<int32_t const *>(_columns[column].data);
+}
+
+double const * ReplayFile::floats(size_t column) const
+{
+    this->_check_type(column, Type::float64);
+    return static_cast<double const *>(_columns[column].data);
+}
+
+uint32_t const * ReplayFile::codes(size_t column) const
+{
+    this->_check_type(column, Type::string);
+    return _columns[column].codes;
+}
+
+size_t ReplayFile::dict_size(size_t column) const
+{
+    return _columns[column].dict_size;
+}
+
+
+void ReplayFile::fill(size_t row, ModelSet::Request & request) const
+{
+    // String fields point into the mapping. The IDs of the SVR call are copied,
+    // into strings that keep their storage: resize rather than clear.
+    request.string_fields.clear();
+    request.c_str_fields.resize(_n_string_fields);
+    request.int_fields.resize(_n_int_fields);
+    request.float_fields.resize(_n_float_fields);
+    request.svr_calls.resize(_has_svr_call ? 1 : 0);
+
+    size_t n_string = 0, n_int = 0, n_float = 0;
+    for (size_t i = 0; i < _columns.size(); i++) {
+        auto const & c = _columns[i];
+        switch (c.kind) {
+            case RequestColumn::string_field: {
+                auto & f = request.c_str_fields[n_string++];
+                f.first = static_cast<FeatureEngine::StringField>(c.field_idx);
+                f.second = this->string_at(i, row);
+                break;
+            }
+            case RequestColumn::int_field: {
+                auto & f = request.int_fields[n_int++];
+                f.first = static_cast<FeatureEngine::IntField>(c.field_idx);
+                f.second = static_cast<int32_t const *>(c.data)[row];
+                break;
+            }
+            case RequestColumn::float_field: {
+                auto & f = request.float_fields[n_float++];
+                f.first = static_cast<FeatureEngine::FloatField>(c.field_idx);
+                f.second = static_cast<double const *>(c.data)[row];
+                break;
+            }
+            case RequestColumn::brand_id:
+                if (_has_svr_call) {
+                    request.svr_calls[0].brand_id.assign(this->string_at(i, row));
+                }
+                break;
+            case RequestColumn::adgroup_id:
+                request.svr_calls[0].adgroup_id.assign(this->string_at(i, row));
+                break;
+            case RequestColumn::user_adgroup_svr:
+                if (_has_svr_call) {
+                    request.svr_calls[0].user_adgroup_svr = static_cast<double const *>(c.data)[row];
+                }
+                break;
+            case RequestColumn::pacing:
+                if (_has_svr_call) {
+                    request.svr_calls[0].pacing = static_cast<double const *>(c.data)[row];
+                }
+                break;
+            case RequestColumn::ignored:
+                break;
+        }
+    }
+}
+
+
+ReplayWriter::ReplayWriter(std::vector<std::string> const & names, std::vector<ReplayFile::Type> const & types)
+{
+    if (names.size() != types.size()) {
+        throw SaturnError("ReplayWriter: one type per column is expected");
+    }
+    for (size_t i = 0; i < names.size(); i++) {
+        Column c;
+        c.name = names[i];
+        c.type = types[i];
+        _columns.push_back(std::move(c));
+    }
+}
+
+
+ReplayFile::Type ReplayWriter::column_type(std::string const & name)
+{
+    size_t idx = 0;
+    switch (request_column(name, idx)) {
+        case RequestColumn::int_field:
+            return ReplayFile::Type::int32;
+        case RequestColumn::float_field:
+        case RequestColumn::user_adgroup_svr:
+        case RequestColumn::pacing:
+            return ReplayFile::Type::float64;
+        case RequestColumn::ignored:
+            return name.compare(0, 12, "user_extlba/") == 0 ? ReplayFile::Type::float64 : ReplayFile::Type::string;
+        default:
+            return ReplayFile::Type::string;
+    }
+}
+
+
+void ReplayWriter::add_row(std::vector<std::string> const & values)
+{
+    if (values.size() < _columns.size()) {
+        throw SaturnError(mars::make_string(
+                              "expecting ", _columns.size(), " columns; got ", values.size()));
+    }
+    for (auto & c : _columns) {
+        switch (c.type) {
+            case ReplayFile::Type::int32: c.ints.push_back(0); break;
+            case ReplayFile::Type::float64: c.floats.push_back(0.); break;
+            case ReplayFile::Type::string: c.codes.push_back(0); break;
+        }
+    }
+    _n_rows++;
+    for (size_t i = 0; i < _columns.size(); i++) {
+        this->set(i, values[i]);
+    }
+}
+
+
+void ReplayWriter::set(size_t column, std::string const & value)
+{
+    auto & c = _columns[column];
+    try {
+        switch (c.type) {
+            case ReplayFile::Type::int32:
+                c.ints.back() = std::stoi(value);
+                break;
+            case ReplayFile::Type::float64:
+                c.floats.back() = std::stod(value);
+                break;
+            case ReplayFile::Type::string: {
+                auto it = c.dict_index.find(value);
+                if (it == c.dict_index.end()) {
+                    it = c.dict_index.emplace(value, static_cast<uint32_t>(c.dict.size())).first;
+                    c.dict.push_back(value);
+                }
+                c.codes.back() = it->second;
+                break;
+            }
+        }
+    } catch (std::logic_error const & e) {  // from `std::stoi`, `std::stod`
+        throw SaturnError(mars::make_string("bad number '", value, "' in column '", c.name, "': ", e.what()));
+    }
+}
+
+
+size_t ReplayWriter::n_rows() const
+{
+    return _n_rows;
+}
+
+
+void ReplayWriter::write(std::string const & path) const
+{
+    // Lay out the sections first, then write them in order.
+    size_t offset = sizeof(FileHeader);
+    for (auto const & c : _columns) {
+        offset += sizeof(ColumnHeader) + padded(c.name.size());
+    }
+    std::vector<ColumnHeader> headers(_columns.size());
+    for (size_t i = 0; i < _columns.size(); i++) {
+        auto const & c = _columns[i];
+        headers[i].type = static_cast<uint32_t>(c.type);
+        headers[i].name_size = static_cast<uint32_t>(c.name.size());
+        headers[i].data_offset = offset;
+        offset += padded(_n_rows * (c.type == ReplayFile::Type::float64 ? sizeof(double) : sizeof(uint32_t)));
+    }
+    for (size_t i = 0; i < _columns.size(); i++) {
+        auto const & c = _columns[i];
+        headers[i].dict_offset = offset;
+        headers[i].dict_size = c.dict.size();
+        if (c.type == ReplayFile::Type::string) {
+            size_t n = 0;
+            for (auto const & s : c.dict) {
+                n += s.size() + 1;
+            }
+            offset += (c.dict.size() + 1) * sizeof(uint64_t) + padded(n);
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw SaturnError(mars::make_string("cannot write replay file '", path, "'"));
+    }
+    char const zeros[8] = {0};
+    auto pad = [&](size_t n) { out.write(zeros, static_cast<std::streamsize>(padded(n) - n)); };
+
+    FileHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.n_rows = _n_rows;
+    header.n_columns = _columns.size();
+    out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    for (size_t i = 0; i < _columns.size(); i++) {
+        out.write(reinterpret_cast<char const *>(&headers[i]), sizeof(ColumnHeader));
+        out.write(_columns[i].name.data(), static_cast<std::streamsize>(_columns[i].name.size()));
+        pad(_columns[i].name.size());
+    }
+    for (auto const & c : _columns) {
+        char const * data = nullptr;
+        size_t n = 0;
+        switch (c.type) {
+            case ReplayFile::Type::int32:
+                data = reinterpret_cast<char const *>(c.ints.data());
+                n = c.ints.size() * sizeof(int32_t);
+                break;
+            case ReplayFile::Type::float64:
+                data = reinterpret_cast<char const *>(c.floats.data());
+                n = c.floats.size() * sizeof(double);
+                break;
+            case ReplayFile::Type::string:
+                data = reinterpret_cast<char const *>(c.codes.data());
+                n = c.codes.size() * sizeof(uint32_t);
+                break;
+        }
+        out.write(data, static_cast<std::streamsize>(n));
+        pad(n);
+    }
+    for (auto const & c : _columns) {
+        if (c.type != ReplayFile::Type::string) {
+            continue;
+        }
+        uint64_t n = 0;
+        for (auto const & s : c.dict) {
+            out.write(reinterpret_cast<char const *>(&n), sizeof(n));
+            n += s.size() + 1;
+        }
+        out.write(reinterpret_cast<char const *>(&n), sizeof(n));
+        for (auto const & s : c.dict) {
+            out.write(s.c_str(), static_cast<std::streamsize>(s.size() + 1));
+        }
+        pad(n);
+    }
+    if (!out) {
+        throw SaturnError(mars::make_string("cannot write replay file '", path, "'"));
+    }
+}
+
+}  // namespace
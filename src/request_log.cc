@@ -0,0 +1,163 @@
+#include "saturn/common.h"
+#include "saturn/request_log.h"
+#include "mars/utils.h"
+
+#include <algorithm>
+
+namespace saturn
+{
+
+namespace
+{
+
+bool find_field(std::vector<std::string> const & fields, std::string const & name, size_t & idx)
+{
+    auto it = std::find(fields.cbegin(), fields.cend(), name);
+    if (it == fields.cend()) {
+        return false;
+    }
+    idx = static_cast<size_t>(std::distance(fields.cbegin(), it));
+    return true;
+}
+
+}  // namespace
+
+
+void split_line(std::string const & line, char delimiter, std::vector<std::string> & parts)
+{
+    size_t n = 0;
+    size_t start = 0;
+    while (true) {
+        auto pos = line.find(delimiter, start);
+        auto len = (pos == std::string::npos ? line.size() : pos) - start;
+        if (n == parts.size()) {
+            parts.emplace_back();
+        }
+        parts[n++].assign(line, start, len);
+        if (pos == std::string::npos) {
+            break;
+        }
+        start = pos + 1;
+    }
+    parts.resize(n);
+}
+
+
+RequestColumn request_column(std::string const & name, size_t & field_idx)
+{
+    if (find_field(FeatureEngine::STRING_FIELDS, name, field_idx)) {
+        return RequestColumn::string_field;
+    }
+    if (find_field(FeatureEngine::INT_FIELDS, name, field_idx)) {
+        return RequestColumn::int_field;
+    }
+    if (find_field(FeatureEngine::FLOAT_FIELDS, name, field_idx)) {
+        return RequestColumn::float_field;
+    }
+    if (name == "brand_id") {
+        return RequestColumn::brand_id;
+    }
+    if (name == "adgroup_id") {
+        return RequestColumn::adgroup_id;
+    }
+    if (name == "user_adgroup_svr") {
+        return RequestColumn::user_adgroup_svr;
+    }
+    if (name == "pacing") {
+        return RequestColumn::pacing;
+    }
+    return RequestColumn::ignored;
+}
+
+
+RequestParser::RequestParser(std::string const & header, char delimiter)
+    : _delimiter(delimiter)
+{
+    std::string h = header;
+    if (!h.empty() && h.back() == '\r') {
+        h.pop_back();
+    }
+    split_line(h, delimiter, _names);
+
+    for (auto const & name : _names) {
+        size_t idx = 0;
+        auto kind = request_column(name, idx);
+        if (kind == RequestColumn::adgroup_id) {
+            _has_svr_call = true;
+        }
+        _kinds.push_back(kind);
+        _field_idx.push_back(idx);
+    }
+}
+
+
+void RequestParser::parse(std::string const & line, ModelSet::Request & request) const
+{
+    thread_local std::vector<std::string> parts;
+    split_line(line, _delimiter, parts);
+    if (!parts.empty() && !parts.back().empty() && parts.back().back() == '\r') {
+        parts.back().pop_back();
+    }
+    if (parts.size() < _names.size()) {
+        throw SaturnError(mars::make_string(
+                              "expecting ", _names.size(), " columns; got ", parts.size()));
+    }
+
+    request.string_fields.clear();
+    request.c_str_fields.clear();
+    request.int_fields.clear();
+    request.float_fields.clear();
+    request.svr_calls.resize(_has_svr_call ? 1 : 0);
+
+    try {
+        for (size_t i = 0; i < _names.size(); i++) {
+            auto const & value = parts[i];
+            switch (_kinds[i]) {
+                case RequestColumn::string_field:
+                    request.string_fields.emplace_back(static_cast<FeatureEngine::StringField>(_field_idx[i]), value);
+                    break;
+                case RequestColumn::int_field:
+                    request.int_fields.emplace_back(static_cast<FeatureEngine::IntField>(_field_idx[i]), std::stoi(value));
+                    break;
+                case RequestColumn::float_field:
+                    request.float_fields.emplace_back(static_cast<FeatureEngine::FloatField>(_field_idx[i]), std::stod(value));
+                    break;
+                case RequestColumn::brand_id:
+                    if (_has_svr_call) {
+                        request.svr_calls[0].brand_id = value;
+                    }
+                    break;
+                case RequestColumn::adgroup_id:
+                    request.svr_calls[0].adgroup_id = value;
+                    break;
+                case RequestColumn::user_adgroup_svr:
+                    if (_has_svr_call) {
+                        request.svr_calls[0].user_adgroup_svr = std::stod(value);
+                    }
+                    break;
+                case RequestColumn::pacing:
+                    if (_has_svr_call) {
+                        request.svr_calls[0].pacing = std::stod(value);
+                    }
+                    break;
+                case RequestColumn::ignored:
+                    break;
+            }
+        }
+    } catch (std::logic_error const & e) {  // from `std::stoi`, `std::stod`
+        throw SaturnError(mars::make_string("bad number in request line: ", e.what()));
+    }
+}
+
+
+std::vector<std::string> const & RequestParser::columns() const
+{
+    return _names;
+}
+
+char RequestParser::delimiter() const
+{
+    return _delimiter;
+}
+
+}  // namespace
@@ -0,0 +1,73 @@
+#include "saturn/common.h"
+#include "saturn/stats.h"
+
+#include <thread>
+
+namespace saturn
+{
+
+namespace
+{
+
+struct Anchor {
+    uint64_t ticks;
+    std::chrono::steady_clock::time_point time;
+};
+
+// Taken at program start; `stats_ns_per_tick` compares the two clocks against it.
+const Anchor anchor = {stats_ticks(), std::chrono::steady_clock::now()};
+
+}  // namespace
+
+
+double stats_ns_per_tick()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    // The ratio is measured over the life of the program so far, and over at least
+    // `min_span`: a call earlier than that waits out the rest.
+    auto const min_span = std::chrono::milliseconds(10);
+    auto elapsed = std::chrono::steady_clock::now() - anchor.time;
+    if (elapsed < min_span) {
+        std::this_thread::sleep_for(min_span - elapsed);
+    }
+    auto ticks = stats_ticks() - anchor.ticks;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - anchor.time).count();
+    return static_cast<double>(ns) / static_cast<double>(ticks);
+#else
+    return 1.;
+#endif
+}
+
+
+bool stats_enabled()
+{
+#ifdef SATURN_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void StageStats::merge(StageStats const & other)
+{
+    ingest.merge(other.ingest);
+    render.merge(other.render);
+    evaluate.merge(other.evaluate);
+    postprocess.merge(other.postprocess);
+}
+
+
+StageStats StageRecorder::snapshot() const
+{
+    auto scale = stats_ns_per_tick();
+    StageStats stats;
+    _stages[0].snapshot(stats.ingest, scale);
+    _stages[1].snapshot(stats.render, scale);
+    _stages[2].snapshot(stats.evaluate, scale);
+    _stages[3].snapshot(stats.postprocess, scale);
+    return stats;
+}
+
+}  // namespace
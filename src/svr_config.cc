@@ -0,0 +1,194 @@
+#include "saturn/common.h"
+#include "saturn/svr_config.h"
+#include "mars/utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace saturn
+{
+
+namespace
+{
+
+// A private copy of a section of `SvrConfig`, made on the first write; `commit` puts it
+// in place of the section. Sections never written stay shared with earlier versions.
+template <typename Map>
+class SectionEdit
+{
+  public:
+    explicit SectionEdit(std::shared_ptr<Map const> & section)
+        : _section(section)
+    {
+    }
+
+    Map & get()
+    {
+        if (!_copy) {
+            _copy = std::make_shared<Map>(*_section);
+        }
+        return *_copy;
+    }
+
+    void commit()
+    {
+        if (_copy) {
+            _section = std::move(_copy);
+        }
+    }
+
+  private:
+    std::shared_ptr<Map const> & _section;
+    std::shared_ptr<Map> _copy;
+};
+
+}  // namespace
+
+
+std::vector<SvrConfigUpdate> read_config_delta(std::string const & file)
+{
+    std::ifstream in(file);
+    if (!in) {
+        throw SaturnError(mars::make_string("cannot read config delta '", file, "'"));
+    }
+    std::vector<SvrConfigUpdate> updates;
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        std::istringstream fields(line);
+        std::string section;
+        if (!(fields >> section) || section[0] == '#') {
+            continue;
+        }
+        SvrConfigUpdate u;
+        size_t n_values;
+        if (section == "cap") {
+            u.section = SvrConfigUpdate::Section::cap;
+            n_values = 1;
+        } else if (section == "curve") {
+            u.section = SvrConfigUpdate::Section::curve;
+            n_values = 2;
+        } else if (section == "default_svr") {
+            u.section = SvrConfigUpdate::Section::default_svr;
+            n_values = 2;
+        } else if (section == "cutoff") {
+            u.section = SvrConfigUpdate::Section::cutoff;
+            n_values = 1;
+        } else if (section == "brand_default_svr") {
+            u.section = SvrConfigUpdate::Section::brand_default_svr;
+            n_values = 2;
+        } else {
+            throw SaturnError(mars::make_string(file, ":", line_no, ": unknown section `", section, "`"));
+        }
+        std::vector<std::string> values;
+        std::string value;
+        if (!(fields >> u.id)) {
+            throw SaturnError(mars::make_string(file, ":", line_no, ": missing id"));
+        }
+        while (fields >> value) {
+            values.push_back(value);
+        }
+        if (values.size() == 1 && values[0] == "-") {
+            u.remove = true;
+        } else {
+            if (values.size() != n_values) {
+                throw SaturnError(mars::make_string(file, ":", line_no, ": expecting ", n_values,
+                                                    " value(s) or '-' after `", section, " ", u.id, "`"));
+            }
+            for (size_t i = 0; i < n_values; i++) {
+                char * end = nullptr;
+                u.values[i] = std::strtod(values[i].c_str(), &end);
+                if (*end != '\0' || !std::isfinite(u.values[i])) {
+                    throw SaturnError(mars::make_string(file, ":", line_no, ": bad number `", values[i], "`"));
+                }
+            }
+            if (u.section == SvrConfigUpdate::Section::curve && u.values[1] <= 0.) {
+                throw SaturnError(mars::make_string(file, ":", line_no, ": `sigma` must be positive"));
+            }
+        }
+        updates.push_back(u);
+    }
+    return updates;
+}
+
+
+void SvrConfig::apply(std::vector<SvrConfigUpdate> const & updates)
+{
+    version++;
+    SectionEdit<ValueMap> caps(adgroup_multiplier_cap);
+    SectionEdit<PairMap> curves(adgroup_multiplier_curve);
+    SectionEdit<PairMap> default_svrs(adgroup_default_svr);
+    SectionEdit<ValueMap> cutoffs(adgroup_quantile_cutoff);
+    SectionEdit<PairMap> brand_svrs(brand_default_svr);
+    SectionEdit<std::map<std::string, uint64_t>> revisions(adgroup_revision);
+    for (auto const & u : updates) {
+        switch (u.section) {
+            case SvrConfigUpdate::Section::cap:
+                if (u.remove) {
+                    caps.get().erase(u.id);
+                } else {
+                    caps.get()[u.id] = u.values[0];
+                }
+                break;
+            case SvrConfigUpdate::Section::curve:
+                if (u.remove) {
+                    curves.get().erase(u.id);
+                } else {
+                    curves.get()[u.id] = std::make_tuple(u.values[0], u.values[1]);
+                }
+                revisions.get()[u.id] = version;
+                break;
+            case SvrConfigUpdate::Section::default_svr:
+                if (u.remove) {
+                    default_svrs.get().erase(u.id);
+                } else {
+                    default_svrs.get()[u.id] = std::make_tuple(u.values[0], u.values[1]);
+                }
+                revisions.get()[u.id] = version;
+                break;
+            case SvrConfigUpdate::Section::cutoff:
+                if (u.remove) {
+                    cutoffs.get().erase(u.id);
+                } else {
+                    cutoffs.get()[u.id] = std::min(std::max(u.values[0], 0.), 1.);
+                }
+                revisions.get()[u.id] = version;
+                break;
+            case SvrConfigUpdate::Section::brand_default_svr:
+                if (u.remove) {
+                    brand_svrs.get().erase(u.id);
+                } else {
+                    brand_svrs.get()[u.id] = std::make_tuple(u.values[0], u.values[1]);
+                }
+                all_adgroups_revision = version;
+                break;
+        }
+    }
+    caps.commit();
+    curves.commit();
+    default_svrs.commit();
+    cutoffs.commit();
+    brand_svrs.commit();
+    revisions.commit();
+}
+
+
+void SvrConfig::invalidate(PairMap & default_multipliers, uint64_t seen) const
+{
+    if (all_adgroups_revision > seen) {
+        default_multipliers.clear();
+    } else if (!default_multipliers.empty()) {
+        for (auto const & r : *adgroup_revision) {
+            if (r.second > seen) {
+                default_multipliers.erase(r.first);
+            }
+        }
+    }
+}
+
+}  // namespace
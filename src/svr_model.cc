@@ -1,14 +1,22 @@
 #include "saturn/common.h"
 #include "saturn/svr_model.h"
 #include "saturn/feature_engine.h"
+#include "saturn/id_value_file.h"
 #include "saturn/utils.h"
 #include "mars/mars.h"
 #include "mars/numeric.h"
 #include "mars/utils.h"
 
+#include <algorithm>
 #include <any>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
+#include <future>
+#include <memory>
+#include <random>
+#include <sstream>
 #include <tuple>
 
 #include <iostream>
@@ -16,6 +24,18 @@
 namespace saturn
 {
 
+namespace
+{
+
+std::shared_ptr<void> own_catalog(std::unique_ptr<mars::CatalogModel> model)
+{
+    return std::shared_ptr<void>(model.release(), [](void * m) {
+        delete static_cast<mars::CatalogModel *>(m);
+    });
+}
+
+}  // namespace
+
 
 SvrModel::SvrModel(FeatureEngine & feature_engine, std::string path)
     : _feature_engine(feature_engine)
@@ -31,19 +51,22 @@ SvrModel::SvrModel(FeatureEngine & feature_engine, std::string path)
     _path = path;
     _model_id = path;  // TODO: improve this later, adding more info
 
-    auto f = static_cast<mars::FeatureEngine *>(_feature_engine._mars_feature_engine);
+    _composer_id = _feature_engine._add_composer(_path + "/model_config.json");
+    auto config = std::make_shared<Config>();
     mars::JsonReader jreader((_path + "/model_config.json").c_str());
-    jreader.seek("/", "features");
-    _composer_id = f->add_composer(jreader);
 
     if (jreader.has_member("/", "default_multiplier_curve")) {
         jreader.seek("/", "default_multiplier_curve");
-        _default_multiplier_curve_mu = jreader.get_scalar<double>("mu");
-        _default_multiplier_curve_sigma = jreader.get_scalar<double>("sigma");
+        config->default_multiplier_curve_mu = jreader.get_scalar<double>("mu");
+        config->default_multiplier_curve_sigma = jreader.get_scalar<double>("sigma");
     }
 
     if (jreader.has_member("/", "default_multiplier_cap")) {
-        _default_multiplier_cap = jreader.get_scalar<double>("/", "default_multiplier_cap");
+        config->default_multiplier_cap = jreader.get_scalar<double>("/", "default_multiplier_cap");
+    }
+
+    if (jreader.has_member("/", "fallback_multiplier")) {
+        config->fallback_multiplier = jreader.get_scalar<double>("/", "fallback_multiplier");
     }
 
     if (jreader.has_member("/", "adjust_multiplier_curve_for_pacing")) {
@@ -52,20 +75,21 @@ SvrModel::SvrModel(FeatureEngine & feature_engine, std::string path)
             if (z > 2.0) {
                 z = 2.0;
             }
-            _adjust_multiplier_curve_for_pacing = z;
+            config->adjust_multiplier_curve_for_pacing = z;
         }
     }
 
     if (jreader.has_member("/", "default_nonlba_svr")) {
-        _default_nonlba_svr = jreader.get_scalar<double>("/", "default_nonlba_svr");
+        config->default_nonlba_svr = jreader.get_scalar<double>("/", "default_nonlba_svr");
     }
 
     if (jreader.has_member("/", "default_lba_svr")) {
-        _default_lba_svr = jreader.get_scalar<double>("/", "default_lba_svr");
+        config->default_lba_svr = jreader.get_scalar<double>("/", "default_lba_svr");
     }
 
     if (jreader.has_member("/", "adgroup_default_svr")) {
         jreader.seek("/", "adgroup_default_svr");
+        Config::PairMap adgroup_default_svr;
         std::string adgroup_id;
         double nonlba, lba;
         auto n = jreader.get_array_size();
@@ -75,13 +99,15 @@ SvrModel::SvrModel(FeatureEngine & feature_engine, std::string path)
             adgroup_id = jreader.get_scalar<std::string>("adgroup_id");
             nonlba = jreader.get_scalar<double>("nonlba");
             lba = jreader.get_scalar<double>("lba");
-            _adgroup_default_svr.emplace(adgroup_id, std::make_tuple(nonlba, lba));
+            adgroup_default_svr.emplace(adgroup_id, std::make_tuple(nonlba, lba));
             jreader.restore_cursor();
         }
+        config->adgroup_default_svr = std::make_shared<Config::PairMap>(std::move(adgroup_default_svr));
     }
 
     if (jreader.has_member("/", "adgroup_multiplier_curve")) {
         jreader.seek("/", "adgroup_multiplier_curve");
+        Config::PairMap adgroup_multiplier_curve;
         std::string adgroup_id;
         double mu, sigma;
         auto n = jreader.get_array_size();
@@ -91,13 +117,15 @@ SvrModel::SvrModel(FeatureEngine & feature_engine, std::string path)
             adgroup_id = jreader.get_scalar<std::string>("adgroup_id");
             mu = jreader.get_scalar<double>("mu");
             sigma = jreader.get_scalar<double>("sigma");
-            _adgroup_multiplier_curve.emplace(adgroup_id, std::make_tuple(mu, sigma));
+            adgroup_multiplier_curve.emplace(adgroup_id, std::make_tuple(mu, sigma));
             jreader.restore_cursor();
         }
+        config->adgroup_multiplier_curve = std::make_shared<Config::PairMap>(std::move(adgroup_multiplier_curve));
     }
 
     if (jreader.has_member("/", "adgroup_multiplier_cap")) {
         jreader.seek("/", "adgroup_multiplier_cap");
+        Config::ValueMap adgroup_multiplier_cap;
         std::string adgroup_id;
         double cap;
         auto n = jreader.get_array_size();
@@ -106,9 +134,10 @@ SvrModel::SvrModel(FeatureEngine & feature_engine, std::string path)
             jreader.seek_in_array(i);
             adgroup_id = jreader.get_scalar<std::string>("adgroup_id");
             cap = jreader.get_scalar<double>("cap");
-            _adgroup_multiplier_cap.emplace(adgroup_id, cap);
+            adgroup_multiplier_cap.emplace(adgroup_id, cap);
             jreader.restore_cursor();
         }
+        config->adgroup_multiplier_cap = std::make_shared<Config::ValueMap>(std::move(adgroup_multiplier_cap));
     }
 
     mars::AvroReader areader((_path + "/model_object.data").c_str());
@@ -122,6 +151,7 @@ SvrModel::SvrModel(FeatureEngine & feature_engine, std::string path)
 
 
     auto n_models = areader.get_array_size("models");
+    std::set<std::string> adgroup_set;
     areader.save_cursor();
     areader.seek("models");
     for (size_t i = 0; i < n_models; i++) {
@@ -131,9 +161,10 @@ SvrModel::SvrModel(FeatureEngine & feature_engine, std::string path)
 
             areader.restore_cursor();
 //            std::cout<<"adgroup: " << key.substr(0, key.find("/")) << std::endl;
-            _adgroup_set.insert(key.substr(0, key.find("/")));
+            adgroup_set.insert(key.substr(0, key.find("/")));
     }
     areader.restore_cursor();
+    config->adgroup_set = std::make_shared<std::set<std::string>>(std::move(adgroup_set));
 
 
 //	if(_adgroup_set.count("90678665")) {
@@ -141,91 +172,178 @@ SvrModel::SvrModel(FeatureEngine & feature_engine, std::string path)
 //	}
 
 
-    auto model = mars::CatalogModel::from_avro(areader);
-    _mars_model = static_cast<void *>(model.release());
-
-    // Read in brand default svr file. If file does not exist, default values will be used.
-    auto infile_svr = std::ifstream(_path + "/brand_default_svr.txt");
-    if (infile_svr.is_open()) {
-        std::string brand_id;
-        double nonlba_svr, lba_svr;
-        while (infile_svr >> brand_id >> nonlba_svr >> lba_svr) {
-            _brand_default_svr.emplace(brand_id, std::make_tuple(nonlba_svr, lba_svr));
+    config->n_submodels = n_models;
+
+    // The sidecar files are read on another thread while the catalog decodes;
+    // the task writes only `brand_default_svr`, `adgroup_quantile_cutoff` and `load_warnings`.
+    auto heap0 = heap_in_use();
+    auto reading = std::async(std::launch::async, [this, config]() {
+        // Read in brand default svr file. If file does not exist, default values will be used.
+        IdValueFile brands(_path + "/brand_default_svr.txt", 2);
+        Config::PairMap brand_default_svr;
+        for (auto row : brands.sorted_unique_rows()) {
+            brand_default_svr.emplace_hint(brand_default_svr.end(), brands.id(row),
+                                           std::make_tuple(brands.value(row, 0), brands.value(row, 1)));
+        }
+        config->brand_default_svr = std::make_shared<Config::PairMap>(std::move(brand_default_svr));
+        if (brands.n_malformed() > 0) {
+            config->load_warnings.push_back(brands.error_summary());
         }
-        infile_svr.close();
-    }
 
-    // Read in `adgroup_quantile_cutoff.txt` file.
-    // If file does not exist, no adgroup is using the 'placed' strategy.
-    auto infile_quant = std::ifstream(_path + "/adgroup_quantile_cutoff.txt");
-    if (infile_quant.is_open()) {
-        std::string adgroup_id;
-        double cutoff;
-        while (infile_quant >> adgroup_id >> cutoff) {
-            if (cutoff < 0.0) {
-                cutoff = 0.0;
-            } else if (cutoff > 1.0) {
-                cutoff = 1.0;
-            }
-            _adgroup_quantile_cutoff.emplace(adgroup_id, cutoff);
+        // Read in `adgroup_quantile_cutoff.txt` file.
+        // If file does not exist, no adgroup is using the 'placed' strategy.
+        IdValueFile cutoffs(_path + "/adgroup_quantile_cutoff.txt", 1);
+        Config::ValueMap adgroup_quantile_cutoff;
+        for (auto row : cutoffs.sorted_unique_rows()) {
+            double cutoff = std::min(std::max(cutoffs.value(row, 0), 0.0), 1.0);
+            adgroup_quantile_cutoff.emplace_hint(adgroup_quantile_cutoff.end(), cutoffs.id(row), cutoff);
+        }
+        config->adgroup_quantile_cutoff = std::make_shared<Config::ValueMap>(std::move(adgroup_quantile_cutoff));
+        if (cutoffs.n_malformed() > 0) {
+            config->load_warnings.push_back(cutoffs.error_summary());
         }
-        infile_quant.close();
+    });
+    auto model = mars::CatalogModel::from_avro(areader);
+    reading.get();
+    auto heap1 = heap_in_use();
+    // Take out the (estimated) growth from the sidecar files.
+    auto sidecar_bytes = heap_bytes(*config->brand_default_svr) + heap_bytes(*config->adgroup_quantile_cutoff);
+    config->catalog_bytes = heap1 - std::min(heap0 + sidecar_bytes, heap1);
+    _mars_model = own_catalog(std::move(model));
+
+    _config = config;
+    _config_cell = std::make_shared<ConfigCell>();
+    _config_cell->config = _config;
+#ifdef SATURN_BRANCH_COUNTERS
+    _counters = std::make_shared<BranchCounters>(*config->adgroup_set);
+    _counter_shard = _counters->add_shard();
+#else
+    _counters = std::make_shared<BranchCounters>(std::set<std::string>());
+#endif
+#ifdef SATURN_STATS
+    _stats.reset(new StageRecorder());
+#endif
+}
+
+
+SvrModel::SvrModel(SvrModel const & prototype, FeatureEngine & context)
+    : _feature_engine(context),
+      _mars_model(prototype._mars_model),
+      _path(prototype._path),
+      _model_id(prototype._model_id),
+      _composer_id(prototype._composer_id),
+      _eval_cost(prototype._eval_cost),
+      _tracer(prototype._tracer),
+      _counters(prototype._counters),
+      _config(prototype._config),
+      _config_cell(prototype._config_cell),
+      _adgroup_default_multiplier(prototype._adgroup_default_multiplier)
+{
+    if (!context.same_schema(prototype._feature_engine)) {
+        throw SaturnError("`FeatureEngine` of the model to bind has a different schema");
     }
+#ifdef SATURN_BRANCH_COUNTERS
+    _counter_shard = _counters->add_shard();
+#endif
+#ifdef SATURN_STATS
+    _stats.reset(new StageRecorder());
+#endif
 }
 
 
 SvrModel::~SvrModel()
 {
-    delete static_cast<mars::CatalogModel *>(_mars_model);
+    if (_counter_shard) {
+        _counters->remove_shard(_counter_shard);
+    }
+}
+
+
+bool SvrModel::_skip_evaluation(Deadline const & deadline)
+{
+    if (_eval_cost.skip(deadline)) {
+        _degraded = true;
+        _n_degraded++;
+        return true;
+    }
+    return false;
 }
 
 
 double SvrModel::_calc_multiplier(std::string const & adgroup_id, double user_adgroup_svr, double pacing)
 {
+    auto timer = Timer();
+    timer.start();
+
+    SATURN_STATS_TICK(t0);
     _feature_engine.update_field(FeatureEngine::FloatField::kUserExtlba, user_adgroup_svr);
+    if (_tracing) {
+        _trace->t_ingest = stats_ticks();
+    }
 
-    auto f = static_cast<mars::FeatureEngine *>(_feature_engine._mars_feature_engine);
-    auto x = f->render(_composer_id);
+    SATURN_STATS_TICK(t1);
+    auto const & x = _feature_engine._render(_composer_id);
+    if (_tracing) {
+        _trace->t_render = stats_ticks();
+    }
 
-    auto m = static_cast<mars::CatalogModel *>(_mars_model);
+    SATURN_STATS_TICK(t2);
+    auto m = static_cast<mars::CatalogModel *>(_mars_model.get());
 
     std::string const & tag = adgroup_id;
+    if (_tracing) {
+        Trace::copy(_trace->submodel_key, sizeof(_trace->submodel_key), tag);
+    }
 
     auto z = m->run(x, tag);
 
     double quantile = std::any_cast<double>(z);
-
-    auto it_q = _adgroup_quantile_cutoff.find(adgroup_id);
-    if (it_q != _adgroup_quantile_cutoff.end()) {
-        double cutoff = std::get<1>(*it_q);
-        if (quantile >= cutoff) {
-            return 1.0;
-        }
-        return 0.0;
+    if (_tracing) {
+        _trace->t_evaluate = stats_ticks();
     }
+    SATURN_STATS_TICK(t3);
+    SATURN_STATS_RECORD(_stats, ingest, t0, t1);
+    SATURN_STATS_RECORD(_stats, render, t1, t2);
+    SATURN_STATS_RECORD(_stats, evaluate, t2, t3);
 
-    double mu, sigma;
-    auto it = _adgroup_multiplier_curve.find(adgroup_id);
-    if (it != _adgroup_multiplier_curve.end()) {
-        mu = std::get<0>(std::get<1>(*it));
-        sigma = std::get<1>(std::get<1>(*it));
+    timer.stop();
+    _eval_cost.update(timer.microseconds());
+
+    double multiplier;
+    auto it_q = _config->adgroup_quantile_cutoff->find(adgroup_id);
+    if (it_q != _config->adgroup_quantile_cutoff->end()) {
+        double cutoff = std::get<1>(*it_q);
+        multiplier = (quantile >= cutoff) ? 1.0 : 0.0;
+        _branch = Branch::cutoff;
     } else {
-        sigma = _default_multiplier_curve_sigma;
-        if (pacing < 0.0 || _adjust_multiplier_curve_for_pacing == 0.0) {  // No pacing info; use default
-            mu = _default_multiplier_curve_mu;
+        double mu, sigma;
+        _branch = Branch::curve;
+        auto it = _config->adgroup_multiplier_curve->find(adgroup_id);
+        if (it != _config->adgroup_multiplier_curve->end()) {
+            mu = std::get<0>(std::get<1>(*it));
+            sigma = std::get<1>(std::get<1>(*it));
         } else {
-            if (pacing > 1.0) {
-                throw SaturnError(mars::make_string(
-                                      "argument `pacing` must be in {-1, [0, 1]}; got ",
-                                      pacing
-                                  ));
+            sigma = _config->default_multiplier_curve_sigma;
+            if (pacing < 0.0 || _config->adjust_multiplier_curve_for_pacing == 0.0) {  // No pacing info; use default
+                mu = _config->default_multiplier_curve_mu;
+            } else {
+                _branch = Branch::pacing_curve;
+                if (pacing > 1.0) {
+                    throw SaturnError(mars::make_string(
+                                          "argument `pacing` must be in {-1, [0, 1]}; got ",
+                                          pacing
+                                      ));
+                }
+                mu = (pacing * pacing * 2 - 1.) * _config->adjust_multiplier_curve_for_pacing;
+                // Square, stretch to [0, 2], shift to [-1, 1], scale to
+                // [- _adjust_multiplier_curve_for_pacing, _adjust_multiplier_curve_for_pacing]
             }
-            mu = (pacing * pacing * 2 - 1.) * _adjust_multiplier_curve_for_pacing;
-            // Square, stretch to [0, 2], shift to [-1, 1], scale to
-            // [- _adjust_multiplier_curve_for_pacing, _adjust_multiplier_curve_for_pacing]
         }
+        multiplier = mars::logitnormal_cdf(quantile, mu, sigma);
     }
-    return mars::logitnormal_cdf(quantile, mu, sigma);
+    SATURN_STATS_TICK(t4);
+    SATURN_STATS_RECORD(_stats, postprocess, t3, t4);
+    return multiplier;
 }
 
 
@@ -233,8 +351,8 @@ double SvrModel::_get_default_svr(std::string const & brand_id, std::string cons
 {
     assert(flag == 0 || flag == 1);
 
-    auto iit = _adgroup_default_svr.find(adgroup_id);
-    if (iit != _adgroup_default_svr.end()) {
+    auto iit = _config->adgroup_default_svr->find(adgroup_id);
+    if (iit != _config->adgroup_default_svr->end()) {
         auto [nonlba_svr, lba_svr] = std::get<1>(*iit);
         if (flag == 0) {
             return nonlba_svr;
@@ -243,8 +361,8 @@ double SvrModel::_get_default_svr(std::string const & brand_id, std::string cons
         }
     }
 
-    auto it = _brand_default_svr.find(brand_id);
-    if (it != _brand_default_svr.end()) {
+    auto it = _config->brand_default_svr->find(brand_id);
+    if (it != _config->brand_default_svr->end()) {
         auto [nonlba_svr, lba_svr] = std::get<1>(*it);
         if (flag == 0) {
             return nonlba_svr;
@@ -254,33 +372,176 @@ double SvrModel::_get_default_svr(std::string const & brand_id, std::string cons
     }
     
     if (flag == 0) {
-        return _default_nonlba_svr;
+        return _config->default_nonlba_svr;
     } else {
-        return _default_lba_svr;
+        return _config->default_lba_svr;
     }
 }
 
 
 bool SvrModel::has_model(std::string const & key) const
 {
-    auto m = static_cast<mars::CatalogModel *>(_mars_model);
+    auto m = static_cast<mars::CatalogModel *>(_mars_model.get());
     return m->has_model(key.substr(1));
 }
 
 
+bool SvrModel::_has_catalog_key(std::string const & key) const
+{
+    auto m = static_cast<mars::CatalogModel *>(_mars_model.get());
+    return m->has_model(key);
+}
+
+
+std::string const & SvrModel::_catalog_key(std::string const & key)
+{
+    _key.assign(key, 1, std::string::npos);
+    return _key;
+}
+
+
+std::string const & SvrModel::_submodel_key(std::string const & id, std::string const & adgroup_id, Mode mode)
+{
+    _key.assign(adgroup_id);
+    switch(mode) {
+        case SvrModel::Mode::brand:
+            _key.append("/b_"); break;
+        case SvrModel::Mode::location_group:
+            _key.append("/t_"); break;
+    }
+    _key.append(id);
+    return _key;
+}
+
+
 bool SvrModel::has_adgroup(std::string const & adgroup_id) const
 {
-    return _adgroup_set.count(adgroup_id);
+    return _config->adgroup_set->count(adgroup_id);
+}
+
+
+double SvrModel::multiplier_cap(std::string const & adgroup_id) const
+{
+    auto it = _config->adgroup_multiplier_cap->find(adgroup_id);
+    if (it == _config->adgroup_multiplier_cap->end()) {
+        return _config->default_multiplier_cap;
+    }
+    return std::get<1>(*it);
+}
+
+
+double SvrModel::fallback_multiplier() const
+{
+    return _config->fallback_multiplier;
+}
+
+
+double SvrModel::max_multiplier(std::string const & adgroup_id) const
+{
+    return std::max({1., this->multiplier_cap(adgroup_id), _config->fallback_multiplier});
+}
+
+
+size_t SvrModel::apply_config_delta(std::string const & file)
+{
+    // Parse first, so that a bad file changes nothing.
+    auto updates = read_config_delta(file);
+
+    std::lock_guard<std::mutex> lock(_config_cell->update);
+    auto current = std::atomic_load(&_config_cell->config);
+    // Copy on write: readers keep the configuration they hold until their next call.
+    auto config = std::make_shared<Config>(*current);
+    config->apply(updates);
+    auto version = config->version;
+
+    // The configuration first, then its version, which readers check.
+    std::atomic_store(&_config_cell->config, std::shared_ptr<Config const>(config));
+    _config_cell->version.store(version, std::memory_order_release);
+    return updates.size();
+}
+
+
+void SvrModel::refresh_config()
+{
+    this->_refresh_config();
+}
+
+
+uint64_t SvrModel::config_version() const
+{
+    return _config->version;
+}
+
+
+std::vector<std::string> const & SvrModel::load_warnings() const
+{
+    return _config->load_warnings;
+}
+
+
+void SvrModel::_refresh_config()
+{
+    auto const seen = _config->version;
+    if (_config_cell->version.load(std::memory_order_acquire) == seen) {
+        return;
+    }
+    auto config = std::atomic_load(&_config_cell->config);
+    config->invalidate(_adgroup_default_multiplier, seen);
+    _config = std::move(config);
 }
 
 
 enum class Mode{brand, location_group};
 
+double SvrModel::_run_submodel(std::string const & key, double user_adgroup_svr)
+{
+    auto timer = Timer();
+    timer.start();
+
+    SATURN_STATS_TICK(t0);
+    auto m = static_cast<mars::CatalogModel *>(_mars_model.get());
+    _submodel_x[0] = user_adgroup_svr;
+    if (_tracing) {
+        Trace::copy(_trace->submodel_key, sizeof(_trace->submodel_key), key);
+        _trace->t_render = stats_ticks();
+    }
+    double z = std::any_cast<double>(m->run(_submodel_x, key));
+    if (_tracing) {
+        _trace->t_evaluate = stats_ticks();
+    }
+    SATURN_STATS_TICK(t1);
+    SATURN_STATS_RECORD(_stats, evaluate, t0, t1);
+
+    timer.stop();
+    _eval_cost.update(timer.microseconds());
+    return z;
+}
+
+
 int SvrModel::get_multiplier(std::string const & id, std::string const & adgroup_id, double user_adgroup_svr,
-                             Mode mode)
+                             Mode mode, Deadline const & deadline)
 {
+    this->_refresh_config();
+    int code;
+    if (_tracer == nullptr || !_tracer->sample(_n_untraced)) {
+        code = this->_get_multiplier(id, adgroup_id, user_adgroup_svr, mode, deadline);
+    } else {
+        this->_trace_begin(Trace::Method::get_multiplier, id, adgroup_id, user_adgroup_svr);
+        code = this->_get_multiplier(id, adgroup_id, user_adgroup_svr, mode, deadline);
+        this->_trace_end(code, _bid_multiplier);
+    }
+    this->_count_branch(adgroup_id);
+    return code;
+}
+
+
+int SvrModel::_get_multiplier(std::string const & id, std::string const & adgroup_id, double user_adgroup_svr,
+                              Mode mode, Deadline const & deadline)
+{
+    _degraded = false;
     try {
         if (user_adgroup_svr < 0.) {
+            _branch = Branch::negative_svr;
             _svr = user_adgroup_svr;
 //            _bid_multiplier = 0;
             _bid_multiplier = 1;    // tmp
@@ -288,34 +549,33 @@ int SvrModel::get_multiplier(std::string const & id, std::string const & adgroup
         }
 
         if (!has_adgroup(adgroup_id)) {
+            _branch = Branch::no_adgroup;
             _svr = user_adgroup_svr;
 //            _bid_multiplier = -2;
             _bid_multiplier = 1;    // tmp
             return 0;
         }
 
-        std::string keys = "";
-        switch(mode) {
-            case SvrModel::Mode::brand:
-                keys = "/" + adgroup_id + "/b_" + id; break;
-            case SvrModel::Mode::location_group:
-                keys = "/" + adgroup_id + "/t_" + id; break;
-        }
-
-        if (!this->has_model(keys)) {
+        auto const & keys = this->_submodel_key(id, adgroup_id, mode);
+        if (!this->_has_catalog_key(keys)) {
+            _branch = Branch::no_model;
             _svr = user_adgroup_svr;
 //            _bid_multiplier = 0;
             _bid_multiplier = 1;    // tmp
             return 0;
         }
 
-        auto m = static_cast<mars::CatalogModel *>(_mars_model);
-        std::vector<double> x(1);
-        x[0] = user_adgroup_svr;
-        double percent = std::any_cast<double>(m->run(x, keys.substr(1)));
+        if (this->_skip_evaluation(deadline)) {
+            _branch = Branch::fallback;
+            _svr = user_adgroup_svr;
+            _bid_multiplier = _config->fallback_multiplier;
+            return 0;
+        }
+        double percent = this->_run_submodel(keys, user_adgroup_svr);
 
-        auto it_q = _adgroup_quantile_cutoff.find(adgroup_id);
-        if (it_q != _adgroup_quantile_cutoff.end()) {
+        auto it_q = _config->adgroup_quantile_cutoff->find(adgroup_id);
+        if (it_q != _config->adgroup_quantile_cutoff->end()) {
+            _branch = Branch::cutoff;
             double cutoff = std::get<1>(*it_q);
             if (percent >= cutoff) {
                 _bid_multiplier = 1.;
@@ -323,6 +583,7 @@ int SvrModel::get_multiplier(std::string const & id, std::string const & adgroup
                 _bid_multiplier = 0.;
             }
         } else {
+            _branch = Branch::curve;
             _bid_multiplier = percent;
         }
 
@@ -330,6 +591,7 @@ int SvrModel::get_multiplier(std::string const & id, std::string const & adgroup
         return 0;
 
     } catch (std::exception& e) {
+        _branch = Branch::error;
         _message = e.what();
         _bid_multiplier = 0.;
         return 2;
@@ -337,38 +599,59 @@ int SvrModel::get_multiplier(std::string const & id, std::string const & adgroup
 }
 
 
-int SvrModel::get_cpsvr(std::string const & id, std::string const & adgroup_id, double user_adgroup_svr, Mode mode)
+int SvrModel::get_cpsvr(std::string const & id, std::string const & adgroup_id, double user_adgroup_svr, Mode mode,
+                        Deadline const & deadline)
+{
+    this->_refresh_config();
+    int code;
+    if (_tracer == nullptr || !_tracer->sample(_n_untraced)) {
+        code = this->_get_cpsvr(id, adgroup_id, user_adgroup_svr, mode, deadline);
+    } else {
+        this->_trace_begin(Trace::Method::get_cpsvr, id, adgroup_id, user_adgroup_svr);
+        code = this->_get_cpsvr(id, adgroup_id, user_adgroup_svr, mode, deadline);
+        this->_trace_end(code, _cpsvr);
+    }
+    this->_count_branch(adgroup_id);
+    return code;
+}
+
+
+int SvrModel::_get_cpsvr(std::string const & id, std::string const & adgroup_id, double user_adgroup_svr, Mode mode,
+                         Deadline const & deadline)
 {
+    _degraded = false;
     try {
         if (user_adgroup_svr < 0.) {
+            _branch = Branch::negative_svr;
             _cpsvr = 0.;
             _bid_multiplier = 0.;
             _svr = 0;
             return 0;
         }
-        std::string keys = "";
-        switch(mode) {
-            case SvrModel::Mode::brand:
-                keys = "/" + adgroup_id + "/b_" + id; break;
-            case SvrModel::Mode::location_group:
-                keys = "/" + adgroup_id + "/t_" + id; break;
-        }
-        if (!this->has_model(keys)) {
+        auto const & keys = this->_submodel_key(id, adgroup_id, mode);
+        if (!this->_has_catalog_key(keys)) {
+            _branch = Branch::no_model;
             _svr = user_adgroup_svr;
             _cpsvr = user_adgroup_svr;
             _bid_multiplier = user_adgroup_svr;
             return 0;
         }
 
-        auto m = static_cast<mars::CatalogModel *>(_mars_model);
-        std::vector<double> x(1);
-        x[0] = user_adgroup_svr;
-        _cpsvr = std::any_cast<double>(m->run(x, keys.substr(1)));
+        if (this->_skip_evaluation(deadline)) {
+            _branch = Branch::fallback;
+            _svr = user_adgroup_svr;
+            _cpsvr = this->_get_default_svr(id, adgroup_id, 0);
+            _bid_multiplier = _cpsvr;
+            return 0;
+        }
+        _branch = Branch::curve;
+        _cpsvr = this->_run_submodel(keys, user_adgroup_svr);
         _bid_multiplier = _cpsvr;
         _svr = user_adgroup_svr;
         return 0;
 
     } catch (std::exception& e) {
+        _branch = Branch::error;
         _message = e.what();
         _cpsvr = 0.;
         _bid_multiplier = 0.;
@@ -378,7 +661,96 @@ int SvrModel::get_cpsvr(std::string const & id, std::string const & adgroup_id,
 }
 
 
-int SvrModel::run(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr, double pacing)
+void SvrModel::warmup(WarmupOptions const & options, WarmupReport & report)
+{
+    auto timer = Timer();
+    timer.start();
+    this->_refresh_config();
+
+    // Adgroups with a model of their own, as `run` takes them.
+    std::vector<std::string> adgroups;
+    for (auto const & adgroup : *_config->adgroup_set) {
+        if (this->_has_catalog_key(adgroup)) {
+            adgroups.push_back("/" + adgroup);
+        }
+    }
+
+    // `run` caches the default multiplier per adgroup, computed from the default SVR of
+    // the first brand it sees; an adgroup-level default SVR takes precedence over the
+    // brand's, so only for those adgroups is the multiplier known without a brand.
+    auto has_own_default = [this](std::string const & adgroup_id) {
+        return _config->adgroup_default_svr->count(adgroup_id) > 0;
+    };
+
+    size_t n_failed = 0;
+    if (options.precompute_defaults) {
+        for (auto const & adgroup_id : adgroups) {
+            if (!has_own_default(adgroup_id) || _adgroup_default_multiplier.count(adgroup_id) > 0) {
+                continue;
+            }
+            // As `run` does for -1 traffic, with the adgroup's default SVR.
+            try {
+                double nonlba_svr = this->_get_default_svr("", adgroup_id, 0);
+                double nonlba_multiplier = this->_calc_multiplier(adgroup_id, nonlba_svr, -1.);
+                _adgroup_default_multiplier[adgroup_id] = std::make_tuple(nonlba_multiplier, -1.0);
+                report.default_multipliers++;
+            } catch (std::exception const & e) {
+                if (n_failed++ == 0) {
+                    report.notes.push_back(mars::make_string("default multiplier of ", adgroup_id, ": ", e.what()));
+                }
+            }
+        }
+    }
+    if (n_failed > 1) {
+        report.notes.push_back(mars::make_string(n_failed, " default multipliers failed"));
+    }
+
+    if (options.sweep_calls > 0 && !adgroups.empty()) {
+        // SVRs log-uniform over [1e-5, 1e-1], 20% -1 traffic; 30% of calls with a pacing.
+        // -1 traffic only to adgroups with a default SVR of their own, so that the sweep,
+        // which has no brand, does not cache a multiplier that ignores the brand's default SVR.
+        std::mt19937_64 rng(options.seed);
+        std::uniform_int_distribution<size_t> pick(0, adgroups.size() - 1);
+        std::uniform_real_distribution<double> uniform(0., 1.);
+        std::string const brand_id;
+        for (size_t i = 0; i < options.sweep_calls; i++) {
+            auto const & adgroup_id = adgroups[pick(rng)];
+            double svr = (uniform(rng) < 0.2 && has_own_default(adgroup_id)) ? -1.
+                                                                              : std::pow(10., -5. + 4. * uniform(rng));
+            double pacing = (uniform(rng) < 0.3) ? uniform(rng) : -1.;
+            this->_run(brand_id, adgroup_id, svr, pacing, Deadline());
+        }
+        report.sweep_calls += options.sweep_calls;
+        _svr = 0.;
+        _bid_multiplier = 0.;
+        _message = "";
+        _branch = Branch::none;
+    }
+
+    timer.stop();
+    report.seconds += timer.seconds();
+}
+
+
+int SvrModel::run(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr, double pacing,
+                  Deadline const & deadline)
+{
+    this->_refresh_config();
+    int code;
+    if (_tracer == nullptr || !_tracer->sample(_n_untraced)) {
+        code = this->_run(brand_id, adgroup_id, user_adgroup_svr, pacing, deadline);
+    } else {
+        this->_trace_begin(Trace::Method::run, brand_id, adgroup_id, user_adgroup_svr);
+        code = this->_run(brand_id, adgroup_id, user_adgroup_svr, pacing, deadline);
+        this->_trace_end(code, _bid_multiplier);
+    }
+    this->_count_branch(adgroup_id);
+    return code;
+}
+
+
+int SvrModel::_run(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr,
+                   double pacing, Deadline const & deadline)
 {
     // When `user_adgroup_svr` is -1, this function provides a brand-aware
     // appropriately small multiplier.
@@ -395,8 +767,10 @@ int SvrModel::run(std::string const & brand_id, std::string const & adgroup_id,
     try {
         _svr = user_adgroup_svr;
         _message = "";
+        _degraded = false;
 
-        if (!this->has_model(adgroup_id)) {
+        if (!this->_has_catalog_key(this->_catalog_key(adgroup_id))) {
+            _branch = Branch::no_model;
             _bid_multiplier = 1.0;
             return 0;
         }
@@ -412,6 +786,11 @@ int SvrModel::run(std::string const & brand_id, std::string const & adgroup_id,
 
             auto it = _adgroup_default_multiplier.find(adgroup_id);
             if (it == _adgroup_default_multiplier.end()) {
+                if (this->_skip_evaluation(deadline)) {
+                    _branch = Branch::fallback;
+                    _bid_multiplier = _config->fallback_multiplier;
+                    return 0;
+                }
                 double nonlba_svr = this->_get_default_svr(brand_id, adgroup_id, 0);
                 double nonlba_multiplier = this->_calc_multiplier(adgroup_id, nonlba_svr, pacing);
                 // TODO: not quite right here if `pacing` is provided, in which case
@@ -419,7 +798,9 @@ int SvrModel::run(std::string const & brand_id, std::string const & adgroup_id,
 
                 _adgroup_default_multiplier[adgroup_id] = std::make_tuple(nonlba_multiplier, -1.0);
                 _bid_multiplier = nonlba_multiplier;
+                _branch = Branch::default_computed;
             } else {
+                _branch = Branch::default_cached;
                 auto [nonlba_multiplier, lba_multiplier] = std::get<1>(*it);
                 if (nonlba_multiplier < 0.0) {
 
@@ -436,24 +817,68 @@ int SvrModel::run(std::string const & brand_id, std::string const & adgroup_id,
                 _bid_multiplier = nonlba_multiplier;
             }
         } else {
+            if (this->_skip_evaluation(deadline)) {
+                _branch = Branch::fallback;
+                _bid_multiplier = _config->fallback_multiplier;
+                return 0;
+            }
             _bid_multiplier = this->_calc_multiplier(adgroup_id, user_adgroup_svr, pacing);
         }
 
-        auto it = _adgroup_multiplier_cap.find(adgroup_id);
-        if (it == _adgroup_multiplier_cap.end()) {
-            _bid_multiplier *= _default_multiplier_cap;
+        _bid_multiplier *= this->multiplier_cap(adgroup_id);
+        return 0;
+
+    } catch (std::exception& e) {
+        _branch = Branch::error;
+        _message = e.what();
+        _bid_multiplier = 0.;
+        return 2;
+    }
+}
+
+int SvrModel::run_cheap(std::string const & brand_id, std::string const & adgroup_id, double user_adgroup_svr)
+{
+    (void)brand_id;
+    this->_refresh_config();
+    int code = this->_run_cheap(adgroup_id, user_adgroup_svr);
+    this->_count_branch(adgroup_id);
+    return code;
+}
+
+
+int SvrModel::_run_cheap(std::string const & adgroup_id, double user_adgroup_svr)
+{
+    try {
+        _svr = user_adgroup_svr;
+        _message = "";
+        _degraded = false;
+
+        if (!this->_has_catalog_key(this->_catalog_key(adgroup_id))) {
+            _branch = Branch::no_model;
+            _bid_multiplier = 1.0;
+            return 0;
+        }
+
+        _branch = Branch::fallback;
+        _degraded = true;
+        _n_degraded++;
+        auto it = _adgroup_default_multiplier.find(adgroup_id);
+        if (it != _adgroup_default_multiplier.end() && std::get<0>(std::get<1>(*it)) >= 0.0) {
+            _bid_multiplier = std::get<0>(std::get<1>(*it)) * this->multiplier_cap(adgroup_id);
         } else {
-            _bid_multiplier *= std::get<1>(*it);
+            _bid_multiplier = _config->fallback_multiplier;
         }
         return 0;
 
     } catch (std::exception& e) {
+        _branch = Branch::error;
         _message = e.what();
         _bid_multiplier = 0.;
         return 2;
     }
 }
 
+
 double SvrModel::svr() const
 {
     return _svr;
@@ -474,4 +899,127 @@ std::string const & SvrModel::message() const
     return _message;
 }
 
+bool SvrModel::degraded() const
+{
+    return _degraded;
+}
+
+size_t SvrModel::n_degraded() const
+{
+    return _n_degraded;
+}
+
+StageStats SvrModel::stats() const
+{
+    return _stats ? _stats->snapshot() : StageStats();
+}
+
+SvrModel::Branch SvrModel::branch() const
+{
+    return _branch;
+}
+
+
+char const * SvrModel::branch_name(Branch branch)
+{
+    switch (branch) {
+        case Branch::none: return "none";
+        case Branch::no_model: return "no_model";
+        case Branch::no_adgroup: return "no_adgroup";
+        case Branch::negative_svr: return "negative_svr";
+        case Branch::default_cached: return "default_cached";
+        case Branch::default_computed: return "default_computed";
+        case Branch::cutoff: return "cutoff";
+        case Branch::curve: return "curve";
+        case Branch::pacing_curve: return "pacing_curve";
+        case Branch::fallback: return "fallback";
+        case Branch::error: return "error";
+    }
+    return "unknown";
+}
+
+
+void SvrModel::set_tracer(Tracer * tracer)
+{
+    _tracer = tracer;
+    _n_untraced = 0;
+}
+
+
+BranchCounters const & SvrModel::branch_counters() const
+{
+    return *_counters;
+}
+
+
+MemoryUsage SvrModel::memory_usage() const
+{
+    auto const & c = *_config;
+    MemoryUsage usage;
+    usage.add_heap_growth("catalog", c.n_submodels, c.catalog_bytes);
+    usage.add("adgroup_multiplier_curve", c.adgroup_multiplier_curve->size(), heap_bytes(*c.adgroup_multiplier_curve));
+    usage.add("adgroup_multiplier_cap", c.adgroup_multiplier_cap->size(), heap_bytes(*c.adgroup_multiplier_cap));
+    usage.add("adgroup_quantile_cutoff", c.adgroup_quantile_cutoff->size(), heap_bytes(*c.adgroup_quantile_cutoff));
+    usage.add("adgroup_default_svr", c.adgroup_default_svr->size(), heap_bytes(*c.adgroup_default_svr));
+    usage.add("brand_default_svr", c.brand_default_svr->size(), heap_bytes(*c.brand_default_svr));
+    usage.add("adgroup_set", c.adgroup_set->size(), heap_bytes(*c.adgroup_set));
+    usage.add("adgroup_revision", c.adgroup_revision->size(), heap_bytes(*c.adgroup_revision));
+    usage.add("adgroup_default_multiplier", _adgroup_default_multiplier.size(),
+              heap_bytes(_adgroup_default_multiplier));
+    usage.add("branch_counters", _counters->n_adgroups(), _counters->memory_bytes());
+    return usage;
+}
+
+
+void SvrModel::_count_branch(std::string const & adgroup_id)
+{
+#ifdef SATURN_BRANCH_COUNTERS
+    BranchCounts::Slot slot;
+    switch (_branch) {
+        case Branch::no_model: slot = BranchCounts::no_model; break;
+        case Branch::no_adgroup: slot = BranchCounts::no_adgroup; break;
+        case Branch::negative_svr:
+        case Branch::default_cached:
+        case Branch::default_computed: slot = BranchCounts::default_multiplier; break;
+        case Branch::cutoff: slot = BranchCounts::cutoff; break;
+        case Branch::curve: slot = BranchCounts::curve; break;
+        case Branch::pacing_curve: slot = BranchCounts::pacing_curve; break;
+        case Branch::fallback: slot = BranchCounts::fallback; break;
+        case Branch::error: slot = BranchCounts::error; break;
+        default: return;
+    }
+    _counter_shard->count(_counters->index(adgroup_id), slot);
+#else
+    (void)adgroup_id;
+#endif
+}
+
+
+void SvrModel::_trace_begin(Trace::Method method, std::string const & brand_id, std::string const & adgroup_id,
+                            double user_adgroup_svr)
+{
+    if (!_trace) {
+        _trace.reset(new Trace());
+    }
+    *_trace = Trace();
+    _trace->method = method;
+    _trace->user_adgroup_svr = user_adgroup_svr;
+    Trace::copy(_trace->brand_id, sizeof(_trace->brand_id), brand_id);
+    Trace::copy(_trace->adgroup_id, sizeof(_trace->adgroup_id), adgroup_id);
+    _branch = Branch::none;
+    _tracing = true;
+    _trace->t_start = stats_ticks();
+}
+
+
+void SvrModel::_trace_end(int code, double result)
+{
+    _trace->t_end = stats_ticks();
+    _tracing = false;
+    _trace->code = code;
+    _trace->branch = static_cast<int>(_branch);
+    _trace->result = result;
+    _tracer->submit(*_trace);
+}
+
 }  // namespace
@@ -0,0 +1,213 @@
+#include "saturn/common.h"
+#include "saturn/trace.h"
+#include "saturn/stats.h"
+#include "saturn/svr_model.h"
+#include "mars/utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace saturn
+{
+
+namespace
+{
+
+char const * method_name(Trace::Method method)
+{
+    switch (method) {
+        case Trace::Method::run: return "run";
+        case Trace::Method::get_multiplier: return "get_multiplier";
+        case Trace::Method::get_cpsvr: return "get_cpsvr";
+    }
+    return "unknown";
+}
+
+
+// Nanoseconds from `t0` to `t1`; -1 if either stage did not run.
+long long stage_ns(uint64_t t0, uint64_t t1, double ns_per_tick)
+{
+    if (t0 == 0 || t1 == 0 || t1 < t0) {
+        return -1;
+    }
+    return static_cast<long long>(static_cast<double>(t1 - t0) * ns_per_tick + 0.5);
+}
+
+}  // namespace
+
+
+void Trace::copy(char * dest, size_t size, std::string const & src)
+{
+    auto n = std::min(src.size(), size - 1);
+    std::memcpy(dest, src.data(), n);
+    dest[n] = '\0';
+}
+
+
+TraceBuffer::TraceBuffer(size_t capacity)
+{
+    size_t n = 2;
+    while (n < capacity) {
+        n <<= 1;
+    }
+    _slots.reset(new Slot[n]);
+    for (size_t i = 0; i < n; i++) {
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _mask = n - 1;
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+}
+
+
+bool TraceBuffer::push(Trace const & trace)
+{
+    auto pos = _head.load(std::memory_order_relaxed);
+    Slot * slot;
+    while (true) {
+        slot = &_slots[pos & _mask];
+        auto seq = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // full
+        } else {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+    slot->trace = trace;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+
+bool TraceBuffer::pop(Trace & trace)
+{
+    auto pos = _tail.load(std::memory_order_relaxed);
+    Slot * slot;
+    while (true) {
+        slot = &_slots[pos & _mask];
+        auto seq = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+        if (diff == 0) {
+            if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // empty
+        } else {
+            pos = _tail.load(std::memory_order_relaxed);
+        }
+    }
+    trace = slot->trace;
+    slot->sequence.store(pos + _mask + 1, std::memory_order_release);
+    return true;
+}
+
+
+size_t TraceBuffer::capacity() const
+{
+    return _mask + 1;
+}
+
+
+Tracer::Tracer(std::string const & path, size_t sample_every, size_t capacity)
+    : _sample_every(sample_every == 0 ? 1 : sample_every),
+      _buffer(new TraceBuffer(capacity)),
+      _file(path),
+      _n_written(0),
+      _n_dropped(0)
+{
+    if (!_file.is_open()) {
+        throw SaturnError(mars::make_string("can not open trace file `", path, "`"));
+    }
+    _file << "method\tbrand_id\tadgroup_id\tsubmodel_key\tbranch\tcode\tuser_adgroup_svr\tresult"
+          << "\tingest_ns\trender_ns\tevaluate_ns\tpostprocess_ns\ttotal_ns\n";
+    _drainer = std::thread(&Tracer::_drain, this);
+}
+
+
+Tracer::~Tracer()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_one();
+    _drainer.join();
+}
+
+
+void Tracer::submit(Trace const & trace)
+{
+    if (_buffer->push(trace)) {
+        // No notification: the drainer polls, so producers never touch the mutex.
+        return;
+    }
+    _n_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+size_t Tracer::n_written() const
+{
+    return _n_written.load(std::memory_order_relaxed);
+}
+
+
+size_t Tracer::n_dropped() const
+{
+    return _n_dropped.load(std::memory_order_relaxed);
+}
+
+
+void Tracer::_drain()
+{
+    Trace trace;
+    bool stop = false;
+    while (true) {
+        auto ns_per_tick = stats_ns_per_tick();
+        size_t n = 0;
+        while (_buffer->pop(trace)) {
+            this->_write(trace, ns_per_tick);
+            n++;
+        }
+        if (n > 0) {
+            _file.flush();
+            _n_written.fetch_add(n, std::memory_order_relaxed);
+        }
+        if (stop) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake.wait_for(lock, std::chrono::milliseconds(10), [this] { return _stop; });
+        stop = _stop;  // one more pass to write what came in before the stop
+    }
+}
+
+
+void Tracer::_write(Trace const & trace, double ns_per_tick)
+{
+    // Stages as in `StageStats`: ingest, render, evaluate, postprocess.
+    // `get_multiplier` and `get_cpsvr` have no ingest stage; their render
+    // stage is the time before the submodel runs.
+    uint64_t t_before_render = trace.t_ingest ? trace.t_ingest : trace.t_start;
+    _file << method_name(trace.method) << '\t'
+          << trace.brand_id << '\t'
+          << trace.adgroup_id << '\t'
+          << trace.submodel_key << '\t'
+          << SvrModel::branch_name(static_cast<SvrModel::Branch>(trace.branch)) << '\t'
+          << trace.code << '\t'
+          << trace.user_adgroup_svr << '\t'
+          << trace.result << '\t'
+          << stage_ns(trace.t_start, trace.t_ingest, ns_per_tick) << '\t'
+          << stage_ns(t_before_render, trace.t_render, ns_per_tick) << '\t'
+          << stage_ns(trace.t_render, trace.t_evaluate, ns_per_tick) << '\t'
+          << stage_ns(trace.t_evaluate, trace.t_end, ns_per_tick) << '\t'
+          << stage_ns(trace.t_start, trace.t_end, ns_per_tick) << '\n';
+}
+
+}  // namespace
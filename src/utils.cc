@@ -1,5 +1,7 @@
 #include "saturn/utils.h"
 
+#include <limits>
+
 namespace saturn
 {
 void Timer::start()
@@ -36,4 +38,75 @@ double Timer::seconds() const
     return this->microseconds() / 1000000.;
 }
 
+
+Deadline::Deadline()
+{
+}
+
+Deadline Deadline::after_microseconds(long us)
+{
+    Deadline d;
+    d._set = true;
+    d._t = clock::now() + std::chrono::microseconds(us);
+    return d;
+}
+
+bool Deadline::is_set() const
+{
+    return _set;
+}
+
+bool Deadline::expired() const
+{
+    return _set && clock::now() >= _t;
+}
+
+bool Deadline::would_exceed(double expected_us) const
+{
+    if (!_set) {
+        return false;
+    }
+    return clock::now() + std::chrono::microseconds(static_cast<long>(expected_us)) > _t;
+}
+
+long Deadline::remaining_microseconds() const
+{
+    if (!_set) {
+        return std::numeric_limits<long>::max();
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(_t - clock::now()).count();
+}
+
+
+double StageCost::microseconds() const
+{
+    return _us;
+}
+
+void StageCost::update(long us)
+{
+    if (_probing) {
+        _us = us;
+        _probing = false;
+        return;
+    }
+    // Weight 1/8 on the newest observation.
+    _us += (us - _us) * 0.125;
+}
+
+bool StageCost::skip(Deadline const & deadline)
+{
+    if (!deadline.would_exceed(_us)) {
+        _n_skipped = 0;
+        return false;
+    }
+    if (++_n_skipped >= probe_interval) {
+        _n_skipped = 0;
+        _probing = true;
+        return false;
+    }
+    _us *= 0.875;
+    return true;
+}
+
 }    // namespace
\ No newline at end of file
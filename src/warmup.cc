@@ -0,0 +1,151 @@
+#include "saturn/common.h"
+#include "saturn/warmup.h"
+#include "saturn/memory.h"
+#include "saturn/utils.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace saturn
+{
+
+namespace
+{
+
+struct Region {
+    uintptr_t begin;
+    uintptr_t end;
+};
+
+
+// The heap and the private anonymous read-write mappings, from /proc/self/maps.
+std::vector<Region> model_regions()
+{
+    std::vector<Region> regions;
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        // begin-end perms offset dev inode [path]
+        std::istringstream fields(line);
+        std::string range, perms, offset, dev, path;
+        unsigned long inode = 0;
+        if (!(fields >> range >> perms >> offset >> dev >> inode)) {
+            continue;
+        }
+        fields >> path;
+        if (perms.size() < 4 || perms[0] != 'r' || perms[1] != 'w' || perms[3] != 'p') {
+            continue;
+        }
+        if (!(path.empty() || path == "[heap]")) {
+            continue;  // files, stacks, vdso and the like
+        }
+        auto dash = range.find('-');
+        if (dash == std::string::npos) {
+            continue;
+        }
+        Region r;
+        r.begin = static_cast<uintptr_t>(std::stoull(range.substr(0, dash), nullptr, 16));
+        r.end = static_cast<uintptr_t>(std::stoull(range.substr(dash + 1), nullptr, 16));
+        if (r.end > r.begin) {
+            regions.push_back(r);
+        }
+    }
+    return regions;
+}
+
+}  // namespace
+
+
+void warm_memory(WarmupOptions const & options, WarmupReport & report)
+{
+    auto timer = Timer();
+    timer.start();
+    report.rss_before = resident_bytes();
+
+    auto regions = model_regions();
+    if (regions.empty()) {
+        report.notes.push_back("memory: no mappings found (/proc/self/maps unreadable?)");
+    }
+    auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    bool lock = options.lock;
+    bool huge_pages = options.huge_pages;
+#ifndef MADV_HUGEPAGE
+    if (huge_pages) {
+        report.notes.push_back("huge pages: MADV_HUGEPAGE not available");
+        huge_pages = false;
+    }
+#endif
+
+    for (auto const & r : regions) {
+        auto * p = reinterpret_cast<char *>(r.begin);
+        size_t n = r.end - r.begin;
+        report.regions++;
+
+#ifdef MADV_HUGEPAGE
+        // Before faulting in, so that the faults can take huge pages.
+        if (huge_pages) {
+            if (madvise(p, n, MADV_HUGEPAGE) == 0) {
+                report.huge_page_bytes += n;
+            } else {
+                report.notes.push_back(std::string("huge pages: madvise failed: ") + std::strerror(errno));
+                huge_pages = false;
+            }
+        }
+#endif
+
+        if (options.prefault) {
+            bool done = false;
+#ifdef MADV_POPULATE_READ
+            if (madvise(p, n, MADV_POPULATE_READ) == 0) {
+                done = true;
+            }
+#endif
+            if (!done) {
+                volatile char sink = 0;
+                for (size_t i = 0; i < n; i += page) {
+                    sink = sink + p[i];
+                }
+                (void)sink;
+            }
+            report.prefaulted_bytes += n;
+        }
+
+        if (lock) {
+            if (mlock(p, n) == 0) {
+                report.locked_bytes += n;
+            } else {
+                report.notes.push_back(std::string("lock: mlock failed, not locking: ") + std::strerror(errno));
+                lock = false;
+            }
+        }
+    }
+
+    report.rss_after = resident_bytes();
+    timer.stop();
+    report.seconds += timer.seconds();
+}
+
+
+void WarmupReport::write(std::ostream & out) const
+{
+    out << "seconds               " << seconds << '\n'
+        << "regions               " << regions << '\n'
+        << "prefaulted_bytes      " << prefaulted_bytes << '\n'
+        << "locked_bytes          " << locked_bytes << '\n'
+        << "huge_page_bytes       " << huge_page_bytes << '\n'
+        << "rss_before            " << rss_before << '\n'
+        << "rss_after             " << rss_after << '\n'
+        << "default_multipliers   " << default_multipliers << '\n'
+        << "sweep_calls           " << sweep_calls << '\n';
+    for (auto const & note : notes) {
+        out << "note: " << note << '\n';
+    }
+}
+
+}  // namespace
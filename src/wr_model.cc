@@ -6,9 +6,12 @@
 #include "mars/numeric.h"
 #include "mars/utils.h"
 
+#include <algorithm>
 #include <any>
 #include <cassert>
 #include <fstream>
+#include <future>
+#include <memory>
 #include <tuple>
 
 #include <iostream>
@@ -31,11 +34,55 @@ WrModel::WrModel(FeatureEngine & feature_engine, std::string path)
     _path = path;
     _model_id = path;  // TODO: improve this later, adding more info
 
-    auto f = static_cast<mars::FeatureEngine *>(_feature_engine._mars_feature_engine);
+    _composer_id = _feature_engine._add_composer(_path + "/model_config.json");
+
     mars::JsonReader jreader((_path + "/model_config.json").c_str());
-    jreader.seek("/", "features");
-    _composer_id = f->add_composer(jreader);
+    if (jreader.has_member("/", "prior_win_rate")) {
+        _prior_win_prob = jreader.get_scalar<double>("/", "prior_win_rate");
+    }
+    if (jreader.has_member("/", "prior_delivery_rate")) {
+        _prior_dev_prob = jreader.get_scalar<double>("/", "prior_delivery_rate");
+    }
+
+    this->_load_mars_models();
+#ifdef SATURN_STATS
+    _stats.reset(new StageRecorder());
+#endif
+
+    // Read in `adgroup_quantile_cutoff.txt` file.
+    // If file does not exist, no adgroup is using the 'placed' strategy.
+
+}
+
+
+WrModel::WrModel(WrModel const & prototype, FeatureEngine & context)
+    : _feature_engine(context),
+      _mars_model(prototype._mars_model),
+      _deliver_model(prototype._deliver_model),
+      _mars_models_bytes(prototype._mars_models_bytes),
+      _prior_win_prob(prototype._prior_win_prob),
+      _prior_dev_prob(prototype._prior_dev_prob),
+      _eval_cost(prototype._eval_cost),
+      _path(prototype._path),
+      _model_id(prototype._model_id),
+      _composer_id(prototype._composer_id)
+{
+    if (!context.same_schema(prototype._feature_engine)) {
+        throw SaturnError("`FeatureEngine` of the model to bind has a different schema");
+    }
+#ifdef SATURN_STATS
+    _stats.reset(new StageRecorder());
+#endif
+}
+
+
+WrModel::~WrModel()
+{
+}
+
 
+void WrModel::_load_mars_models()
+{
     mars::AvroReader areader((_path + "/wr_model_object.data").c_str());
     mars::AvroReader areader1((_path + "/delivery_model_object.data").c_str());
     auto const class_name = areader.get_scalar<std::string>("class_name");
@@ -50,26 +97,26 @@ WrModel::WrModel(FeatureEngine & feature_engine, std::string path)
         "expecting a `ChainModel` for `DeliveryModel`; get a `", class_name, "`"));
     }
 
+    // The two models are independent; decode the delivery model on another thread.
+    auto heap0 = heap_in_use();
+    auto decoding = std::async(std::launch::async, [&areader1]() {
+        return mars::ChainModel::from_avro(areader1);
+    });
     auto model = mars::ChainModel::from_avro(areader);
-    auto model1 = mars::ChainModel::from_avro(areader1);
-    _mars_model = static_cast<void *>(model.release());
-    _deliver_model = static_cast<void *>(model1.release());
-
-    // Read in `adgroup_quantile_cutoff.txt` file.
-    // If file does not exist, no adgroup is using the 'placed' strategy.
-
-}
-
-
-WrModel::~WrModel()
-{
-    delete static_cast<mars::ChainModel *>(_mars_model);
-    delete static_cast<mars::ChainModel *>(_deliver_model);
+    auto model1 = decoding.get();
+    auto heap1 = heap_in_use();
+    _mars_models_bytes = heap1 - std::min(heap0, heap1);
+    auto deleter = [](void * m) {
+        delete static_cast<mars::ChainModel *>(m);
+    };
+    _mars_model = std::shared_ptr<void>(model.release(), deleter);
+    _deliver_model = std::shared_ptr<void>(model1.release(), deleter);
 }
 
 
-double WrModel::get_prob(std::vector<std::string> input)
+double WrModel::get_prob(std::vector<std::string> const & input)
 {
+    SATURN_STATS_TICK(t0);
     _feature_engine.update_field(FeatureEngine::StringField::wr_Uidtype, input[0]);
     _feature_engine.update_field(FeatureEngine::StringField::wr_Devicetype, input[1]);
     _feature_engine.update_field(FeatureEngine::StringField::wr_Os, input[2]);
@@ -84,22 +131,52 @@ double WrModel::get_prob(std::vector<std::string> input)
     _feature_engine.update_field(FeatureEngine::IntField::wr_Hour, std::stoi(input[11]));
     _feature_engine.update_field(FeatureEngine::IntField::wr_Sladjustedconfidence, std::stoi(input[12]));
     _feature_engine.update_field(FeatureEngine::IntField::wr_Weekday, std::stoi(input[13]));
+    SATURN_STATS_TICK(t1);
+    SATURN_STATS_RECORD(_stats, ingest, t0, t1);
+
+    this->get_prob();
+    return 0;
+}
+
+
+double WrModel::get_prob()
+{
+    return this->get_prob(Deadline());
+}
+
+
+double WrModel::get_prob(Deadline const & deadline)
+{
+    _degraded = false;
+    if (_eval_cost.skip(deadline)) {
+        _degraded = true;
+        _n_degraded++;
+        _win_prob = _prior_win_prob;
+        _dev_prob = _prior_dev_prob;
+        _final_prob = _win_prob * _dev_prob;
+        return _final_prob;
+    }
+
+    auto timer = Timer();
+    timer.start();
 
-    auto f = static_cast<mars::FeatureEngine *>(_feature_engine._mars_feature_engine);
-    auto x = f->render(_composer_id);
+    SATURN_STATS_TICK(t0);
+    auto const & x = _feature_engine._render(_composer_id);
+    SATURN_STATS_TICK(t1);
 
 //    std::cout << "  feature: " << std::endl;
 //    for (auto i = x.begin(); i != x.end(); ++i){
 //        std::cout << *i << ' ';
 //    }
 //    std::cout << std::endl;
-    auto m = static_cast<mars::ChainModel *>(_mars_model);
+    auto m = static_cast<mars::ChainModel *>(_mars_model.get());
 
     auto z = m->predict_one(x);
 
-    auto m1 = static_cast<mars::ChainModel *>(_deliver_model);
+    auto m1 = static_cast<mars::ChainModel *>(_deliver_model.get());
 
     auto z1 = m1->predict_one(x);
+    SATURN_STATS_TICK(t2);
 //    std::cout << typeid(z).name() << std::endl;
     // Version 0:
     //   CatalogModel contains ChainModel's.
@@ -120,7 +197,34 @@ double WrModel::get_prob(std::vector<std::string> input)
     _win_prob = prob;
     _dev_prob = dev_prob;
     _final_prob = prob * dev_prob;
-    return 0;
+    SATURN_STATS_TICK(t3);
+    SATURN_STATS_RECORD(_stats, render, t0, t1);
+    SATURN_STATS_RECORD(_stats, evaluate, t1, t2);
+    SATURN_STATS_RECORD(_stats, postprocess, t2, t3);
+
+    timer.stop();
+    _eval_cost.update(timer.microseconds());
+    return _final_prob;
+}
+
+
+double WrModel::get_win_prob()
+{
+    SATURN_STATS_TICK(t0);
+    auto const & x = _feature_engine._render(_composer_id);
+    SATURN_STATS_TICK(t1);
+    auto m = static_cast<mars::ChainModel *>(_mars_model.get());
+    auto z = m->predict_one(x);
+    SATURN_STATS_TICK(t2);
+    SATURN_STATS_RECORD(_stats, render, t0, t1);
+    SATURN_STATS_RECORD(_stats, evaluate, t1, t2);
+
+    _degraded = true;
+    _n_degraded++;
+    _win_prob = std::any_cast<double>(std::get<0>(z));
+    _dev_prob = _prior_dev_prob;
+    _final_prob = _win_prob * _dev_prob;
+    return _final_prob;
 }
 
 
@@ -143,4 +247,26 @@ double WrModel::dev_prob() const
 {
     return _dev_prob;
 }
+
+bool WrModel::degraded() const
+{
+    return _degraded;
+}
+
+size_t WrModel::n_degraded() const
+{
+    return _n_degraded;
+}
+
+MemoryUsage WrModel::memory_usage() const
+{
+    MemoryUsage usage;
+    usage.add_heap_growth("win_rate_and_delivery_models", 2, _mars_models_bytes);
+    return usage;
+}
+
+StageStats WrModel::stats() const
+{
+    return _stats ? _stats->snapshot() : StageStats();
+}
 }  // namespace
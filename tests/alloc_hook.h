@@ -0,0 +1,187 @@
+// Counting of heap allocations for test and benchmark programs.
+//
+// Replaces the global `operator new` / `operator delete` with versions that
+// count calls, program-wide and per thread, and otherwise use `malloc` / `free`.
+// The plain, array and `nothrow` forms are replaced, and the aligned ones
+// (`std::align_val_t`) when compiled as C++17, which the library's aligned types need.
+// Include this file in exactly one translation unit of a program.
+
+#ifndef _SATURN_TESTS_ALLOC_HOOK_H_
+#define _SATURN_TESTS_ALLOC_HOOK_H_
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <stdlib.h>  // posix_memalign
+
+
+namespace alloc_hook
+{
+
+static std::atomic<unsigned long> n_total(0);
+static thread_local unsigned long n_thread = 0;
+
+// Number of allocations made so far, by all threads.
+inline unsigned long total_allocations()
+{
+    return n_total.load(std::memory_order_relaxed);
+}
+
+// Number of allocations made so far by the calling thread.
+inline unsigned long thread_allocations()
+{
+    return n_thread;
+}
+
+inline void * allocate(std::size_t size)
+{
+    n_total.fetch_add(1, std::memory_order_relaxed);
+    n_thread++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+inline void * allocate_or_throw(std::size_t size)
+{
+    void * p = allocate(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// Out of line: once `operator delete` is inlined next to a new-expression,
+// GCC would take the `free` for a mismatch (`-Wmismatched-new-delete`).
+__attribute__((noinline)) inline void deallocate(void * p)
+{
+    std::free(p);
+}
+
+#ifdef __cpp_aligned_new
+inline void * allocate_aligned(std::size_t size, std::align_val_t alignment)
+{
+    n_total.fetch_add(1, std::memory_order_relaxed);
+    n_thread++;
+    auto a = static_cast<std::size_t>(alignment);
+    void * p = nullptr;
+    if (posix_memalign(&p, a < sizeof(void *) ? sizeof(void *) : a, size == 0 ? 1 : size) != 0) {
+        return nullptr;
+    }
+    return p;
+}
+
+inline void * allocate_aligned_or_throw(std::size_t size, std::align_val_t alignment)
+{
+    void * p = allocate_aligned(size, alignment);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+#endif
+
+}  // namespace alloc_hook
+
+
+void * operator new(std::size_t size)
+{
+    return alloc_hook::allocate_or_throw(size);
+}
+
+void * operator new[](std::size_t size)
+{
+    return alloc_hook::allocate_or_throw(size);
+}
+
+void * operator new(std::size_t size, std::nothrow_t const &) noexcept
+{
+    return alloc_hook::allocate(size);
+}
+
+void * operator new[](std::size_t size, std::nothrow_t const &) noexcept
+{
+    return alloc_hook::allocate(size);
+}
+
+void operator delete(void * p) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete(void * p, std::nothrow_t const &) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete[](void * p, std::nothrow_t const &) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+#ifdef __cpp_aligned_new
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+    return alloc_hook::allocate_aligned_or_throw(size, alignment);
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return alloc_hook::allocate_aligned_or_throw(size, alignment);
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment, std::nothrow_t const &) noexcept
+{
+    return alloc_hook::allocate_aligned(size, alignment);
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment, std::nothrow_t const &) noexcept
+{
+    return alloc_hook::allocate_aligned(size, alignment);
+}
+
+void operator delete(void * p, std::align_val_t) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete[](void * p, std::align_val_t) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete(void * p, std::size_t, std::align_val_t) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete[](void * p, std::size_t, std::align_val_t) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete(void * p, std::align_val_t, std::nothrow_t const &) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+
+void operator delete[](void * p, std::align_val_t, std::nothrow_t const &) noexcept
+{
+    alloc_hook::deallocate(p);
+}
+#endif
+
+#endif  // include guard
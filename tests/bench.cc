@@ -0,0 +1,430 @@
+/*
+Micro-benchmarks of the hot-path operations.
+
+```
+bench [--filter SUBSTRING] [--repeat R] [--baseline FILE] [--save FILE] [--tolerance T]
+```
+
+Every benchmark is calibrated to run batches of at least 10 milliseconds, warmed up
+with one such batch, then timed over `R` batches (default 7). Reported per operation:
+the median time, the spread of the batches ((max - min) / median), and heap allocations
+(counted by replacing `operator new`; see `alloc_hook.h`).
+
+`FeatureEngine` benchmarks need nothing else. Model benchmarks run if the environment
+variable `DATADIR` is set and contains any of `svr/`, `ctr/`, `wr/` model directories
+(the layout `test_svr` and `run_ctr` use); the SVR 'has model' branches take the adgroup
+from `svr/data_test/adgroup_ids.txt` and `svr/adgroup_quantile_cutoff.txt`.
+
+`--save FILE` writes the results as a baseline: one line `name ns_per_op allocs_per_op` per benchmark.
+`--baseline FILE` compares against one: a benchmark slower by more than the tolerance
+(default 0.1, i.e. 10%) or with more allocations per operation is a regression,
+and the exit code is then 2. A time of 0 in the baseline is not compared,
+and lines starting with '#' are skipped.
+
+`tests/bench_baseline.txt` is the stored baseline. It guards allocation counts only, of the
+operations meant to be allocation-free (those `test_alloc` enforces):
+`bench --baseline tests/bench_baseline.txt` fails if one of them allocates.
+Timing regressions are deliberately out of its scope: no reference machine is defined,
+so its times are 0, which `--baseline` skips. To check times, save a baseline with `--save`
+and compare against it on the same machine, with the same build.
+
+`stats/stage` is the cost of timing one stage under `SATURN_STATS`: a timestamp and
+a histogram record. After the model benchmarks, the overhead of the stage timing on each
+is estimated from it: the stages the call times, at that cost, over the time of the call.
+To measure it directly instead, save a baseline with a regular build, then rebuild with
+`make clean && make STATS=1 bench` and compare with `--tolerance 0.02`.
+
+Names are `group/operation/variant`. `ctr/get_prob/render` minus `ctr/get_prob/cached`
+is the cost of rendering the CTR composer; likewise for `wr`.
+*/
+
+
+#include "saturn/saturn.h"
+#include "saturn/utils.h"
+#include "alloc_hook.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace saturn;
+
+
+struct Result {
+    std::string name;
+    double ns_per_op;
+    double spread;
+    double allocs_per_op;
+    size_t n_stages = 0;  // timed under `SATURN_STATS`
+};
+
+
+struct Options {
+    std::string filter;
+    size_t repeat = 7;
+    std::string baseline;
+    std::string save;
+    double tolerance = 0.1;
+};
+
+
+volatile double sink = 0.;
+
+
+double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+// Time `op`, called with the operation number, in calibrated batches.
+Result bench(std::string const & name, Options const & options, std::function<void(size_t)> const & op)
+{
+    size_t batch = 1;
+    while (true) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch; i++) {
+            op(i);
+        }
+        if (seconds_since(t0) >= 0.01 || batch >= (size_t(1) << 30)) {
+            break;
+        }
+        batch *= 2;
+    }
+
+    std::vector<double> ns;
+    auto allocs_before = alloc_hook::thread_allocations();
+    for (size_t r = 0; r < options.repeat; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch; i++) {
+            op(i);
+        }
+        ns.push_back(seconds_since(t0) * 1e9 / batch);
+    }
+    auto allocs = alloc_hook::thread_allocations() - allocs_before;
+
+    std::sort(ns.begin(), ns.end());
+    Result result;
+    result.name = name;
+    result.ns_per_op = ns[ns.size() / 2];
+    result.spread = (ns.back() - ns.front()) / result.ns_per_op;
+    result.allocs_per_op = static_cast<double>(allocs) / (batch * options.repeat);
+    return result;
+}
+
+
+class Suite
+{
+  public:
+    Suite(Options const & options) : _options(options) {}
+
+    // `n_stages`: stages that `op` times when built with `SATURN_STATS`.
+    void add(std::string const & name, std::function<void(size_t)> const & op, size_t n_stages = 0)
+    {
+        if (!_options.filter.empty() && name.find(_options.filter) == std::string::npos) {
+            return;
+        }
+        auto r = bench(name, _options, op);
+        r.n_stages = n_stages;
+        std::cout << std::left << std::setw(40) << r.name << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << r.ns_per_op << " ns/op"
+                  << std::setw(8) << r.spread * 100 << " %"
+                  << std::setprecision(2)
+                  << std::setw(10) << r.allocs_per_op << " allocs/op" << std::endl;
+        _results.push_back(r);
+    }
+
+    std::vector<Result> const & results() const
+    {
+        return _results;
+    }
+
+  private:
+    Options const & _options;
+    std::vector<Result> _results;
+};
+
+
+void bench_feature_engine(Suite & suite)
+{
+    FeatureEngine fe;
+    fe.reset_fields();
+
+    suite.add("fe/update_field/string", [&](size_t i) {
+        fe.update_field(FeatureEngine::StringField::kOs, (i & 1) ? "ios" : "android");
+    });
+    std::string const value = "android";
+    suite.add("fe/update_field/string_unchanged", [&](size_t) {
+        fe.update_field(FeatureEngine::StringField::kOs, value);
+    });
+    suite.add("fe/update_field/int", [&](size_t i) {
+        fe.update_field(FeatureEngine::IntField::kAge, static_cast<int>(i & 63));
+    });
+    suite.add("fe/update_field/float", [&](size_t i) {
+        fe.update_field(FeatureEngine::FloatField::kUserExtlba, 0.001 * (i & 1023));
+    });
+    suite.add("fe/reset_fields/unchanged", [&](size_t) {
+        fe.reset_fields();
+    });
+    // A typical request touches a few fields before the next reset.
+    suite.add("fe/reset_fields/after_3_updates", [&](size_t i) {
+        fe.update_field(FeatureEngine::StringField::kOs, "ios");
+        fe.update_field(FeatureEngine::IntField::kAge, static_cast<int>(i & 63) + 1);
+        fe.update_field(FeatureEngine::FloatField::kLat, 40.7);
+        fe.reset_fields();
+    });
+}
+
+
+void bench_stats(Suite & suite)
+{
+    StageRecorder recorder;
+    uint64_t t0 = stats_ticks();
+    suite.add("stats/stage", [&](size_t) {
+        uint64_t t1 = stats_ticks();
+        recorder.record(StageRecorder::Stage::evaluate, t1 - t0);
+        t0 = t1;
+    });
+}
+
+
+// Estimated overhead of the stage timing on each model call; see `stats/stage`.
+void print_stats_overhead(std::vector<Result> const & results)
+{
+    double stage_ns = -1.;
+    for (auto const & r : results) {
+        if (r.name == "stats/stage") {
+            stage_ns = r.ns_per_op;
+        }
+    }
+    if (stage_ns < 0.) {
+        return;
+    }
+    bool header = false;
+    for (auto const & r : results) {
+        if (r.n_stages == 0) {
+            continue;
+        }
+        if (!header) {
+            std::cout << std::endl << "estimated overhead of the stage timing (" << std::fixed << std::setprecision(1)
+                      << stage_ns << " ns per stage):" << std::endl;
+            header = true;
+        }
+        double overhead = r.n_stages * stage_ns / r.ns_per_op;
+        std::cout << std::left << std::setw(40) << r.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(8) << overhead * 100 << " %  (" << r.n_stages << " stages)" << std::endl;
+    }
+}
+
+
+bool exists(std::string const & path)
+{
+    return std::ifstream(path).good();
+}
+
+
+std::string first_word(std::string const & path)
+{
+    std::ifstream infile(path);
+    std::string word;
+    infile >> word;
+    return word;
+}
+
+
+void bench_svr(Suite & suite, std::string const & path)
+{
+    FeatureEngine fe;
+    SvrModel model(fe, path);
+    std::string const brand = "__bench_brand__";
+
+    std::string const none = "__bench_no_adgroup__";
+    suite.add("svr/run/no_model", [&](size_t) {
+        model.run(brand, none, 0.5);
+    });
+
+    // `run` takes the adgroup key with a leading '/', as `test_svr` does;
+    // `get_multiplier` and `get_cpsvr` take the bare adgroup ID.
+    auto adgroup_id = first_word(path + "/data_test/adgroup_ids.txt");
+    auto adgroup = "/" + adgroup_id;
+    if (!adgroup_id.empty() && model.has_model(adgroup)) {
+        suite.add("svr/run/model", [&](size_t i) {
+            model.run(brand, adgroup, 0.25 + 0.0001 * (i & 1023));
+        }, 4);
+        suite.add("svr/run/minus_one", [&](size_t) {
+            model.run(brand, adgroup, -1.);
+        });
+        suite.add("svr/get_multiplier/brand", [&](size_t i) {
+            model.get_multiplier(brand, adgroup_id, 0.25 + 0.0001 * (i & 1023), SvrModel::Mode::brand);
+        }, 1);
+        suite.add("svr/get_cpsvr/brand", [&](size_t i) {
+            model.get_cpsvr(brand, adgroup_id, 0.25 + 0.0001 * (i & 1023), SvrModel::Mode::brand);
+        }, 1);
+    }
+
+    auto cutoff_adgroup = "/" + first_word(path + "/adgroup_quantile_cutoff.txt");
+    if (cutoff_adgroup.size() > 1 && model.has_model(cutoff_adgroup)) {
+        suite.add("svr/run/cutoff", [&](size_t i) {
+            model.run(brand, cutoff_adgroup, 0.25 + 0.0001 * (i & 1023));
+        }, 4);
+    }
+}
+
+
+void bench_ctr(Suite & suite, std::string const & path)
+{
+    FeatureEngine fe;
+    ctrModel model(fe, path);
+    fe.reset_fields();
+
+    suite.add("ctr/get_prob/cached", [&](size_t) {
+        sink = model.get_prob();
+    }, 3);
+    suite.add("ctr/get_prob/render", [&](size_t i) {
+        fe.update_field(FeatureEngine::IntField::ctr_sl_adjusted_confidence, static_cast<int>(i & 1));
+        sink = model.get_prob();
+    }, 3);
+}
+
+
+void bench_wr(Suite & suite, std::string const & path)
+{
+    FeatureEngine fe;
+    WrModel model(fe, path);
+    fe.reset_fields();
+
+    suite.add("wr/get_prob/cached", [&](size_t) {
+        sink = model.get_prob();
+    }, 3);
+    suite.add("wr/get_prob/render", [&](size_t i) {
+        fe.update_field(FeatureEngine::IntField::wr_Hour, static_cast<int>(i % 24));
+        sink = model.get_prob();
+    }, 3);
+}
+
+
+std::map<std::string, Result> read_baseline(std::string const & filename)
+{
+    std::map<std::string, Result> baseline;
+    std::ifstream infile(filename);
+    if (!infile) {
+        throw SaturnError("cannot read baseline file '" + filename + "'");
+    }
+    std::string line;
+    while (std::getline(infile, line)) {
+        std::istringstream fields(line);
+        Result r;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (!(fields >> r.name >> r.ns_per_op >> r.allocs_per_op)) {
+            throw SaturnError("malformed line in baseline file '" + filename + "': " + line);
+        }
+        r.spread = 0.;
+        baseline[r.name] = r;
+    }
+    return baseline;
+}
+
+
+// Print the comparison; return the number of regressions.
+size_t compare(std::vector<Result> const & results, std::map<std::string, Result> const & baseline, double tolerance)
+{
+    size_t n_regressions = 0;
+    std::cout << std::endl << "compared to baseline:" << std::endl;
+    for (auto const & r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            std::cout << std::left << std::setw(40) << r.name << "  (new)" << std::endl;
+            continue;
+        }
+        auto const & b = it->second;
+        double change = b.ns_per_op > 0 ? r.ns_per_op / b.ns_per_op - 1. : 0.;
+        bool slower = change > tolerance;
+        bool more_allocs = r.allocs_per_op > b.allocs_per_op + 0.005;
+        if (slower || more_allocs) {
+            n_regressions++;
+        }
+        std::cout << std::left << std::setw(40) << r.name << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << b.ns_per_op << " -> " << std::setw(10) << r.ns_per_op << " ns/op"
+                  << std::showpos << std::setw(8) << change * 100 << " %" << std::noshowpos
+                  << std::setprecision(2)
+                  << std::setw(8) << b.allocs_per_op << " -> " << std::setw(6) << r.allocs_per_op << " allocs/op"
+                  << (slower ? "  SLOWER" : "") << (more_allocs ? "  MORE ALLOCS" : "") << std::endl;
+    }
+    return n_regressions;
+}
+
+
+int main(int argc, char const * const * argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--repeat" && has_value) {
+            options.repeat = std::max(1UL, std::stoul(argv[++i]));
+        } else if (arg == "--baseline" && has_value) {
+            options.baseline = argv[++i];
+        } else if (arg == "--save" && has_value) {
+            options.save = argv[++i];
+        } else if (arg == "--tolerance" && has_value) {
+            options.tolerance = std::stod(argv[++i]);
+        } else {
+            std::cerr << "Usage:\n"
+                      << "  bench [--filter SUBSTRING] [--repeat R] [--baseline FILE] [--save FILE] [--tolerance T]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    Suite suite(options);
+    bench_feature_engine(suite);
+    bench_stats(suite);
+
+    char const * datadir = std::getenv("DATADIR");
+    if (datadir) {
+        std::string dir = datadir;
+        if (exists(dir + "/svr/model_config.json")) {
+            bench_svr(suite, dir + "/svr");
+        }
+        if (exists(dir + "/ctr/model_config.json")) {
+            bench_ctr(suite, dir + "/ctr");
+        }
+        if (exists(dir + "/wr/model_config.json")) {
+            bench_wr(suite, dir + "/wr");
+        }
+    } else {
+        std::cout << "(DATADIR not set; skipping model benchmarks)" << std::endl;
+    }
+
+    print_stats_overhead(suite.results());
+
+    if (!options.save.empty()) {
+        std::ofstream outfile(options.save);
+        outfile << std::setprecision(6);
+        for (auto const & r : suite.results()) {
+            outfile << r.name << " " << r.ns_per_op << " " << r.allocs_per_op << "\n";
+        }
+    }
+
+    if (!options.baseline.empty()) {
+        if (compare(suite.results(), read_baseline(options.baseline), options.tolerance) > 0) {
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "saturn/common.h"
 #include "saturn/saturn.h"
 #include "saturn/utils.h"
+#include "saturn/forest.h"
 #include "mars/mars.h"
 #include "mars/numeric.h"
 #include "mars/utils.h"
@@ -9,9 +10,11 @@
 #include <any>
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <random>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -45,8 +48,83 @@ void latency(int n_iter, double x_value, std::unique_ptr<mars::BinaryRandomFores
 }
 
 
+// Compare `mars::BinaryRandomForestClassifier` against `saturn::CompiledForest`
+// on random rows: agreement of predictions, and time per prediction of each engine.
+void compare(int n_rows, std::unique_ptr<mars::BinaryRandomForestClassifier> & model, CompiledForest const & forest)
+{
+    size_t n_feature = model->n_predictors();
+    std::mt19937 rng(1234);
+    std::normal_distribution<double> dist(0.0, 1.0);
+    std::vector<std::vector<double>> rows(n_rows, std::vector<double>(n_feature));
+    std::vector<double> flat;
+    for (auto & row : rows) {
+        for (auto & v : row) {
+            v = dist(rng);
+        }
+        flat.insert(flat.end(), row.cbegin(), row.cend());
+    }
+
+    std::vector<double> y_mars(n_rows), y_tree(n_rows), y_bitvector(n_rows), y_batch(n_rows);
+    auto timer = Timer();
+
+    timer.start();
+    for (int i = 0; i < n_rows; i++) {
+        y_mars[i] = model->predict_one(rows[i]);
+    }
+    timer.stop();
+    double t_mars = timer.milliseconds();
+
+    timer.start();
+    for (int i = 0; i < n_rows; i++) {
+        y_tree[i] = forest.predict_one(rows[i].data());
+    }
+    timer.stop();
+    double t_tree = timer.milliseconds();
+
+    double t_bitvector = 0.;
+    if (forest.has_bitvector()) {
+        timer.start();
+        for (int i = 0; i < n_rows; i++) {
+            y_bitvector[i] = forest.predict_one_bitvector(rows[i].data());
+        }
+        timer.stop();
+        t_bitvector = timer.milliseconds();
+    }
+
+    timer.start();
+    forest.predict_many(flat.data(), n_rows, y_batch.data());
+    timer.stop();
+    double t_batch = timer.milliseconds();
+
+    auto report = [&](std::string const & name, std::vector<double> const & y, double ms) {
+        double max_diff = 0.;
+        int n_exact = 0;
+        for (int i = 0; i < n_rows; i++) {
+            max_diff = std::max(max_diff, std::abs(y[i] - y_mars[i]));
+            n_exact += (y[i] == y_mars[i]);
+        }
+        std::cout << "  " << name << "\tper prediction: " << ms / n_rows << " milliseconds"
+                  << "\tspeedup: " << t_mars / ms
+                  << "\tbit-exact: " << n_exact << "/" << n_rows
+                  << "\tmax abs diff: " << max_diff << std::endl;
+    };
+
+    std::cout << "  mars\t\tper prediction: " << t_mars / n_rows << " milliseconds" << std::endl;
+    report("compiled", y_tree, t_tree);
+    if (forest.has_bitvector()) {
+        report("bitvector", y_bitvector, t_bitvector);
+    } else {
+        std::cout << "  bitvector\tunavailable (a tree has more than 64 leaves)" << std::endl;
+    }
+    report("batched", y_batch, t_batch);
+}
+
+
 int main(int argc, char const * const * argv)
 {
+    // Usage:
+    //   latency model_file
+    //   latency model_file compare
     if (argc < 2) {
         return 1;
     }
@@ -75,5 +153,12 @@ int main(int argc, char const * const * argv)
     latency(100, 0.0, model);
     latency(100, -1.0, model);
 
+    if (argc > 2 && std::string(argv[2]) == "compare") {
+        auto forest = CompiledForest::from_avro(modelpath);
+        std::cout << std::endl << "  compiled forest: " << forest.n_trees() << " trees, "
+                  << forest.n_nodes() << " nodes" << std::endl;
+        compare(1000, model, forest);
+    }
+
     return 0;
 }
\ No newline at end of file
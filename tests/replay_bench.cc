@@ -0,0 +1,236 @@
+/*
+Replay benchmark: scores logged requests with the SVR, CTR and WR models and reports
+latency percentiles per request, for 1 up to N threads, as JSON on stdout.
+
+```
+replay_bench [--svr DIR] [--ctr DIR] [--wr DIR] [--threads N] [--repeat R] request_file
+```
+
+`request_file` is in a format read by `replay`: a tab-separated file whose header names
+`FeatureEngine` fields and, optionally, the `SvrModel::run` arguments `brand_id`, `adgroup_id`,
+`user_adgroup_svr`, `pacing` (see `RequestParser`), or the same converted by `replay_convert`
+to a binary replay file (see `ReplayFile`), which loads without parsing.
+
+The models are loaded once and bound to one `FeatureEngine` context per thread;
+the bound instances share the decoded mars models.
+For each thread count 1, 2, 4, ... below N, and N, every thread first scores a warm-up share
+of the requests untimed, then all requests are scored `R` times, split across the threads.
+Each request is timed individually (field ingestion plus all model calls).
+
+Output:
+
+```
+{"rows": 10000, "repeat": 3, "runs": [
+  {"threads": 1, "requests": 30000, "errors": 0, "seconds": 1.2, "requests_per_second": 25000,
+   "latency_us": {"mean": 40.1, "min": 31.0, "p50": 39.2, "p90": 45.5, "p99": 60.3, "p99.9": 92.0, "max": 250.7}},
+  ...
+]}
+```
+*/
+
+
+#include "saturn/saturn.h"
+#include "saturn/histogram.h"
+#include "saturn/utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace saturn;
+
+
+struct Context : ModelContext {
+    Histogram histogram;
+
+    Context(std::string const & svr, std::string const & ctr, std::string const & wr)
+        : ModelContext(svr, ctr, wr)
+    {
+    }
+
+    // Binds the models of `prototype`; the histogram starts empty.
+    Context(Context const & prototype)
+        : ModelContext(prototype)
+    {
+    }
+};
+
+
+// Score requests [begin, end); returns the number of failed requests.
+size_t score(Context & ctx, std::vector<ModelSet::Request> const & requests, size_t begin, size_t end, bool timed)
+{
+    size_t n_errors = 0;
+    for (size_t i = begin; i < end; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        try {
+            ctx.model_set.run(requests[i], ctx.result);
+            for (auto const & s : ctx.result.svr) {
+                if (s.code != 0) {
+                    n_errors++;
+                    break;
+                }
+            }
+        } catch (std::exception const &) {
+            n_errors++;
+        }
+        if (timed) {
+            auto t1 = std::chrono::steady_clock::now();
+            ctx.histogram.record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+        }
+    }
+    return n_errors;
+}
+
+
+void print_run(size_t n_threads, Histogram const & h, size_t n_errors, double seconds, bool last)
+{
+    std::cout << "  {\"threads\": " << n_threads
+              << ", \"requests\": " << h.count()
+              << ", \"errors\": " << n_errors
+              << ", \"seconds\": " << seconds
+              << ", \"requests_per_second\": " << (seconds > 0 ? h.count() / seconds : 0.)
+              << ",\n   \"latency_us\": {"
+              << "\"mean\": " << h.mean() / 1000.
+              << ", \"min\": " << h.min() / 1000.
+              << ", \"p50\": " << h.percentile(50.) / 1000.
+              << ", \"p90\": " << h.percentile(90.) / 1000.
+              << ", \"p99\": " << h.percentile(99.) / 1000.
+              << ", \"p99.9\": " << h.percentile(99.9) / 1000.
+              << ", \"max\": " << h.max() / 1000.
+              << "}}" << (last ? "" : ",") << std::endl;
+}
+
+
+int main(int argc, char const * const * argv)
+{
+    std::string svr, ctr, wr, input;
+    size_t max_threads = 1;
+    size_t repeat = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--svr" && has_value) {
+            svr = strip_slash(argv[++i]);
+        } else if (arg == "--ctr" && has_value) {
+            ctr = strip_slash(argv[++i]);
+        } else if (arg == "--wr" && has_value) {
+            wr = strip_slash(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            max_threads = resolve_thread_count(std::stoul(argv[++i]));
+        } else if (arg == "--repeat" && has_value) {
+            repeat = std::stoul(argv[++i]);
+        } else if (input.empty() && arg.size() > 0 && arg[0] != '-') {
+            input = arg;
+        } else {
+            input.clear();
+            break;
+        }
+    }
+    if (input.empty() || repeat == 0 || (svr.empty() && ctr.empty() && wr.empty())) {
+        std::cerr << "Usage:\n"
+                  << "  replay_bench [--svr DIR] [--ctr DIR] [--wr DIR] [--threads N] [--repeat R] request_file"
+                  << std::endl;
+        return 1;
+    }
+
+    // Read all requests up front so that parsing is not timed.
+    // A binary replay file (see `ReplayFile`) needs no parsing.
+    std::vector<ModelSet::Request> requests;
+    auto add_request = [&](ModelSet::Request & request) {
+        request.reset_fields = true;
+        request.run_ctr = !ctr.empty();
+        request.run_wr = !wr.empty();
+        if (svr.empty()) {
+            request.svr_calls.clear();
+        }
+        requests.push_back(request);
+    };
+    std::unique_ptr<ReplayFile> replay_file;  // the requests point into it
+    if (ReplayFile::is_replay_file(input)) {
+        replay_file.reset(new ReplayFile(input));
+        requests.reserve(replay_file->n_rows());
+        ModelSet::Request request;
+        for (size_t i = 0; i < replay_file->n_rows(); i++) {
+            replay_file->fill(i, request);
+            add_request(request);
+        }
+    } else {
+        std::ifstream file(input);
+        std::string line;
+        if (!file || !std::getline(file, line)) {
+            std::cerr << "cannot read '" << input << "'" << std::endl;
+            return 1;
+        }
+        RequestParser parser(line);
+        ModelSet::Request request;
+        while (std::getline(file, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            parser.parse(line, request);
+            add_request(request);
+        }
+    }
+    if (requests.empty()) {
+        std::cerr << "no requests in '" << input << "'" << std::endl;
+        return 1;
+    }
+    size_t n = requests.size();
+
+    std::vector<std::unique_ptr<Context>> contexts;
+    contexts.emplace_back(new Context(svr, ctr, wr));
+    for (size_t t = 1; t < max_threads; t++) {
+        contexts.emplace_back(new Context(*contexts[0]));
+    }
+
+    std::vector<size_t> thread_counts;
+    for (size_t t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);  // 1, 2, 4, ..., N
+
+    std::cout << "{\"rows\": " << n << ", \"repeat\": " << repeat << ", \"runs\": [" << std::endl;
+    for (size_t k = 0; k < thread_counts.size(); k++) {
+        auto n_threads = thread_counts[k];
+
+        // Warm up every context on its own share of the requests.
+        parallel_chunks(n, (n + n_threads - 1) / n_threads, n_threads, [&](size_t worker, size_t begin, size_t end) {
+            score(*contexts[worker], requests, begin, end, false);
+        });
+        for (size_t t = 0; t < n_threads; t++) {
+            contexts[t]->histogram.reset();
+        }
+
+        std::atomic<size_t> n_errors(0);
+        auto timer = Timer();
+        timer.start();
+        parallel_chunks(n * repeat, 64, n_threads, [&](size_t worker, size_t begin, size_t end) {
+            // Index i is request i % n; a chunk may span the end of a pass.
+            size_t errors = 0;
+            while (begin < end) {
+                size_t pass_end = std::min(end, (begin / n + 1) * n);
+                errors += score(*contexts[worker], requests, begin % n, (pass_end - 1) % n + 1, true);
+                begin = pass_end;
+            }
+            n_errors += errors;
+        });
+        timer.stop();
+
+        Histogram total;
+        for (size_t t = 0; t < n_threads; t++) {
+            total.merge(contexts[t]->histogram);
+        }
+        print_run(n_threads, total, n_errors.load(), timer.seconds(), k + 1 == thread_counts.size());
+    }
+    std::cout << "]}" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,303 @@
+/*
+Counts heap allocations per scoring call, by model, method and branch, and fails
+when a path that is meant to be allocation-free allocates.
+
+```
+test_alloc [--strict] [--calls N] [--no-models]
+```
+
+Allocations are counted by replacing `operator new` (see `alloc_hook.h`).
+Every scenario is warmed up first (growing scratch buffers and filling caches
+is allowed once), then called `N` times (default 1000).
+
+As in `bench`, model scenarios run on the `svr/`, `ctr/` and `wr/` model directories
+in the directory named by the environment variable `DATADIR`; `FeatureEngine` scenarios
+always run. Most allocation-free paths are SVR paths, so the test fails if `DATADIR` has
+no SVR model, unless `--no-models` asks for the `FeatureEngine` scenarios alone.
+CTR and WR models are optional; each one missing is reported as skipped.
+The SVR 'has model' scenarios take the adgroup from `svr/data_test/adgroup_ids.txt`.
+
+Allocation-free paths, which fail the test if they allocate:
+  - `FeatureEngine::update_field` with an unchanged value;
+  - `SvrModel::run`: no model, cached default multiplier;
+  - `SvrModel::run_cheap`;
+  - `SvrModel::get_multiplier`: -1 traffic, adgroup not in the catalog, no submodel;
+  - `SvrModel::get_cpsvr`: -1 traffic, no submodel.
+Paths through rendering and the mars models are reported but not enforced
+unless `--strict` is given.
+
+The exit code is 1 if an allocation-free path allocated, or if the SVR scenarios
+could not run.
+*/
+
+
+#include "saturn/saturn.h"
+#include "alloc_hook.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace saturn;
+
+
+struct Count {
+    size_t calls = 0;
+    size_t allocations = 0;
+    size_t max_allocations = 0;  // in one call
+    bool enforced = false;
+};
+
+
+class Checker
+{
+  public:
+    Checker(size_t n_calls, bool strict) : _n_calls(n_calls), _strict(strict) {}
+
+    // Call `op` `n_calls` times after warming it up; `op` returns the branch taken,
+    // under which the allocations are counted. Branches in `allocation_free` must not allocate.
+    void check(std::string const & name, std::set<std::string> const & allocation_free,
+               std::function<char const *()> const & op)
+    {
+        op();
+        op();
+        for (size_t i = 0; i < _n_calls; i++) {
+            auto before = alloc_hook::thread_allocations();
+            char const * taken = op();
+            size_t n = alloc_hook::thread_allocations() - before;
+            std::string branch = taken;
+            auto & count = _counts[name + "/" + branch];
+            count.calls++;
+            count.allocations += n;
+            if (n > count.max_allocations) {
+                count.max_allocations = n;
+            }
+            count.enforced = _strict || allocation_free.count(branch) > 0;
+        }
+    }
+
+    // Print the counts; the number of enforced paths that allocated.
+    size_t report() const
+    {
+        size_t n_failed = 0;
+        for (auto const & entry : _counts) {
+            auto const & c = entry.second;
+            bool failed = c.enforced && c.max_allocations > 0;
+            n_failed += failed;
+            std::cout << std::left << std::setw(48) << entry.first << std::right
+                      << std::fixed << std::setprecision(2)
+                      << std::setw(10) << static_cast<double>(c.allocations) / c.calls << " allocs/call"
+                      << std::setw(6) << c.max_allocations << " max"
+                      << (failed ? "  FAIL" : (c.enforced ? "  ok" : "")) << std::endl;
+        }
+        return n_failed;
+    }
+
+  private:
+    size_t _n_calls;
+    bool _strict;
+    std::map<std::string, Count> _counts;
+};
+
+
+std::string first_word(std::string const & path)
+{
+    std::ifstream infile(path);
+    std::string word;
+    infile >> word;
+    return word;
+}
+
+
+bool exists(std::string const & path)
+{
+    return std::ifstream(path).good();
+}
+
+
+void check_feature_engine(Checker & checker)
+{
+    FeatureEngine fe;
+    std::string const os = "android";
+    fe.update_field(FeatureEngine::StringField::kOs, os);
+    fe.update_field(FeatureEngine::IntField::kAge, 30);
+    checker.check("fe/update_field/string_unchanged", {"-"}, [&]() {
+        fe.update_field(FeatureEngine::StringField::kOs, os);
+        return "-";
+    });
+    checker.check("fe/update_field/int_unchanged", {"-"}, [&]() {
+        fe.update_field(FeatureEngine::IntField::kAge, 30);
+        return "-";
+    });
+}
+
+
+void check_svr(Checker & checker, std::string const & path)
+{
+    FeatureEngine fe;
+    SvrModel model(fe, path);
+    auto adgroup = first_word(path + "/data_test/adgroup_ids.txt");
+    std::string const brand = "brand";
+    std::string const slashed = "/" + adgroup;
+    std::string const unknown = "no-such-adgroup";
+    std::string const unknown_slashed = "/" + unknown;
+
+    auto branch = [&]() { return SvrModel::branch_name(model.branch()); };
+    std::set<std::string> const run_free = {"no_model", "default_cached"};
+    std::set<std::string> const cheap_free = {"no_model", "fallback"};
+    std::set<std::string> const multiplier_free = {"negative_svr", "no_adgroup", "no_model"};
+    std::set<std::string> const cpsvr_free = {"negative_svr", "no_model"};
+
+    checker.check("svr/run", run_free, [&]() {
+        model.run(brand, unknown_slashed, 0.5);
+        return branch();
+    });
+    checker.check("svr/run_cheap", cheap_free, [&]() {
+        model.run_cheap(brand, unknown_slashed, 0.5);
+        return branch();
+    });
+    checker.check("svr/get_multiplier", multiplier_free, [&]() {
+        model.get_multiplier(brand, adgroup, -1., SvrModel::Mode::brand);
+        return branch();
+    });
+    checker.check("svr/get_multiplier", multiplier_free, [&]() {
+        model.get_multiplier(brand, unknown, 0.5, SvrModel::Mode::brand);
+        return branch();
+    });
+    checker.check("svr/get_cpsvr", cpsvr_free, [&]() {
+        model.get_cpsvr(brand, adgroup, -1., SvrModel::Mode::brand);
+        return branch();
+    });
+    if (adgroup.empty()) {
+        return;
+    }
+    // -1 traffic is cached after the warm-up call; the others depend on the catalog.
+    checker.check("svr/run", run_free, [&]() {
+        model.run(brand, slashed, -1.);
+        return branch();
+    });
+    checker.check("svr/run_cheap", cheap_free, [&]() {
+        model.run_cheap(brand, slashed, 0.5);
+        return branch();
+    });
+    checker.check("svr/run", run_free, [&]() {
+        model.run(brand, slashed, 0.5);
+        return branch();
+    });
+    checker.check("svr/get_multiplier", multiplier_free, [&]() {
+        model.get_multiplier(brand, adgroup, 0.5, SvrModel::Mode::brand);
+        return branch();
+    });
+    checker.check("svr/get_cpsvr", cpsvr_free, [&]() {
+        model.get_cpsvr(brand, adgroup, 0.5, SvrModel::Mode::brand);
+        return branch();
+    });
+}
+
+
+void check_ctr(Checker & checker, std::string const & path)
+{
+    FeatureEngine fe;
+    ctrModel model(fe, path);
+    std::vector<std::string> input(17, "");
+    input[16] = "0";
+    checker.check("ctr/get_prob", {}, [&]() {
+        model.get_prob();
+        return "fields_unchanged";
+    });
+    checker.check("ctr/get_prob", {}, [&]() {
+        model.get_prob(input);
+        return "vector";
+    });
+}
+
+
+void check_wr(Checker & checker, std::string const & path)
+{
+    FeatureEngine fe;
+    WrModel model(fe, path);
+    std::vector<std::string> input(14, "");
+    input[11] = input[12] = input[13] = "0";
+    checker.check("wr/get_prob", {}, [&]() {
+        model.get_prob();
+        return "fields_unchanged";
+    });
+    checker.check("wr/get_prob", {}, [&]() {
+        model.get_prob(input);
+        return "vector";
+    });
+    checker.check("wr/get_win_prob", {}, [&]() {
+        model.get_win_prob();
+        return "-";
+    });
+}
+
+
+int main(int argc, char const * const * argv)
+{
+    bool strict = false;
+    bool models = true;
+    size_t n_calls = 1000;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--strict") {
+            strict = true;
+        } else if (arg == "--no-models") {
+            models = false;
+        } else if (arg == "--calls" && i + 1 < argc) {
+            n_calls = std::stoul(argv[++i]);
+        } else {
+            std::cout << "Usage: test_alloc [--strict] [--calls N] [--no-models]" << std::endl;
+            return 1;
+        }
+    }
+
+    Checker checker(n_calls, strict);
+    check_feature_engine(checker);
+
+    bool svr_missing = false;
+    if (models) {
+        char const * datadir = std::getenv("DATADIR");
+        std::string dir = datadir ? datadir : "";
+        auto has_model = [&](std::string const & kind) {
+            if (datadir && exists(dir + "/" + kind + "/model_config.json")) {
+                return true;
+            }
+            std::cout << "SKIPPED " << kind << " scenarios: no model in "
+                      << (datadir ? dir + "/" + kind : "DATADIR (unset)") << std::endl;
+            return false;
+        };
+        if (has_model("svr")) {
+            check_svr(checker, dir + "/svr");
+        } else {
+            svr_missing = true;
+        }
+        if (has_model("ctr")) {
+            check_ctr(checker, dir + "/ctr");
+        }
+        if (has_model("wr")) {
+            check_wr(checker, dir + "/wr");
+        }
+    } else {
+        std::cout << "SKIPPED svr, ctr and wr scenarios (--no-models)" << std::endl;
+    }
+
+    auto n_failed = checker.report();
+    int code = 0;
+    if (n_failed > 0) {
+        std::cout << n_failed << " allocation-free path(s) allocated" << std::endl;
+        code = 1;
+    }
+    if (svr_missing) {
+        std::cout << "FAILED: the SVR scenarios did not run; set DATADIR to a directory with svr/,"
+                  << " or pass --no-models" << std::endl;
+        code = 1;
+    }
+    return code;
+}
@@ -36,6 +36,11 @@ where 'aaa', 'bbb', 'ccc' are adgroup ID's.
 `user_extlab` contains user-level SVR predictions corresponding to each row in `raw.txt`
 (which is for a particular user) for the adgroup ID that is used as the file name.
 This directory contains files `aaa.txt`, `bbb.txt`, `ccc.txt`, corresponding to the content of the file `adgroup_ids.txt`.
+
+If `data_test/replay.rpl` exists, it is read instead of the text files above.
+It is written by `replay_convert --svr-test DIR` (see `ReplayFile`): the columns of `raw.txt`,
+which are ingested, and one column `user_extlba/<adgroup_id>` per adgroup. It is mapped
+into memory and read in place, with no parsing.
 */
 
 
@@ -233,6 +238,80 @@ void run(
 }
 
 
+// As `run`, reading the requests in place from a replay file.
+void run_replay(FeatureEngine & feature_engine, SvrModel * svr_model, ReplayFile const & replay_file)
+{
+    struct FieldColumn {
+        size_t column;
+        RequestColumn kind;
+        size_t idx_in_type;
+    };
+    std::vector<FieldColumn> fields;
+    std::vector<std::string> adgroup_ids;
+    std::vector<double const *> user_adgroup_svr;
+    std::string const prefix = "user_extlba/";
+    for (size_t i = 0; i < replay_file.n_columns(); i++) {
+        auto const & name = replay_file.name(i);
+        size_t idx = 0;
+        auto kind = request_column(name, idx);
+        if (kind == RequestColumn::string_field || kind == RequestColumn::int_field ||
+                kind == RequestColumn::float_field) {
+            fields.push_back(FieldColumn{i, kind, idx});
+        } else if (name.compare(0, prefix.size(), prefix) == 0) {
+            adgroup_ids.push_back("/" + name.substr(prefix.size()));
+            user_adgroup_svr.push_back(replay_file.floats(i));
+        }
+    }
+    if (adgroup_ids.empty()) {
+        throw std::runtime_error("no user_extlba columns in replay file");
+    }
+    for (auto const & adgroup_id : adgroup_ids) {
+        if (!svr_model->has_model(adgroup_id)) {
+            throw std::runtime_error(std::string("adgroup ") + adgroup_id + " is not recognized by model!");
+        }
+    }
+
+    auto n_req = replay_file.n_rows();
+    auto timer = Timer();
+    timer.start();
+
+    for (size_t i_req = 0; i_req < n_req; i_req++) {
+        // Ingest request-level fields into feature engine.
+        for (auto const & f : fields) {
+            if (f.kind == RequestColumn::string_field) {
+                feature_engine.update_field(
+                    static_cast<FeatureEngine::StringField>(f.idx_in_type), replay_file.string_at(f.column, i_req));
+            } else if (f.kind == RequestColumn::int_field) {
+                feature_engine.update_field(
+                    static_cast<FeatureEngine::IntField>(f.idx_in_type), replay_file.ints(f.column)[i_req]);
+            } else {
+                feature_engine.update_field(
+                    static_cast<FeatureEngine::FloatField>(f.idx_in_type), replay_file.floats(f.column)[i_req]);
+            }
+        }
+
+        // Run SVR model for each adgroup.
+        for (size_t i_adgroup = 0; i_adgroup < adgroup_ids.size(); i_adgroup++) {
+            auto const & adgroup_id = adgroup_ids[i_adgroup];
+            auto const & brand_id = adgroup_id;  // actual brand_id plays no role in this test
+            if (svr_model->run(brand_id, adgroup_id, user_adgroup_svr[i_adgroup][i_req]) != 0) {
+                std::cout << "oooops " << svr_model->message() << std::endl;
+            }
+        }
+    }
+
+    timer.stop();
+
+    auto N = n_req;
+    auto n = adgroup_ids.size();
+    std::cout << "processing " << N << " requests:" << std::endl;
+    timeit(N, timer);
+    std::cout << std::endl << "considering " << n << " brands per request, "
+              << "hence " << N * n << " model calls:" << std::endl;
+    timeit(N * n, timer);
+}
+
+
 int main(int argc, char const * const * argv)
 {
     std::string modelpath;
@@ -249,6 +328,14 @@ int main(int argc, char const * const * argv)
     auto feature_engine = saturn::FeatureEngine();
     auto svr_model = new saturn::SvrModel(feature_engine, modelpath);
 
+    auto replay_path = modelpath + "/data_test/replay.rpl";
+    if (std::ifstream(replay_path)) {
+        ReplayFile replay_file(replay_path);
+        run_replay(feature_engine, svr_model, replay_file);
+        delete svr_model;
+        return 0;
+    }
+
     std::vector<ColumnInfo> col_info; // = read_column_list(modelpath + "/data_test/column_list.txt");
     std::vector<std::vector<ColumnValue>> request_data; // = read_request_data(modelpath + "/data_test/raw.txt", col_info);
     std::vector<std::string> adgroup_ids = read_adgroup_list(modelpath + "/data_test/adgroup_ids.txt");
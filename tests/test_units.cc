@@ -0,0 +1,730 @@
+/*
+Behaviour tests of the parts of the library that need no model files.
+
+```
+test_units
+```
+
+Each test prints the checks that fail; the exit code is 1 if any did.
+*/
+
+
+#include "saturn/saturn.h"
+#include "saturn/trace.h"
+#include "saturn/utils.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+using namespace saturn;
+
+
+size_t n_checks = 0;
+size_t n_failed = 0;
+
+void check(bool ok, std::string const & test, std::string const & what)
+{
+    n_checks++;
+    if (!ok) {
+        n_failed++;
+        std::cout << "FAILED " << test << ": " << what << std::endl;
+    }
+}
+
+void test_model_set_result()
+{
+    std::string const test = "ModelSet::Result";
+
+    // A reused result holds nothing of the previous request, even when `run` throws.
+    FeatureEngine engine;
+    ModelSet model_set(engine);
+    ModelSet::Result result;
+    auto stale = [&result]() {
+        result.ctr_prob = result.wr_win_prob = result.wr_dev_prob = result.wr_final_prob = 0.5;
+        result.ctr_degraded = result.wr_degraded = result.shed = true;
+        result.svr.resize(2);
+        result.ctr_us = result.wr_us = 7;
+    };
+    auto cleared = [&result]() {
+        return result.ctr_prob == 0. && result.wr_win_prob == 0. && result.wr_dev_prob == 0.
+               && result.wr_final_prob == 0. && !result.ctr_degraded && !result.wr_degraded && !result.shed
+               && result.svr.empty() && result.ctr_us == 0 && result.wr_us == 0;
+    };
+
+    ModelSet::Request request;
+    stale();
+    model_set.run(request, result);
+    check(cleared(), test, "fields of the models not asked for kept");
+
+    request.run_ctr = true;  // no `ctrModel`
+    stale();
+    bool thrown = false;
+    try {
+        model_set.run(request, result);
+    } catch (SaturnError const &) {
+        thrown = true;
+    }
+    check(thrown && cleared(), test, "fields kept when `run` throws");
+}
+
+void test_load_shedder()
+{
+    std::string const test = "LoadShedder";
+
+    // The queue signal alone, with the default `queue_low` of 0: shedding stops once
+    // the queue drains.
+    LoadShedder::Config config;
+    config.queue_high = 4;
+    config.window = 1;
+    LoadShedder shedder(config);
+    shedder.record_queue_depth(10);
+    shedder.record_latency(10);
+    check(shedder.state() == LoadShedder::State::shedding, test, "not shedding over `queue_high`");
+    shedder.record_queue_depth(2);
+    shedder.record_latency(10);
+    check(shedder.state() == LoadShedder::State::shedding, test, "stopped shedding between the thresholds");
+    shedder.record_queue_depth(0);
+    for (int i = 0; i < 20; i++) {
+        shedder.record_latency(10);
+    }
+    check(shedder.state() == LoadShedder::State::normal && shedder.shed_rate() == 0., test,
+          "still shedding with an empty queue");
+}
+
+
+void test_stage_cost()
+{
+    std::string const test = "StageCost";
+
+    StageCost cost;
+    for (int i = 0; i < 100; i++) {
+        check(!cost.skip(Deadline()), test, "skipped without a deadline");
+        cost.update(10);
+    }
+    check(!cost.skip(Deadline::after_microseconds(1000)), test, "skipped a fast stage");
+
+    // One slow run, then the stage is fast again.
+    cost.update(1000000);
+    check(cost.skip(Deadline::after_microseconds(1000)), test, "ran a stage estimated too slow");
+    double estimate = cost.microseconds();
+
+    size_t n_skipped = 1;
+    while (cost.skip(Deadline::after_microseconds(1000))) {
+        n_skipped++;
+        if (n_skipped > StageCost::probe_interval) {
+            break;
+        }
+    }
+    check(n_skipped < StageCost::probe_interval, test,
+          "still skipping after " + std::to_string(n_skipped) + " consecutive skips");
+    check(cost.microseconds() < estimate, test, "estimate did not decay while skipping");
+
+    // The probe is timed; the stage is not skipped again.
+    cost.update(10);
+    for (int i = 0; i < 10; i++) {
+        check(!cost.skip(Deadline::after_microseconds(1000)), test, "skipped again after recovering");
+        cost.update(10);
+    }
+
+    // A stage that stays too slow is probed every `probe_interval` calls.
+    StageCost slow;
+    slow.update(1000000);
+    size_t n_runs = 0;
+    for (size_t i = 0; i < 4 * StageCost::probe_interval; i++) {
+        if (!slow.skip(Deadline::after_microseconds(10))) {
+            n_runs++;
+            slow.update(1000000);
+        }
+    }
+    check(n_runs >= 3 && n_runs <= 4, test, "probed " + std::to_string(n_runs) + " times in 4 intervals");
+}
+
+void test_compiled_forest()
+{
+    std::string const test = "CompiledForest";
+
+    // Two trees over 2 predictors, in scikit-learn layout (-1: leaf).
+    //   tree 1: x0 <= 0.5 ? 0.1 : (x1 <= 2 ? 0.4 : 0.8)
+    //   tree 2: x1 <= 1 ? 0.2 : 0.6
+    CompiledForest forest(2);
+    bool thrown = false;
+    try {
+        forest.compile_bitvector();
+    } catch (SaturnError const &) {
+        thrown = true;
+    }
+    check(thrown, test, "compiled a forest without trees");
+
+    forest.add_tree({1, -1, 3, -1, -1}, {2, -1, 4, -1, -1}, {0, -2, 1, -2, -2},
+                    {0.5, 0., 2., 0., 0.}, {0.5, 0.1, 0.6, 0.4, 0.8});
+    forest.add_tree({1, -1, -1}, {2, -1, -1}, {1, -2, -2}, {1., 0., 0.}, {0.4, 0.2, 0.6});
+    check(forest.n_trees() == 2 && forest.n_nodes() == 8, test, "shape");
+    check(forest.compile_bitvector() && forest.has_bitvector(), test, "no bit-vector tables");
+
+    double const nan = std::nan("");
+    std::vector<std::vector<double>> rows = {{0., 0.}, {0.5, 1.}, {1., 2.}, {1., 3.}, {nan, 0.}, {0., nan}};
+    std::vector<double> expected = {0.15, 0.15, 0.5, 0.7, 0.3, 0.35};  // NaN goes right
+    std::vector<double> flat;
+    for (size_t i = 0; i < rows.size(); i++) {
+        std::string const row = "row " + std::to_string(i);
+        check(std::fabs(forest.predict_one(rows[i]) - expected[i]) < 1e-12, test, row);
+        check(std::fabs(forest.predict_one_bitvector(rows[i].data()) - expected[i]) < 1e-12, test, row + ", bit-vector");
+        flat.insert(flat.end(), rows[i].begin(), rows[i].end());
+    }
+    std::vector<double> out(rows.size());
+    forest.predict_many(flat.data(), rows.size(), out.data());
+    for (size_t i = 0; i < rows.size(); i++) {
+        check(std::fabs(out[i] - expected[i]) < 1e-12, test, "row " + std::to_string(i) + ", batched");
+    }
+
+    thrown = false;
+    try {
+        forest.add_tree({1, -1}, {2, -1, -1}, {0, -2}, {0., 0.}, {0., 0.});
+    } catch (SaturnError const &) {
+        thrown = true;
+    }
+    check(thrown, test, "added a tree with arrays of different lengths");
+}
+
+
+void test_trace_buffer()
+{
+    std::string const test = "TraceBuffer";
+
+    TraceBuffer buffer(5);
+    check(buffer.capacity() == 8, test, "capacity " + std::to_string(buffer.capacity()) + " for 5");
+
+    Trace trace;
+    check(!buffer.pop(trace), test, "popped from a new buffer");
+
+    // Several rounds, so that the slots' sequence numbers wrap around the ring.
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < buffer.capacity(); i++) {
+            trace.code = static_cast<int>(round * 100 + i);
+            check(buffer.push(trace), test, "push " + std::to_string(i) + " failed before full");
+        }
+        check(!buffer.push(trace), test, "pushed to a full buffer");
+
+        for (size_t i = 0; i < buffer.capacity(); i++) {
+            Trace out;
+            bool ok = buffer.pop(out);
+            check(ok, test, "pop " + std::to_string(i) + " failed before empty");
+            check(ok && out.code == static_cast<int>(round * 100 + i), test, "popped out of order");
+        }
+        check(!buffer.pop(trace), test, "popped from an empty buffer");
+    }
+
+    // Push and pop interleaved, half full.
+    for (int i = 0; i < 20; i++) {
+        trace.code = i;
+        check(buffer.push(trace), test, "push failed when half full");
+        if (i >= 4) {
+            Trace out;
+            check(buffer.pop(out) && out.code == i - 4, test, "popped out of order when interleaved");
+        }
+    }
+}
+
+
+void test_tracer_sample()
+{
+    std::string const test = "Tracer::sample";
+
+    // Each caller keeps its own count, so two tracers, or two models on one
+    // tracer, sample independently of each other.
+    Tracer a("/dev/null", 3);
+    Tracer b("/dev/null", 5);
+    size_t count_a = 0, count_b = 0, count_a2 = 0;
+    size_t n_a = 0, n_b = 0, n_a2 = 0;
+    for (int i = 0; i < 30; i++) {
+        n_a += a.sample(count_a);
+        n_b += b.sample(count_b);
+        if (i % 2 == 0) {
+            n_a2 += a.sample(count_a2);
+        }
+    }
+    check(n_a == 10, test, "sampled " + std::to_string(n_a) + " of 30 at 1 in 3");
+    check(n_b == 6, test, "sampled " + std::to_string(n_b) + " of 30 at 1 in 5");
+    check(n_a2 == 5, test, "sampled " + std::to_string(n_a2) + " of 15 at 1 in 3");
+}
+
+
+void test_branch_counters()
+{
+    std::string const test = "BranchCounters";
+
+    std::set<std::string> adgroups;
+    for (int i = 0; i < 100; i++) {
+        adgroups.insert("ag" + std::to_string(1000 + i));
+    }
+    BranchCounters counters(adgroups);
+    check(counters.index("ag1005") == 5 && counters.index("/ag1005") == 5, test, "index of ag1005");
+    check(counters.index("nope") == counters.n_adgroups(), test, "index of an adgroup outside the catalog");
+
+    auto a = counters.add_shard();
+    size_t empty_bytes = counters.memory_bytes();
+    a->count(counters.index("ag1003"), BranchCounts::curve);
+    a->count(counters.index("ag1003"), BranchCounts::curve);
+    a->count(counters.index("nope"), BranchCounts::no_adgroup);
+    // Two blocks (the first and the last) for three counts.
+    check(counters.memory_bytes() - empty_bytes == 2 * BranchCounters::Shard::lines_per_block * 64, test,
+          "allocated " + std::to_string(counters.memory_bytes() - empty_bytes) + " bytes for 2 adgroups");
+
+    auto b = counters.add_shard();
+    b->count(counters.index("ag1003"), BranchCounts::cutoff);
+    b->count(counters.index("ag1099"), BranchCounts::error);
+    counters.remove_shard(b);  // its counts stay
+    b.reset();
+
+    auto snapshot = counters.snapshot();
+    check(snapshot.size() == 3, test, std::to_string(snapshot.size()) + " adgroups in the snapshot");
+    check(snapshot["ag1003"].counts[BranchCounts::curve] == 2 && snapshot["ag1003"].counts[BranchCounts::cutoff] == 1,
+          test, "counts of ag1003");
+    check(snapshot["ag1099"].counts[BranchCounts::error] == 1, test, "counts of a removed shard");
+    check(snapshot[""].counts[BranchCounts::no_adgroup] == 1, test, "counts outside the catalog");
+}
+
+
+void test_memory_usage()
+{
+    std::string const test = "MemoryUsage";
+
+    MemoryUsage inner;
+    inner.add("map", 10, 1000);
+    inner.add_heap_growth("catalog", 1, 5000);
+    MemoryUsage usage;
+    usage.add("svr.", inner);
+    usage.add("context", 1, 24);
+    check(usage.total() == 6024, test, "total " + std::to_string(usage.total()));
+    check(usage.counted() == 1024, test, "counted " + std::to_string(usage.counted()));
+
+    std::ostringstream out;
+    usage.write(out);
+    check(out.str().find("5000 ~\n") != std::string::npos && out.str().find("1000 ~") == std::string::npos,
+          test, "heap growth not marked in the output");
+
+    char dir[] = "/tmp/test_units.XXXXXX";
+    check(mkdtemp(dir) != nullptr, test, "mkdtemp failed");
+    std::ofstream(std::string(dir) + "/a.data") << std::string(100, 'x');
+    std::ofstream(std::string(dir) + "/b.data") << std::string(20, 'x');
+    std::ofstream(std::string(dir) + "/model_config.json") << "{}";
+    check(file_bytes(dir, ".data") == 120, test, "file_bytes " + std::to_string(file_bytes(dir, ".data")));
+    check(file_bytes(std::string(dir) + "/none", ".data") == 0, test, "file_bytes of a missing directory");
+    std::remove((std::string(dir) + "/a.data").c_str());
+    std::remove((std::string(dir) + "/b.data").c_str());
+    std::remove((std::string(dir) + "/model_config.json").c_str());
+    rmdir(dir);
+}
+
+
+void test_replay_file()
+{
+    std::string const test = "ReplayFile";
+
+    auto const & string_field = FeatureEngine::STRING_FIELDS[2];
+    auto const & int_field = FeatureEngine::INT_FIELDS[1];
+    std::vector<std::string> names = {"brand_id", "adgroup_id", "user_adgroup_svr", "pacing",
+                                      string_field, int_field, "note", "user_extlba/ag1"};
+    std::vector<ReplayFile::Type> types;
+    for (auto const & name : names) {
+        types.push_back(ReplayWriter::column_type(name));
+    }
+    check(types[2] == ReplayFile::Type::float64 && types[5] == ReplayFile::Type::int32
+          && types[6] == ReplayFile::Type::string && types[7] == ReplayFile::Type::float64,
+          test, "column types");
+
+    ReplayWriter writer(names, types);
+    writer.add_row({"b1", "/ag1", "0.25", "-1", "x", "7", "first", "0.5"});
+    writer.add_row({"b2", "/ag2", "-1", "0.5", "", "8", "a longer value than the rest", "1.5"});
+    writer.add_row({"b1", "/ag1", "0.125", "1", "x", "-3", "first", "2.5"});
+    std::string path = "/tmp/test_units." + std::to_string(getpid()) + ".replay";
+    writer.write(path);
+
+    {
+        check(ReplayFile::is_replay_file(path), test, "not recognized as a replay file");
+        ReplayFile file(path);
+        check(file.n_rows() == 3 && file.n_columns() == names.size(), test, "shape");
+        check(file.find("note") == 6 && file.find("nope") == file.n_columns(), test, "find");
+        check(file.dict_size(0) == 2 && file.dict_size(6) == 2, test, "dictionary sizes");
+        check(std::string(file.string_at(6, 1)) == "a longer value than the rest", test, "string value");
+        check(file.ints(5)[2] == -3 && file.floats(7)[2] == 2.5, test, "number values");
+
+        ModelSet::Request request;
+        request.string_fields.emplace_back(FeatureEngine::StringField::kGender, "stale");
+        file.fill(1, request);
+        check(request.string_fields.empty(), test, "string fields left from before");
+        check(request.c_str_fields.size() == 1 && request.c_str_fields[0].second == file.string_at(4, 1)
+              && std::string(request.c_str_fields[0].second).empty(), test, "string field of row 1");
+        check(request.int_fields.size() == 1 && request.int_fields[0].second == 8, test, "int field of row 1");
+        check(request.svr_calls.size() == 1 && request.svr_calls[0].brand_id == "b2"
+              && request.svr_calls[0].adgroup_id == "/ag2" && request.svr_calls[0].user_adgroup_svr == -1.
+              && request.svr_calls[0].pacing == 0.5, test, "SVR call of row 1");
+        file.fill(2, request);
+        check(std::string(request.c_str_fields[0].second) == "x" && request.svr_calls[0].user_adgroup_svr == 0.125,
+              test, "row 2");
+    }
+
+    // A dictionary whose offsets go backwards is rejected, not read out of place.
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        // The dictionary of the first column: offsets 0, 3, 6 of "b1", "b2".
+        uint64_t offsets[3] = {0, 3, 6};
+        auto at = bytes.find(std::string(reinterpret_cast<char const *>(offsets), sizeof(offsets)));
+        check(at != std::string::npos, test, "dictionary offsets not found in the file");
+        if (at != std::string::npos) {
+            uint64_t bad[3] = {0, 6, 3};  // the second value would start after its end
+            f.seekp(static_cast<std::streamoff>(at));
+            f.write(reinterpret_cast<char const *>(bad), sizeof(bad));
+            f.close();
+            bool thrown = false;
+            try {
+                ReplayFile file(path);
+            } catch (SaturnError const &) {
+                thrown = true;
+            }
+            check(thrown, test, "accepted non-monotonic dictionary offsets");
+        }
+    }
+    std::remove(path.c_str());
+}
+
+void test_config_delta()
+{
+    std::string const test = "ConfigDelta";
+
+    std::string path = "/tmp/test_units." + std::to_string(getpid()) + ".delta";
+    std::ofstream(path) << "# a comment\n"
+                           "\n"
+                           "cap /ag1 1.5\n"
+                           "curve /ag2 0.1 0.4\n"
+                           "  default_svr /ag3 0.001 0.01\n"
+                           "cutoff /ag4 7\n"
+                           "cap /ag5 -\n"
+                           "brand_default_svr b1 0.002\t0.02\n";
+    auto updates = read_config_delta(path);
+    check(updates.size() == 6, test, std::to_string(updates.size()) + " updates");
+    if (updates.size() == 6) {
+        check(updates[0].section == SvrConfigUpdate::Section::cap && updates[0].id == "/ag1"
+              && updates[0].values[0] == 1.5 && !updates[0].remove, test, "cap");
+        check(updates[1].section == SvrConfigUpdate::Section::curve && updates[1].values[0] == 0.1
+              && updates[1].values[1] == 0.4, test, "curve");
+        check(updates[2].section == SvrConfigUpdate::Section::default_svr && updates[2].id == "/ag3", test,
+              "indented line");
+        check(updates[4].remove && updates[4].id == "/ag5", test, "removal");
+        check(updates[5].section == SvrConfigUpdate::Section::brand_default_svr && updates[5].values[1] == 0.02,
+              test, "tab-separated values");
+    }
+
+    // Malformed lines name their line number.
+    std::vector<std::pair<std::string, std::string>> bad = {
+        {"cap /ag1 1\nbogus /ag1 1\n", ":2: unknown section"},
+        {"cap\n", ":1: missing id"},
+        {"curve /ag1 0.1\n", ":1: expecting 2 value(s)"},
+        {"cap /ag1 1 2\n", ":1: expecting 1 value(s)"},
+        {"cap /ag1 1x\n", ":1: bad number `1x`"},
+        {"cap /ag1 inf\n", ":1: bad number `inf`"},
+        {"\n\ncurve /ag1 0.1 0\n", ":3: `sigma` must be positive"},
+    };
+    for (auto const & b : bad) {
+        std::ofstream(path) << b.first;
+        std::string message;
+        try {
+            read_config_delta(path);
+        } catch (SaturnError const & e) {
+            message = e.what();
+        }
+        check(message.find(b.second) != std::string::npos, test,
+              "`" + b.first.substr(0, b.first.size() - 1) + "` gave `" + message + "`");
+    }
+    std::remove(path.c_str());
+    bool thrown = false;
+    try {
+        read_config_delta(path);
+    } catch (SaturnError const &) {
+        thrown = true;
+    }
+    check(thrown, test, "read a missing file");
+
+    // Applying: a new version; cutoffs are clamped, '-' removes.
+    SvrConfig config;
+    config.adgroup_multiplier_cap = std::make_shared<SvrConfig::ValueMap>(SvrConfig::ValueMap{{"/ag5", 3.}});
+    config.apply(updates);
+    check(config.version == 1, test, "version " + std::to_string(config.version));
+    check(config.adgroup_multiplier_cap->count("/ag1") == 1 && config.adgroup_multiplier_cap->count("/ag5") == 0,
+          test, "caps");
+    check(config.adgroup_quantile_cutoff->at("/ag4") == 1., test, "cutoff not clamped");
+    check(config.brand_default_svr->count("b1") == 1, test, "brand default SVR");
+
+    // Invalidating: only the adgroups whose curve, cutoff or default SVR changed since then.
+    typedef std::map<std::string, std::tuple<double, double>> Cache;
+    Cache const full = {{"/ag1", std::make_tuple(1., -1.)}, {"/ag2", std::make_tuple(1., -1.)},
+                        {"/ag3", std::make_tuple(1., -1.)}, {"/ag4", std::make_tuple(1., -1.)},
+                        {"/ag9", std::make_tuple(1., -1.)}};
+    SvrConfig v2 = config;
+    v2.apply({updates[0], updates[1], updates[3]});  // cap /ag1, curve /ag2, cutoff /ag4
+    check(v2.brand_default_svr == config.brand_default_svr && v2.adgroup_default_svr == config.adgroup_default_svr,
+          test, "untouched sections copied");
+    check(v2.adgroup_multiplier_cap != config.adgroup_multiplier_cap
+          && v2.adgroup_multiplier_curve != config.adgroup_multiplier_curve, test, "touched sections shared");
+    check(config.adgroup_revision->at("/ag2") == 1 && v2.adgroup_revision->at("/ag2") == 2,
+          test, "the previous version changed");
+    Cache cache = full;
+    v2.invalidate(cache, 1);
+    check(cache.size() == 3 && cache.count("/ag1") == 1 && cache.count("/ag2") == 0 && cache.count("/ag4") == 0,
+          test, "invalidated " + std::to_string(full.size() - cache.size()) + " adgroups for version 2");
+    cache = full;
+    v2.invalidate(cache, 2);
+    check(cache.size() == full.size(), test, "invalidated adgroups already seen");
+
+    // A brand default SVR changes every adgroup's default multiplier.
+    SvrConfig v3 = v2;
+    v3.apply({updates[5]});
+    cache = full;
+    v3.invalidate(cache, 2);
+    check(cache.empty(), test, "kept default multipliers after a brand default SVR update");
+    cache = full;
+    v3.invalidate(cache, 3);
+    check(cache.size() == full.size(), test, "invalidated at the current version");
+}
+
+void test_id_value_file()
+{
+    std::string const test = "IdValueFile";
+
+    // Over 4 MB, so that the file is cut into chunks whatever the thread count, with a
+    // 2 MB line among the first, so that a chunk ends past the next split point.
+    // Every row and malformed line is checked against what was written.
+    std::string path = "/tmp/test_units." + std::to_string(getpid()) + ".ids";
+    std::vector<std::string> ids;
+    std::vector<double> values;
+    std::vector<size_t> bad_lines;
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.precision(17);
+        size_t line = 0;
+        for (size_t i = 0; out.tellp() < (6 << 20); i++) {
+            if (line > 0) {
+                out << (i % 3 == 0 ? "\r\n" : "\n");
+            }
+            line++;
+            std::string id = "ag" + std::to_string(i);
+            if (i == 1000) {
+                id += std::string(2 << 20, 'x');
+            }
+            if (i % 7919 == 1) {
+                out << " \t ";
+            } else if (i % 9973 == 2) {
+                out << id << ' ' << i;
+                bad_lines.push_back(line);
+            } else if (i % 10007 == 3) {
+                out << id << " 1 " << i << 'x';
+                bad_lines.push_back(line);
+            } else {
+                out << id << '\t' << i * 0.5 << "  +" << i;
+                ids.push_back(id);
+                values.push_back(i * 0.5);
+                values.push_back(static_cast<double>(i));
+            }
+        }
+        // No line break after the last line.
+    }
+
+    for (size_t n_threads : {1, 3, 8}) {
+        std::string const what = " on " + std::to_string(n_threads) + " thread(s)";
+        IdValueFile file(path, 2, n_threads);
+        check(file.exists(), test, "missing" + what);
+        check(file.size() == ids.size(), test, std::to_string(file.size()) + " rows of "
+              + std::to_string(ids.size()) + what);
+        size_t n_wrong = 0;
+        for (size_t row = 0; row < file.size() && row < ids.size(); row++) {
+            if (file.id(row) != ids[row] || file.value(row, 0) != values[2 * row]
+                || file.value(row, 1) != values[2 * row + 1]) {
+                n_wrong++;
+            }
+        }
+        check(n_wrong == 0, test, std::to_string(n_wrong) + " rows read wrong" + what);
+
+        check(file.n_malformed() == bad_lines.size() && file.errors().size() == bad_lines.size(), test,
+              std::to_string(file.n_malformed()) + " malformed lines of " + std::to_string(bad_lines.size()) + what);
+        size_t n_misplaced = 0;
+        for (size_t k = 0; k < file.errors().size() && k < bad_lines.size(); k++) {
+            n_misplaced += file.errors()[k].line != bad_lines[k];
+        }
+        check(n_misplaced == 0, test, std::to_string(n_misplaced) + " errors with a wrong line number" + what);
+        check(!file.errors().empty() && file.errors()[0].message.find("expecting 2 value(s)") != std::string::npos,
+              test, "message of a missing value" + what);
+    }
+    std::remove(path.c_str());
+
+    // Small files, read as one chunk; the first of equal ids is kept.
+    std::ofstream(path) << "b 1 2\na 3 4\n\nb 5 6\nc 7\n";
+    IdValueFile file(path, 2);
+    auto rows = file.sorted_unique_rows();
+    check(rows.size() == 2 && file.id(rows[0]) == "a" && file.id(rows[1]) == "b" && file.value(rows[1], 0) == 1.,
+          test, "sorted unique rows");
+    check(file.error_summary().find("1 malformed line(s) skipped; line 5: ") != std::string::npos, test,
+          "summary `" + file.error_summary() + "`");
+    std::remove(path.c_str());
+    IdValueFile missing(path, 2);
+    check(!missing.exists() && missing.size() == 0, test, "a missing file");
+}
+
+void test_model_registry()
+{
+    std::string const test = "ModelRegistry";
+
+    // Models of given sizes, without model files: the load function only sizes them.
+    std::map<std::string, size_t> sizes = {{"a", 100}, {"b", 200}, {"c", 300}, {"p", 50}};
+    std::vector<std::string> loads;
+    auto load = [&](ModelRegistry::Kind kind, std::string const & path) {
+        if (sizes.count(path) == 0) {
+            throw SaturnError("no model at " + path);
+        }
+        loads.push_back(ModelLoader::kind_name(kind) + std::string(" ") + path);
+        ModelRegistry::Loaded loaded;
+        loaded.bytes = sizes[path];
+        return loaded;
+    };
+    FeatureEngine engine;
+    ModelRegistry registry(engine, 500, load);
+    auto is_resident = [&](ModelRegistry::Kind kind, std::string const & id) {
+        for (auto const & m : registry.stats().models) {
+            if (m.kind == kind && m.id == id) {
+                return m.resident;
+            }
+        }
+        return false;
+    };
+    auto const svr = ModelRegistry::Kind::svr;
+
+    registry.add(svr, "a", "a");
+    registry.add(ModelRegistry::Kind::ctr, "a", "b");  // the same ID, another kind
+    registry.add(svr, "b", "b");
+    registry.add(svr, "c", "c");
+    registry.add(svr, "p", "p", true);
+    registry.add(svr, "bad", "nowhere");
+    check(loads.size() == 1 && loads[0] == "svr p", test, "loaded other than the pinned model on `add`");
+    bool thrown = false;
+    try {
+        registry.add(svr, "a", "c");
+    } catch (SaturnError const &) {
+        thrown = true;
+    }
+    check(thrown, test, "registered an ID twice");
+
+    // Least recently used first: `b`, as `a` was asked for again.
+    registry.svr("a");
+    registry.svr("b");
+    registry.svr("a");
+    check(registry.stats().resident_bytes == 350, test, "resident bytes before the budget is exceeded");
+    registry.svr("c");
+    check(is_resident(svr, "a") && !is_resident(svr, "b") && is_resident(svr, "c") && is_resident(svr, "p"), test,
+          "evicted other than the least recently used");
+    auto stats = registry.stats();
+    check(stats.resident_bytes == 450 && stats.n_resident == 3 && stats.hits == 1 && stats.misses == 4
+          && stats.loads == 4 && stats.evictions == 1 && stats.engine_bytes == 0, test, "stats after an eviction");
+
+    // Reloading: a miss, then hits.
+    registry.svr("b");
+    registry.svr("b");
+    check(loads.back() == "svr b" && registry.stats().loads == 5 && registry.stats().hits == 2, test, "reload of b");
+    check(!is_resident(svr, "a") && !is_resident(svr, "c"), test, "kept older models over the budget");
+
+    // A smaller budget evicts all but the pinned model, which is never evicted.
+    registry.set_memory_budget(10);
+    check(registry.stats().n_resident == 1 && is_resident(svr, "p"), test, "resident after shrinking the budget");
+    check(!registry.evict(svr, "p"), test, "evicted a pinned model");
+    registry.svr("a");  // loaded anyway, but the first to go
+    check(is_resident(svr, "a") && registry.stats().resident_bytes == 150, test, "model asked for over the budget");
+    registry.unpin(svr, "p");
+    check(registry.stats().n_resident == 0, test, "models kept over the budget after unpinning");
+    registry.pin(svr, "c");
+    check(is_resident(svr, "c") && !is_resident(svr, "a"), test, "pinning did not load, or kept a");
+    check(registry.evict(ModelRegistry::Kind::ctr, "a") == false, test, "evicted a model not resident");
+
+    // A failed load is counted, and retried on the next call.
+    for (int i = 0; i < 2; i++) {
+        thrown = false;
+        try {
+            registry.svr("bad");
+        } catch (SaturnError const &) {
+            thrown = true;
+        }
+        check(thrown, test, "loaded a missing model");
+    }
+    check(registry.stats().failed_loads == 2, test, std::to_string(registry.stats().failed_loads) + " failed loads");
+    thrown = false;
+    try {
+        registry.svr("nope");
+    } catch (SaturnError const &) {
+        thrown = true;
+    }
+    check(thrown, test, "served an unregistered model");
+
+    // Only the owner thread loads; any thread reads the stats.
+    bool off_thread_thrown = false;
+    size_t off_thread_loads = 0;
+    std::thread other([&]() {
+        try {
+            registry.svr("a");
+        } catch (SaturnError const &) {
+            off_thread_thrown = true;
+        }
+        off_thread_loads = registry.stats().loads;
+    });
+    other.join();
+    check(off_thread_thrown, test, "loaded a model off the owner thread");
+    check(off_thread_loads == registry.stats().loads, test, "stats off the owner thread");
+
+    // Manifests: comments, blank lines, pinned models; malformed lines name the line.
+    std::string path = "/tmp/test_units." + std::to_string(getpid()) + ".manifest";
+    std::ofstream(path) << "# kind id path [pinned]\n\nwr w1 a\nctr c1 b pinned\n";
+    ModelRegistry manifest_registry(engine, 0, load);
+    manifest_registry.add_manifest(path);
+    check(manifest_registry.has(ModelRegistry::Kind::wr, "w1") && manifest_registry.stats().n_resident == 1
+          && manifest_registry.stats().models[0].pinned, test, "models of the manifest");
+    std::ofstream(path) << "svr s1 a\nsvr s2 a pinnned\n";
+    std::string message;
+    try {
+        manifest_registry.add_manifest(path);
+    } catch (SaturnError const & e) {
+        message = e.what();
+    }
+    check(message.find(":2: expecting") != std::string::npos, test, "manifest error `" + message + "`");
+    std::remove(path.c_str());
+}
+
+
+int main()
+{
+    test_model_set_result();
+    test_load_shedder();
+    test_stage_cost();
+    test_compiled_forest();
+    test_trace_buffer();
+    test_tracer_sample();
+    test_branch_counters();
+    test_memory_usage();
+    test_replay_file();
+    test_config_delta();
+    test_id_value_file();
+    test_model_registry();
+
+    std::cout << n_checks - n_failed << " of " << n_checks << " check(s) passed" << std::endl;
+    return n_failed > 0 ? 1 : 0;
+}